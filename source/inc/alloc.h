@@ -12,6 +12,12 @@
  * This is opt-in tracking. Eventually all of my library code will use
  * this but it won't interfere with non-library code.
  *
+ * Tracing is single threaded. The trace tables aren't locked, so
+ * while a pool is being traced only one thread at a time may call
+ * the wrappers for it. When it isn't being traced the wrappers pass
+ * straight through to the standard library and are as thread safe as
+ * it is.
+ *
  * Released to the public domain by Troy Brumley blametroi@gmail.com
  *
  * This software is dual-licensed to the public domain and under the
@@ -61,6 +67,15 @@ txballoc_calloc(        /* *** do not call directly, use tcalloc *** */
 	int l           /* __LINE__ */
 );
 
+void *
+txballoc_realloc(       /* *** do not call directly, use trealloc *** */
+	void *p,        /* as in realloc, @ block */
+	size_t n,       /* as in realloc, new # bytes */
+	bool user_or_libs,
+	char *f,        /* __FILE__ */
+	int l           /* __LINE__ */
+);
+
 void
 txballoc_free(          /* *** do not call directly, use tfree *** */
 	void *p,        /* as in free, @ block */
@@ -96,6 +111,8 @@ txballoc_terminate(
  * t(s)malloc(n)           -- allocate 'n' bytes
  * t(s)calloc(c, n)        -- allocate and zero contiguous memory
  *                            to hold 'c' blocks each of 'n' bytes
+ * t(s)realloc(p, n)       -- resize the allocated memory at 'p' to
+ *                            'n' bytes, possibly moving it
  * t(s)free(p)             -- free the allocated memory at 'p'
  *
  * The reporting option bits will report allocations (malloc, calloc),
@@ -128,6 +145,9 @@ txballoc_terminate(
 #define tcalloc(c, n) \
 	txballoc_calloc((c), (n), TXBALLOC_USER, __FILE__, __LINE__)
 
+#define trealloc(p, n) \
+	txballoc_realloc((p), (n), TXBALLOC_USER, __FILE__, __LINE__)
+
 #define tfree(p) \
 	txballoc_free((p), TXBALLOC_USER, __FILE__, __LINE__)
 
@@ -144,6 +164,9 @@ txballoc_terminate(
 #define tscalloc(c, n) \
 	txballoc_calloc((c), (n), TXBALLOC_LIBRARY, __FILE__, __LINE__)
 
+#define tsrealloc(p, n) \
+	txballoc_realloc((p), (n), TXBALLOC_LIBRARY, __FILE__, __LINE__)
+
 #define tsfree(p) \
 	txballoc_free((p), TXBALLOC_LIBRARY, __FILE__, __LINE__)
 
@@ -23,7 +23,9 @@
  */
 
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -55,8 +57,8 @@ extern "C" {
  * functions that don't really need to return a payload or count
  * return their first argument, which allows for chaining calls. some
  * structures reallocation on growth. for those functions you must be
- * sure to use the address returned. see the accumulator list for more
- * information.
+ * sure to use the address returned. see the accumulator list and
+ * stable_handle for more information.
  *
  * functions that return an integer (count) return -1 for any error.
  * functions that return the one_block will return a NULL for any
@@ -94,6 +96,77 @@ extern "C" {
 #define ONE_ALIST_DEFAULT_CAPACITY 100
 #endif
 
+/*
+ * heap backed priority queues (both bk_heap and bk_dual_heap) keep
+ * their items in arrays that grow by doubling, starting from this
+ * capacity.
+ */
+
+#ifndef ONE_PQUEUE_HEAP_DEFAULT_CAPACITY
+#define ONE_PQUEUE_HEAP_DEFAULT_CAPACITY 64
+#endif
+
+/*
+ * hash backed key:value stores start with this many buckets and
+ * double whenever the load passes ONE_HASH_LOAD_PERCENT. the capacity
+ * must be a power of two.
+ */
+
+#ifndef ONE_HASH_DEFAULT_CAPACITY
+#define ONE_HASH_DEFAULT_CAPACITY 64
+#endif
+
+#ifndef ONE_HASH_LOAD_PERCENT
+#define ONE_HASH_LOAD_PERCENT 75
+#endif
+
+/*
+ * list items and tree nodes are carved from slabs. the first slab for
+ * a structure holds ONE_POOL_FIRST_SLAB nodes, each later slab twice
+ * as many as the one before up to ONE_POOL_MAX_SLAB.
+ */
+
+#ifndef ONE_POOL_FIRST_SLAB
+#define ONE_POOL_FIRST_SLAB 16
+#endif
+
+#ifndef ONE_POOL_MAX_SLAB
+#define ONE_POOL_MAX_SLAB 1024
+#endif
+
+/*
+ * ring backed stacks, queues, and deques start with this many slots
+ * and double when full. the capacity must be a power of two.
+ */
+
+#ifndef ONE_RING_DEFAULT_CAPACITY
+#define ONE_RING_DEFAULT_CAPACITY 16
+#endif
+
+/*
+ * the bounded queues, spsc and mpmc, hold this many items unless
+ * made with make_one_bounded. the ends of a queue are kept apart by
+ * ONE_CACHE_LINE bytes so the producers and consumers don't fight
+ * over a line.
+ */
+
+#ifndef ONE_BOUNDED_DEFAULT_CAPACITY
+#define ONE_BOUNDED_DEFAULT_CAPACITY 1024
+#endif
+
+#ifndef ONE_CACHE_LINE
+#define ONE_CACHE_LINE 64
+#endif
+
+/*
+ * a work stealing deque starts with this many slots and doubles when
+ * full. the capacity must be a power of two.
+ */
+
+#ifndef ONE_WSDEQUE_DEFAULT_CAPACITY
+#define ONE_WSDEQUE_DEFAULT_CAPACITY 64
+#endif
+
 /*
  * key:value stores are backed by a binary search tree. rebalancing is
  * not strict or absolute since i'm using the scapegoat tree approach.
@@ -112,6 +185,15 @@ extern "C" {
  * not removed until a full rebalance is done.
  *
  * it's a garbage collection.
+ *
+ * these are the defaults. each tree carries its own copy in a
+ * one_policy, which make_one_keyed_policy can set.
+ *
+ * ONE_TOMBSTONE_SWEEP spreads that collection out. while a tree holds
+ * deleted nodes, each insert or delete also walks this many nodes in
+ * order from where the last walk stopped, removing any deleted nodes
+ * it passes. this keeps the deleted count under the full rebalance
+ * trigger in most workloads. 0 turns it off, see also sweep.
  */
 
 #ifndef ONE_REBALANCE_ALPHA
@@ -126,6 +208,33 @@ extern "C" {
 #define ONE_REBALANCE_MINIMUM 64
 #endif
 
+#ifndef ONE_TOMBSTONE_SWEEP
+#define ONE_TOMBSTONE_SWEEP 8
+#endif
+
+/*
+ * a bk_bplus keyval keeps up to ONE_BPLUS_KEYS keys in each node of
+ * the tree. the keys of a node are contiguous, 16 eight byte keys are
+ * two cache lines, so a search touches few lines per level and the
+ * tree is only log16(N) levels deep.
+ */
+
+#ifndef ONE_BPLUS_KEYS
+#define ONE_BPLUS_KEYS 16
+#endif
+
+/*
+ * a cursor on a bk_bplus keyval remembers the inner nodes above its
+ * leaf so it can step to the next leaf without going back to the
+ * root. it has room for ONE_CURSOR_DEPTH of them, enough for any
+ * count of keys with the default ONE_BPLUS_KEYS. a cursor on a deeper
+ * tree goes back to the root at the end of each leaf.
+ */
+
+#ifndef ONE_CURSOR_DEPTH
+#define ONE_CURSOR_DEPTH 16
+#endif
+
 /*
  * the supported data structures. there is a table of tag strings in
  * the implementation side that must be kept in synch with these
@@ -143,6 +252,9 @@ enum one_type {
 	dynarray,      /* array */
 	keyval,        /* scapegoat tree */
 	pqueue,        /* priority queue */
+	spsc,          /* bounded ring, one producer one consumer */
+	mpmc,          /* bounded ring, any producers and consumers */
+	wsdeque,       /* growable ring, one owner and any thieves */
 	unknowable
 };
 typedef enum one_type one_type;
@@ -150,6 +262,50 @@ typedef enum one_type one_type;
 #define ONE_TYPE_MAX unknowable
 #define ONE_TAG_LEN 24
 
+/*
+ * some of the data structures can sit on more than one backing. the
+ * default is noted in the one_type enum above and is what make_one
+ * gives you. make_one_backed asks for an alternative.
+ *
+ * bk_heap is for the pqueue and keeps the items in a binary heap
+ * instead of a sorted doubly linked list. bk_dual_heap is also for
+ * the pqueue, and keeps both a max and a min heap over the items so
+ * that either end is cheap.
+ *
+ * bk_hash is for the keyval, an open addressing hash table instead
+ * of the scapegoat tree (bk_tree). lookups don't pay for ordering,
+ * but the keys come back unordered.
+ *
+ * bk_ring is for the stack, queue, and deque, a growable circular
+ * buffer instead of a linked list (bk_linked). there is no allocation
+ * per item, only when the buffer doubles.
+ *
+ * bk_bplus is for the keyval, a B+ tree instead of the scapegoat
+ * tree. the keys stay ordered, but many share a node and the values
+ * sit in the leaves, so lookups chase far fewer pointers and an
+ * ordered walk scans a leaf at a time. deletes are immediate, there
+ * are no tombstones or rebalances. it is the only backing that can
+ * take a snapshot.
+ *
+ * bk_intrusive is for the singly, doubly, stack, queue, and deque.
+ * the links live in the client's own records, so nothing is
+ * allocated per item. see make_one_intrusive.
+ */
+
+enum one_backing {
+	bk_default = 0,   /* whatever make_one would use */
+	bk_linked,        /* linked list */
+	bk_heap,          /* binary heap in an array */
+	bk_dual_heap,     /* paired max and min heaps */
+	bk_tree,          /* scapegoat tree */
+	bk_hash,          /* open addressing hash table */
+	bk_ring,          /* circular buffer */
+	bk_bplus,         /* B+ tree with wide nodes */
+	bk_intrusive,     /* links embedded in the items */
+	bk_unknowable
+};
+typedef enum one_backing one_backing;
+
 /*
  * core data structures/control blocks
  *
@@ -164,6 +320,9 @@ typedef struct  one_block     one_block;
 
 typedef union   one_details   one_details;
 
+typedef struct  one_slab      one_slab;
+typedef struct  one_pool      one_pool;
+
 typedef struct  sgl_item      sgl_item;
 typedef struct  one_singly    one_singly;
 typedef struct  dbl_item      dbl_item;
@@ -171,16 +330,70 @@ typedef struct  one_doubly    one_doubly;
 typedef         one_singly    one_stack;
 typedef         one_doubly    one_deque;
 typedef         one_doubly    one_queue;
+typedef struct  one_ring      one_ring;
+typedef struct  one_link      one_link;
+typedef struct  one_intrusive one_intrusive;
+typedef struct  bq_ends       bq_ends;
+typedef struct  one_spsc      one_spsc;
+typedef struct  mpmc_cell     mpmc_cell;
+typedef struct  one_mpmc      one_mpmc;
+typedef struct  ws_array      ws_array;
+typedef struct  one_wsdeque   one_wsdeque;
 typedef struct  one_alist     one_alist;
 typedef struct  one_dynarray  one_dynarray;
 typedef struct  one_node      one_node;
+typedef struct  one_policy    one_policy;
 typedef struct  one_tree      one_tree;
 typedef         one_tree      one_keyval;
+typedef struct  hash_entry    hash_entry;
+typedef struct  one_hash      one_hash;
+typedef struct  bp_node       bp_node;
+typedef struct  bp_leaf       bp_leaf;
+typedef struct  bp_inner      bp_inner;
+typedef struct  bp_arena      bp_arena;
+typedef struct  one_bplus     one_bplus;
 typedef struct  pq_item       pq_item;
 typedef struct  one_pqueue    one_pqueue;
+typedef struct  pq_slot       pq_slot;
+typedef struct  one_pqheap    one_pqheap;
+typedef struct  pq_dslot      pq_dslot;
+typedef struct  one_pqdual    one_pqdual;
+typedef struct  pq_pair       pq_pair;
+typedef struct  one_cursor    one_cursor;
+typedef struct  one_rwlock    one_rwlock;
+
+/*
+ * a node pool. list items and tree nodes are small, all the same size
+ * within a structure, and churn a lot. instead of going to the
+ * allocator for each one, they are carved out of slabs owned by the
+ * structure. a released node goes on the free list for reuse, and
+ * the slabs themselves are only released by purge or free_one.
+ *
+ * slabs are allocated with tsmalloc, so txballoc tracking sees one
+ * allocation per slab rather than one per node.
+ *
+ * the ends of the slab and free lists are kept so that the nodes of
+ * one pool can be handed to another in one step, see splice.
+ */
+
+struct one_slab {
+	one_slab *next;             /* all slabs of the pool         */
+	long nodes;                 /* and nodes follow              */
+};
+
+struct one_pool {
+	one_slab *slabs;            /* most recent first             */
+	one_slab *oldest;           /* and the end of that list      */
+	void *free;                 /* released nodes, linked        */
+	void *free_last;            /* valid only when free is set   */
+	int slab_count;             /* how many slabs                */
+	int next_slab;              /* nodes in the next slab        */
+};
 
 /*
- * a singly linked list and its nodes.
+ * a singly linked list and its nodes. the length is kept as items
+ * come and go, so count and depth don't walk the list, and the last
+ * item is kept so adding there doesn't either.
  */
 
 struct sgl_item {
@@ -190,6 +403,9 @@ struct sgl_item {
 
 struct one_singly {
 	sgl_item *first;
+	sgl_item *last;
+	int length;                 /* items on the list             */
+	one_pool pool;
 };
 
 /*
@@ -205,6 +421,8 @@ struct dbl_item {
 struct one_doubly {
 	dbl_item *first;
 	dbl_item *last;
+	int length;                 /* items on the list             */
+	one_pool pool;
 };
 
 /*
@@ -216,6 +434,121 @@ struct one_doubly {
  * different apis for a doubly linked list.
  */
 
+/*
+ * or any of the three can be made on a ring buffer. the items run
+ * from slot head for length slots, wrapping at capacity. the
+ * capacity is always a power of two so wrapping is a mask.
+ */
+
+struct one_ring {
+	int head;                   /* index of the front item       */
+	int length;                 /* items held                    */
+	int capacity;               /* slots allocated               */
+	void **slot;
+};
+
+/*
+ * or any of the five can be intrusive. the client puts a one_link in
+ * its record, and the list links those. offset is where the link
+ * sits in the record, from offsetof, so the record can be found from
+ * its link. the links run both ways whatever the type, so every end
+ * is constant time.
+ */
+
+struct one_link {
+	one_link *next;
+	one_link *previous;
+};
+
+struct one_intrusive {
+	one_link *first;
+	one_link *last;
+	int length;                 /* items on the list             */
+	size_t offset;              /* of the link in each item      */
+};
+
+/*
+ * the bounded queues pass items between threads without a lock. both
+ * are rings of a fixed power of two capacity, and the head and tail
+ * are counters that only go up, masked to find a slot.
+ *
+ * the spsc has one producer, who alone moves the tail, and one
+ * consumer, who alone moves the head. each keeps a copy of the other
+ * end as last seen and only reads the real one when the copy says
+ * the ring is full or empty.
+ *
+ * the mpmc is dmitry vyukov's bounded queue. each cell has a sequence
+ * number saying whose turn it is. a producer at position p claims it
+ * by moving the tail on from p once the cell's sequence is p, and
+ * hands it over by making it p+1. a consumer waits for p+1, moves the
+ * head on, and makes the sequence p+capacity for the producer a lap
+ * later.
+ *
+ * the ends are allocated on their own, padded out so that the head
+ * and tail are on different cache lines. the seen copies are only
+ * used by the spsc.
+ */
+
+struct bq_ends {
+	char pad0[ONE_CACHE_LINE];
+	atomic_size_t head;         /* next to take, the consumers'  */
+	size_t tail_seen;           /* the consumer's copy of tail   */
+	char pad1[ONE_CACHE_LINE];
+	atomic_size_t tail;         /* next to fill, the producers'  */
+	size_t head_seen;           /* the producer's copy of head   */
+	char pad2[ONE_CACHE_LINE];
+};
+
+struct one_spsc {
+	void **slot;
+	size_t mask;                /* capacity - 1                  */
+	bq_ends *ends;
+};
+
+struct mpmc_cell {
+	atomic_size_t sequence;
+	void *item;
+};
+
+struct one_mpmc {
+	mpmc_cell *cell;
+	size_t mask;                /* capacity - 1                  */
+	bq_ends *ends;
+};
+
+/*
+ * the work stealing deque of chase and lev, with the c11 orderings
+ * of le, pop, cohen, and zappa nardelli. one thread owns it and
+ * pushes and pops at the bottom, other threads steal from the top.
+ * the owner and the thieves only meet over the last item, and settle
+ * it with a swap on top.
+ *
+ * top and bottom are positions that only go up (bottom can step back
+ * one while the owner pops), masked to find a slot in the array.
+ * when the owner fills the array it copies the items to one twice
+ * the size. a thief may still be reading the old one, so it is kept,
+ * hanging off the new one, until free_one. the kept arrays add up to
+ * less than the current one.
+ *
+ * owners grow their arrays on their own threads, so the arrays come
+ * from malloc and not txballoc, whose tracing is single threaded.
+ * they don't show in its leak reports.
+ */
+
+struct ws_array {
+	ws_array *retired;          /* the array this one replaced   */
+	size_t mask;                /* capacity - 1                  */
+	_Atomic(void *) slot[];
+};
+
+struct one_wsdeque {
+	_Atomic(ws_array *) array;
+	char pad0[ONE_CACHE_LINE];
+	atomic_llong top;           /* next to steal, the thieves'   */
+	char pad1[ONE_CACHE_LINE];
+	atomic_llong bottom;        /* next to push, the owner's     */
+};
+
 /*
  * the dynamic array is a dynamically resizing array.
  */
@@ -237,6 +570,7 @@ struct one_alist {
 	int capacity;                /* starts at ALIST_DEFAULT_CAP */
 	int used;                    /* how many things are there   */
 	uintptr_t *list;             /* open eneded array to anchor */
+	bool stable;                 /* grow in place, same handle  */
 };
 
 /*
@@ -251,6 +585,14 @@ struct one_alist {
  * helpful but it isn't strictly needed.
  *
  * delete's are deferred so a deleted flag is needed.
+ *
+ * each node also counts the nodes in its subtree, both all of them
+ * (for finding a scapegoat) and those not deleted (for rank and
+ * select).
+ *
+ * for string keys the node keeps the key's first eight bytes in a
+ * form that compares as an integer, most comparisons need go no
+ * further.
  */
 
 struct one_node {
@@ -258,8 +600,11 @@ struct one_node {
 	one_node *right;            /* really need for a sgt.        */
 	void *key;                  /* ..                            */
 	void *value;                /* ..                            */
+	uint64_t prefix;            /* of a string key               */
 	one_node *parent;           /* not required but helpful      */
 	bool deleted;               /* defer deletes to rebalance    */
+	int size;                   /* nodes in this subtree         */
+	int live;                   /* and how many aren't deleted   */
 };
 
 /*
@@ -279,6 +624,21 @@ enum one_key_type {
 };
 typedef enum one_key_type one_key_type;
 
+/*
+ * how a tree balances. a read mostly tree wants a low alpha to keep
+ * lookups short, a write heavy one wants a high alpha and lazy
+ * collection. the fields default to the ONE_REBALANCE_* and
+ * ONE_TOMBSTONE_SWEEP values.
+ */
+
+struct one_policy {
+	double alpha;               /* depth trigger, x log2(N)      */
+	int delete_percent;         /* deleted nodes trigger         */
+	int minimum;                /* no full rebalance below this  */
+	int sweep_budget;           /* nodes walked per mutation     */
+	bool rebalance_allowed;     /* mosty for testing             */
+};
+
 /*
  * the scapegoat tree. in addition to the root pointer and key
  * comparison information counters are kept to help decide when
@@ -289,7 +649,7 @@ struct one_tree {
 	one_node *root;             /* a tree grows here             */
 	one_key_comparator fn_cmp;  /* comparator function and type  */
 	one_key_type kt;            /* are provided at creation      */
-	bool rebalance_allowed;     /* mosty for testing             */
+	one_policy policy;          /* when to rebalance             */
 	int nodes;                  /* might drop this               */
 	int inserts;                /* count of specific api calls,  */
 	int deletes;                /* used to decide when to        */
@@ -297,13 +657,95 @@ struct one_tree {
 	int marked_deleted;         /* actual node removal deferred  */
 	int full_rebalances;        /* how many?                     */
 	int partial_rebalances;     /* just for fun                  */
+	double full_rebalance_time; /* and seconds spent in each     */
+	double partial_rebalance_time;
+	one_node *sweep;            /* where tombstone sweeps resume */
+	one_pool pool;              /* where the nodes come from     */
 };
 
 /*
  * a key value store, or an associative array, is just an api over
- * a binary search tree.
+ * a binary search tree or a hash table.
+ */
+
+/*
+ * a hash function for keys. integral and string keys have built in
+ * hash functions, custom keys need one from the client. keys that
+ * compare equal must hash equal.
+ */
+
+typedef uint64_t (*one_key_hasher)(
+	const void *key
+);
+
+/*
+ * the hash table uses open addressing with linear probing. a hash of
+ * zero marks an empty bucket, so a key that really hashes to zero is
+ * stored as one. deletes shift the rest of the probe run back instead
+ * of leaving tombstones.
  */
 
+struct hash_entry {
+	uint64_t hash;              /* 0 if empty                    */
+	void *key;
+	void *value;
+};
+
+struct one_hash {
+	hash_entry *table;          /* buckets                       */
+	one_key_comparator fn_cmp;  /* key equality                  */
+	one_key_hasher fn_hash;     /* and hashing                   */
+	one_key_type kt;            /* are provided at creation      */
+	int capacity;               /* a power of two                */
+	int entries;                /* buckets in use                */
+};
+
+/*
+ * the B+ tree. every node starts with a bp_node, which says whether
+ * it is a leaf and holds its keys. the keys and values are in the
+ * leaves. an inner node's keys only route a search, key[i] is at or
+ * below every key under child[i+1] and above every key under
+ * child[i].
+ *
+ * a snapshot shares nodes with the tree it was taken from, refs
+ * counts the roots and parents pointing at a node. the leaves aren't
+ * linked since a shared leaf has a different neighbour in each
+ * version. all the versions draw from one arena, which is freed
+ * along with the last of them.
+ */
+
+struct bp_node {
+	bool leaf;                  /* which kind of node follows    */
+	int count;                  /* keys in use                   */
+	int refs;                   /* versions or parents using it  */
+	void *key[ONE_BPLUS_KEYS];  /* in ascending order            */
+};
+
+struct bp_leaf {
+	bp_node h;                  /* must be first                 */
+	void *value[ONE_BPLUS_KEYS];
+};
+
+struct bp_inner {
+	bp_node h;                  /* must be first                 */
+	bp_node *child[ONE_BPLUS_KEYS + 1];
+};
+
+struct one_bplus {
+	bp_node *root;              /* NULL when empty               */
+	one_key_comparator fn_cmp;  /* comparator function and type  */
+	one_key_type kt;            /* are provided at creation      */
+	int entries;                /* keys held                     */
+	int height;                 /* levels, leaves are 1          */
+	bp_arena *arena;            /* shared with any snapshots     */
+};
+
+struct bp_arena {
+	one_pool leaves;            /* where the nodes come from     */
+	one_pool inners;
+	int versions;               /* trees drawing on the pools    */
+};
+
 /*
  * a priority queue. keys are signed longs. the keys don't have to be
  * unique, but we do want to properly order them.
@@ -327,6 +769,61 @@ struct pq_item {
 struct one_pqueue {
 	pq_item *first;
 	pq_item *last;
+	int length;                 /* items on the list             */
+	one_pool pool;
+};
+
+/*
+ * a priority queue backed by a binary heap. the heap is ordered on
+ * the highest priority, and the stamp breaks ties so that the oldest
+ * item at a priority comes out of the max end first and the newest
+ * out of the min end, as they do from the linked list backing.
+ */
+
+struct pq_slot {
+	long priority;
+	unsigned long stamp;        /* order of arrival */
+	void *item;
+};
+
+struct one_pqheap {
+	int length;                 /* slots in use */
+	int capacity;               /* slots allocated */
+	unsigned long stamp;        /* next arrival stamp */
+	pq_slot *heap;              /* heap[0] is the max */
+};
+
+/*
+ * a double ended priority queue built from two heaps over the same
+ * slots. heap[0] is ordered for the max and heap[1] for the min, and
+ * each slot knows where it sits in both heaps so that taking it from
+ * one end can remove it from the other.
+ *
+ * the two ends tie break in opposite directions, oldest from the max
+ * and newest from the min, so priority and then stamp is one total
+ * order over the slots.
+ */
+
+struct pq_dslot {
+	pq_slot s;                  /* priority, stamp, and item */
+	int at[2];                  /* index in heap[0] and heap[1] */
+};
+
+struct one_pqdual {
+	int length;                 /* slots in use */
+	int capacity;               /* slots allocated */
+	unsigned long stamp;        /* next arrival stamp */
+	pq_dslot *slot;             /* unordered, packed */
+	int *heap[2];               /* max and min heaps of slot indices */
+};
+
+/*
+ * a client's priority and item, for loading a whole pqueue at once.
+ */
+
+struct pq_pair {
+	long priority;
+	void *item;
 };
 
 /*
@@ -340,10 +837,33 @@ union one_details {
 	one_stack stk;               /* actually a singly linked list under the covers */
 	one_singly sgl;              /* singly linked list */
 	one_doubly dbl;              /* doubly linked list */
+	one_ring rng;                /* ring buffer */
+	one_intrusive itr;           /* links in the client's items */
+	one_spsc spq;                /* single producer bounded queue */
+	one_mpmc mpq;                /* multi producer bounded queue */
+	one_wsdeque wsd;             /* work stealing deque */
 	one_alist acc;               /* accumulator list */
 	one_dynarray dyn;            /* dynamically resizing array */
 	one_keyval kvl;              /* key:value store */
+	one_hash hsh;                /* hash backed key:value store */
+	one_bplus bpt;               /* B+ tree backed key:value store */
 	one_pqueue pqu;              /* priority queue */
+	one_pqheap pqh;              /* heap backed priority queue */
+	one_pqdual pqd;              /* dual heap backed priority queue */
+};
+
+/*
+ * the lock of a concurrent keyval, see make_one_concurrent. readers
+ * is the number of readers holding it, or -1 while a writer does.
+ * writers counts writers holding or waiting for it, and new readers
+ * hold off while it is above zero. a snapshot shares the lock of the
+ * store it was taken from, users counts them.
+ */
+
+struct one_rwlock {
+	atomic_int readers;
+	atomic_int writers;
+	atomic_int users;
 };
 
 /*
@@ -355,10 +875,32 @@ union one_details {
 
 struct one_block {
 	one_type isa;                /* this is-a what? */
+	one_backing backing;         /* built on what? */
 	char tag[ONE_TAG_LEN];       /* eye catcher for those of us who remember core dumps */
+	one_rwlock *lock;            /* NULL unless made concurrent */
 	one_details u;               /* what data structure sits under this instance? */
 };
 
+/*
+ * a cursor walks the items of any structure without allocating. the
+ * client owns the storage, usually on the stack, and the library
+ * keeps the position and current item in it. see begin, next, and
+ * done.
+ */
+
+struct one_cursor {
+	one_block *ob;               /* what is being walked */
+	void *at;                    /* current node of a linked structure */
+	int index;                   /* or current slot of an indexed one */
+	bool finished;               /* walked past the last item */
+	void *key;                   /* key of a keyval */
+	void *item;                  /* the item, or value of a keyval */
+	long priority;               /* priority of a pqueue item */
+	int depth;                   /* inner nodes above a B+ tree leaf */
+	bp_inner *path[ONE_CURSOR_DEPTH]; /* them, from the root down */
+	int slot[ONE_CURSOR_DEPTH];  /* and the child taken in each */
+};
+
 /*
  * create, destroy, and functions global to all data structures. all
  * entry points other than make_one(_keyed) and free_one tend to
@@ -380,6 +922,80 @@ make_one(
 	enum one_type isa
 );
 
+/*
+ * make_one_backed -- pqueue, stack, queue, deque
+ *
+ * as `make_one` but choosing the backing of the data structure.
+ * bk_default gives the same result as `make_one`.
+ *
+ * pqueue: bk_linked (default), bk_heap, or bk_dual_heap.
+ * stack, queue, deque: bk_linked (default) or bk_ring.
+ *
+ * returns NULL if the backing isn't available for the type.
+ */
+
+one_block *
+make_one_backed(
+	enum one_type isa,
+	enum one_backing backing
+);
+
+/*
+ * make_one_intrusive -- singly, doubly, stack, queue, deque
+ *
+ * as `make_one` but the links are in the items. the client embeds a
+ * one_link in its record and gives its offset:
+ *
+ *     struct job { int id; one_link link; ... };
+ *     one_block *q = make_one_intrusive(queue, offsetof(struct job, link));
+ *     enqueue(q, &a_job);
+ *     struct job *next = dequeue(q);
+ *
+ * the usual api then takes and returns pointers to the records.
+ * adding or removing an item allocates nothing and only touches its
+ * link and those of its neighbours. each link can be on one list at
+ * a time, a record on several lists needs a link for each. the
+ * records must stay put while they are on a list, and purge or
+ * free_one just lets go of them.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+make_one_intrusive(
+	one_type isa,
+	size_t offset
+);
+
+/*
+ * make_one_bounded -- spsc, mpmc
+ *
+ * as `make_one` but with the capacity of the queue, rounded up to a
+ * power of two. `make_one` gives ONE_BOUNDED_DEFAULT_CAPACITY.
+ *
+ * the bounded queues are for passing items between threads. an spsc
+ * must have only one thread enqueueing and one dequeueing at a time,
+ * an mpmc can have any number of each. they take the queue api:
+ *
+ * enqueue and dequeue wait, yielding the processor, while the queue
+ * is full or empty. try_enqueue, try_dequeue, enqueue_n, and
+ * dequeue_n never wait. items can't be NULL, since an empty queue
+ * gives NULL back.
+ *
+ * count and is_empty can be called by any thread, but only tell how
+ * things stood a moment ago. purge and free_one must only be called
+ * when no other thread is using the queue. there is no peek and no
+ * cursor, the item at the front may be taken at any moment.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+make_one_bounded(
+	one_type isa,
+	int capacity
+);
+
 /*
  * make_one_keyed -- keyval, pqueue
  *
@@ -394,6 +1010,130 @@ make_one_keyed(
 	one_key_comparator fncb
 );
 
+/*
+ * make_one_keyed_backed -- keyval
+ *
+ * as `make_one_keyed` but choosing the backing. bk_default gives the
+ * same result as `make_one_keyed`.
+ *
+ * keyval: bk_tree (default), bk_hash, or bk_bplus.
+ *
+ * the hash function is only used by bk_hash. as with the comparator
+ * it should be NULL for integral and string keys, and is required
+ * for custom keys.
+ */
+
+one_block *
+make_one_keyed_backed(
+	one_type isa,
+	one_backing backing,
+	one_key_type kt,
+	one_key_comparator fncb,
+	one_key_hasher fnhash
+);
+
+/*
+ * make_one_concurrent -- keyval
+ *
+ * as `make_one_keyed_backed` but the store can be shared by threads
+ * without any locking by the client. lookups run together under a
+ * shared lock, changes take it exclusively and run one at a time.
+ * a change never runs while a lookup is in the tree, so nothing a
+ * reader is visiting is freed or rebalanced under it.
+ *
+ * shared: get, exists, count, is_empty, range, in_, pre_, and
+ * post_order_keyed, floor_key, ceiling_key, first_key, last_key,
+ * rank, select_key, tombstones, keys, values, and sorted_keys.
+ *
+ * exclusive: insert, load_sorted, update, delete, purge, sweep, and
+ * snapshot.
+ *
+ * a traversal callback runs under the shared lock and must not call
+ * any of the above on the same store, not even get or exists. the
+ * lock isn't reentrant, and once a writer is waiting a second shared
+ * lock waits for it while it waits for the first. lower_bound and
+ * upper_bound position their cursor under the shared lock, but
+ * cursors (begin, next, lower_bound, upper_bound) hold no lock
+ * between calls, so use range instead while there are writers.
+ * free_one must be the last call on the store.
+ *
+ * the store doesn't make txballoc safe for threads. while tracing is
+ * active, only one thread at a time may allocate through it, see
+ * txballoc.h.
+ *
+ * a snapshot of a concurrent B+ tree shares its lock, as the two
+ * share nodes.
+ *
+ * the locks spin, yielding the processor, rather than sleep. they
+ * suit the short critical sections of a read mostly store.
+ */
+
+one_block *
+make_one_concurrent(
+	one_type isa,
+	one_backing backing,
+	one_key_type kt,
+	one_key_comparator fncb,
+	one_key_hasher fnhash
+);
+
+/*
+ * make_one_keyed_policy -- keyval
+ *
+ * as `make_one_keyed` but with the tree's balancing policy. start
+ * from default_policy and change what matters:
+ *
+ *     one_policy p = default_policy();
+ *     p.alpha = 2.0;
+ *     one_block *kv = make_one_keyed_policy(keyval, integral, NULL, &p);
+ *
+ * the policy is copied. a NULL policy gives the defaults.
+ *
+ * returns NULL on error, including an alpha not above 1.0.
+ */
+
+one_block *
+make_one_keyed_policy(
+	one_type isa,
+	one_key_type kt,
+	one_key_comparator fncb,
+	const one_policy *policy
+);
+
+/*
+ * default_policy -- keyval
+ *
+ * the policy built from the ONE_REBALANCE_* and ONE_TOMBSTONE_SWEEP
+ * settings.
+ */
+
+one_policy
+default_policy(
+	void
+);
+
+/*
+ * make_one_prioritized -- pqueue
+ *
+ * as `make_one_backed` but the new pqueue is loaded from the n
+ * pairs. the pairs are taken as having arrived in array order, so
+ * the queue is the same as if each had been added in turn with
+ * add_with_priority.
+ *
+ * the heap backings are built in O(n). the linked list is sorted and
+ * then linked, O(n log n). either beats n adds.
+ *
+ * the pairs are copied and can be reused by the client.
+ */
+
+one_block *
+make_one_prioritized(
+	one_type isa,
+	one_backing backing,
+	const pq_pair *pairs,
+	int n
+);
+
 /*
  * free_one -- all
  *
@@ -450,7 +1190,7 @@ purge(
  * clone -- all
  *
  * return a copy of the current structure. the original is
- * unchanged.
+ * unchanged. a B+ tree keyval is cloned by taking a snapshot.
  */
 
 one_block *
@@ -458,6 +1198,53 @@ clone(
 	one_block *ob
 );
 
+/*
+ * begin, next, done -- all
+ *
+ * walk the items of a structure through a client provided cursor,
+ * without allocating:
+ *
+ *     one_cursor c;
+ *     for (begin(ob, &c); !done(&c); next(&c))
+ *         ... c.item ...
+ *
+ * after begin or next, c.item holds the current item. for a keyval
+ * c.key and c.item hold the key and value, and for a pqueue
+ * c.priority holds the priority.
+ *
+ * the order is:
+ *
+ * singly, doubly, queue, deque: first to last, or front to back.
+ * stack: top to bottom.
+ * dynarray: index 0 through high_index, empty slots included.
+ * alist: index 0 through count-1.
+ * keyval: ascending key order on a tree, skipping deleted keys, or
+ *         on a B+ tree. on a hash table, bucket order.
+ * pqueue: lowest to highest priority on the linked list. on the heap
+ *         backings, storage order.
+ *
+ * the structure must not be changed while a cursor is on it.
+ *
+ * begin returns the cursor or NULL on error, which leaves the cursor
+ * done. next returns the cursor.
+ */
+
+one_cursor *
+begin(
+	one_block *ob,
+	one_cursor *cur
+);
+
+one_cursor *
+next(
+	one_cursor *cur
+);
+
+bool
+done(
+	const one_cursor *cur
+);
+
 /*
  * these are possibly likely entry points for many of the data
  * structure. they are definitely the entry points for singly and
@@ -541,6 +1328,8 @@ get_first(
  * get_last -- singly
  *
  * remove and return the item at the back/bottom of all items held.
+ * a singly linked list has to walk to the item before the last, the
+ * other ends are constant time.
  *
  * returns NULL on error.
  */
@@ -550,14 +1339,39 @@ get_last(
 	one_block *ob
 );
 
+/*
+ * splice -- singly, doubly
+ *
+ * move all the items of other onto the end of ob, in constant time.
+ * the lists must be of the same type. the nodes don't move, ob takes
+ * over other's node storage along with them. other is left empty and
+ * can still be used. intrusive lists must both be intrusive, with
+ * their links at the same offset.
+ *
+ * returns ob, or NULL on error.
+ */
+
+one_block *
+splice(
+	one_block *ob,
+	one_block *other
+);
+
 /*
  * a stack is implemented on a singly linked list, but use the
  * following entry points in addition to make_one, free_one, is_empty,
  * and purge.
+ *
+ * a wsdeque is a stack to the thread that owns it, using push and
+ * pop, and a queue to any other thread, using steal. the owner is
+ * whichever thread pushes and pops, only one may. count and is_empty
+ * are only a snapshot while thieves are about. purge and free_one
+ * must only be called when no other thread is using the deque.
+ * items can't be NULL, since an empty deque gives NULL back.
  */
 
 /*
- * push -- stack
+ * push -- stack, wsdeque
  *
  * an item onto the stack.
  *
@@ -571,7 +1385,7 @@ push(
 );
 
 /*
- * pop -- stack
+ * pop -- stack, wsdeque
  *
  * an item off the stack.
  *
@@ -583,6 +1397,21 @@ pop(
 	one_block *ob
 );
 
+/*
+ * steal -- wsdeque
+ *
+ * take the oldest item from the other end of the owner's stack. any
+ * thread but the owner can steal. a thief that loses a race for an
+ * item tries again as long as there are items.
+ *
+ * returns the item, or NULL if there are none or on error.
+ */
+
+void *
+steal(
+	one_block *ob
+);
+
 /*
  * peek -- stack
  *
@@ -618,9 +1447,10 @@ depth(
  */
 
 /*
- * enqueue -- queue
+ * enqueue -- queue, spsc, mpmc
  *
- * add an item to the back of the queue.
+ * add an item to the back of the queue. a bounded queue waits until
+ * there is room.
  *
  * returns NULL on error.
  */
@@ -632,9 +1462,10 @@ enqueue(
 );
 
 /*
- * dequeue
+ * dequeue -- queue, spsc, mpmc
  *
- * remove an item from the front of the queue.
+ * remove an item from the front of the queue. a bounded queue waits
+ * until there is one.
  *
  * returns NULL on error.
  */
@@ -644,6 +1475,67 @@ dequeue(
 	one_block *ob
 );
 
+/*
+ * try_enqueue -- queue, spsc, mpmc
+ *
+ * add an item to the back of the queue if there is room. an unbounded
+ * queue always has room.
+ *
+ * returns false if the queue is full or on error.
+ */
+
+bool
+try_enqueue(
+	one_block *ob,
+	void *item
+);
+
+/*
+ * try_dequeue -- queue, spsc, mpmc
+ *
+ * remove an item from the front of the queue if there is one.
+ *
+ * returns the item, or NULL if the queue is empty or on error.
+ */
+
+void *
+try_dequeue(
+	one_block *ob
+);
+
+/*
+ * enqueue_n -- queue, spsc, mpmc
+ *
+ * add as many of the n items as there is room for, in order, without
+ * waiting. a bounded queue publishes them all at once, and refuses
+ * the lot if any of them is NULL.
+ *
+ * returns the number added, or -1 on error.
+ */
+
+int
+enqueue_n(
+	one_block *ob,
+	void **items,
+	int n
+);
+
+/*
+ * dequeue_n -- queue, spsc, mpmc
+ *
+ * remove up to n items from the front of the queue into items,
+ * without waiting.
+ *
+ * returns the number removed, or -1 on error.
+ */
+
+int
+dequeue_n(
+	one_block *ob,
+	void **items,
+	int n
+);
+
 /*
  * a deque (f/l-ifo)is built on a doubly linked list, but use the
  * following entry points in addition to make_one, free_one, is_empty,
@@ -749,6 +1641,9 @@ peek_front(
  * add an item to th end of the list. the list will grow if needed. if
  * it does, the value returned will be a pointer to the new alist, and
  * the old alist will have been freed.
+ *
+ * if the list can't grow NULL is returned and the old alist is left
+ * as it was, so hold on to it until you've checked.
  */
 
 one_block *
@@ -757,6 +1652,25 @@ cons(
 	uintptr_t atom
 );
 
+/*
+ * stable_handle -- alist
+ *
+ * choose how the list grows. by default growth copies the list to a
+ * new one_block and frees the old one, so callers must always use the
+ * handle they get back. with stable set, only the list storage is
+ * reallocated and the handle never changes. the returned handle is
+ * still the one to use, so code written for either mode works in
+ * both.
+ *
+ * returns the instance or NULL on error.
+ */
+
+one_block *
+stable_handle(
+	one_block *ob,
+	bool stable
+);
+
 /*
  * car -- alist
  *
@@ -805,6 +1719,43 @@ append(
 	one_block *other
 );
 
+/*
+ * append_n -- dynarray, alist
+ *
+ * add n pointer sized items from an array (void * for a dynarray,
+ * uintptr_t for an alist) to the end of the structure. for a
+ * dynarray they go in after high_index. the capacity is checked once
+ * and the items are copied in one block.
+ *
+ * as with cons, an alist that grows comes back as a new handle
+ * unless it was marked with stable_handle, and one that can't grow
+ * gives NULL and is left as it was.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+append_n(
+	one_block *ob,
+	const void *items,
+	int n
+);
+
+/*
+ * extend -- dynarray, alist
+ *
+ * append_n all of the items of another dynarray or alist, in order.
+ * the other structure is unchanged.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+extend(
+	one_block *ob,
+	one_block *other
+);
+
 /*
  * slice -- alist
  *
@@ -892,8 +1843,8 @@ high_index(
  * put_at -- dynarray
  *
  * place a payload at a particular index in the array. if the array's
- * capacity is less than the index, double the capacity until the
- * index is valid.
+ * capacity is less than the index, it grows in one step to the next
+ * power of two that holds the index.
  *
  * returns NULL on error.
  */
@@ -922,10 +1873,41 @@ get_from(
 	int n
 );
 
+/*
+ * reserve -- dynarray
+ *
+ * grow the array so that at least n items fit without further
+ * growth. the capacity is rounded up to a power of two. reserve never
+ * shrinks the array.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+reserve(
+	one_block *ob,
+	int n
+);
+
+/*
+ * shrink_to_fit -- dynarray
+ *
+ * release any capacity past high_index. a later put_at beyond the
+ * end grows the array again.
+ *
+ * returns NULL on error.
+ */
+
+one_block *
+shrink_to_fit(
+	one_block *ob
+);
+
 /*
  * a key:value store is one way of thinking of an associative array or
  * dictionary. this implementation is built on a scapegoat binary
- * search tree.
+ * search tree, or on a hash table when made with bk_hash, or on a
+ * B+ tree when made with bk_bplus.
  *
  * the usual functions for any keyed access method are available, but
  * i prefer `insert` to `create` and `get` to `read`, so no crud here.
@@ -945,6 +1927,49 @@ insert(
 	void *value
 );
 
+/*
+ * load_sorted -- keyval
+ *
+ * fill an empty store from n keys in strictly ascending order and
+ * their values, keys[i] going with values[i]. a tree or B+ tree is
+ * built directly in O(n), already balanced, rather than by n inserts.
+ * a hash table is filled by inserts.
+ *
+ * the arrays are not kept and can be reused by the client.
+ *
+ * returns the store, or NULL if it isn't empty or a key is out of
+ * order or repeated. nothing is loaded on error.
+ */
+
+one_block *
+load_sorted(
+	one_block *ob,
+	void **keys,
+	void **values,
+	int n
+);
+
+/*
+ * snapshot -- keyval
+ *
+ * take a copy of the store as it is now, in O(1). the copy is a
+ * keyval in its own right and both can be changed afterward without
+ * the other seeing it. until they are, they share every node, and
+ * a change only copies the nodes on its path down the tree.
+ *
+ * only a B+ tree (bk_bplus) can be snapshot. keys and values are
+ * shared, not copied, so the client must keep them alive as long as
+ * any copy holds them. each copy is released with free_one, in any
+ * order.
+ *
+ * returns the copy, or NULL on error.
+ */
+
+one_block *
+snapshot(
+	one_block *ob
+);
+
 /*
  * get -- keyval
  *
@@ -1003,7 +2028,9 @@ exists(
  * in_ pre_ and post_order_keyed -- keyval
  *
  * key:value traversal (iteration) requiring a client supplied
- * callback function.
+ * callback function. not available for a hash backed store. a B+
+ * tree backed store only has in order, and its callbacks get NULL
+ * for the tree.
  */
 
 /*
@@ -1056,7 +2083,10 @@ post_order_keyed(
 /*
  * keys -- keyval
  *
- * returns an alist of the keys in the store in ascending order.
+ * returns an alist of the keys in the store in ascending order. for
+ * a hash backed store the keys are in no particular order.
+ *
+ * to walk the keys without building a list, use a cursor.
  */
 
 one_block *
@@ -1067,7 +2097,8 @@ keys(
 /*
  * values -- keyval
  *
- * returns an alist of the values in the store in their key order.
+ * returns an alist of the values in the store in their key order. for
+ * a hash backed store they are in the same order as keys returns.
  */
 
 one_block *
@@ -1076,7 +2107,179 @@ values(
 );
 
 /*
- * priority queue -- probably built on a double linked list with a key.
+ * sorted_keys -- keyval
+ *
+ * returns an alist of the keys in ascending order regardless of
+ * backing. for a tree this is keys, for a hash table the keys are
+ * sorted after they are collected.
+ */
+
+one_block *
+sorted_keys(
+	one_block *ob
+);
+
+/*
+ * range -- keyval
+ *
+ * call the client's callback for each key in [lo, hi], in ascending
+ * order, as in_order_keyed does for the whole store. the callback
+ * returns `false` to stop early. finding lo is O(log n), after which
+ * each key costs O(1) amortized, and deleted keys are skipped.
+ *
+ * returns the number of callbacks made, or -1 on error or for a hash
+ * backed store, which has no order.
+ */
+
+int
+range(
+	one_block *ob,
+	void *lo,
+	void *hi,
+	void *context,
+	fn_traversal_cb fn
+);
+
+/*
+ * lower_bound, upper_bound -- keyval
+ *
+ * position a cursor on the first key at or above (lower_bound) or
+ * strictly above (upper_bound) the key. next then walks the rest of
+ * the keys in ascending order, so a scan from a key needs no
+ * callback.
+ *
+ * returns the cursor, or NULL on error or for a hash backed store.
+ * the cursor is done if there is no such key.
+ */
+
+one_cursor *
+lower_bound(
+	one_block *ob,
+	void *key,
+	one_cursor *cur
+);
+
+one_cursor *
+upper_bound(
+	one_block *ob,
+	void *key,
+	one_cursor *cur
+);
+
+/*
+ * floor_key, ceiling_key -- keyval
+ *
+ * the greatest key at or below, and the least key at or above, the
+ * key. first_key and last_key are the least and greatest keys held.
+ * all are O(log n) on the tree and not available on a hash table.
+ *
+ * returns the key, or NULL if there is none or on error. if a NULL
+ * (or 0) key is in use, check with exists.
+ */
+
+void *
+floor_key(
+	one_block *ob,
+	void *key
+);
+
+void *
+ceiling_key(
+	one_block *ob,
+	void *key
+);
+
+void *
+first_key(
+	one_block *ob
+);
+
+void *
+last_key(
+	one_block *ob
+);
+
+/*
+ * tombstones -- keyval
+ *
+ * how many deleted keys are still taking up nodes in the tree. hash
+ * and B+ tree backed stores remove keys outright and always have
+ * none.
+ *
+ * returns the count or -1 on error.
+ */
+
+int
+tombstones(
+	one_block *ob
+);
+
+/*
+ * sweep -- keyval
+ *
+ * collect deleted nodes a little at a time. walk at most budget nodes
+ * in key order, resuming where the last sweep stopped and wrapping at
+ * the end, and remove any deleted nodes passed. each removal is
+ * O(log n). a budget of 0 or less sweeps until none are left.
+ *
+ * inserts and deletes already sweep the policy's sweep_budget nodes
+ * on their own. call this from idle time to do more.
+ *
+ * returns the number of deleted nodes removed or -1 on error.
+ */
+
+int
+sweep(
+	one_block *ob,
+	int budget
+);
+
+/*
+ * rank -- keyval
+ *
+ * how many keys are less than the key. if the key is held, this is
+ * its position in key order counting from 0. O(log n) on the tree.
+ *
+ * returns the rank, or -1 on error or for a hash or B+ tree backed
+ * store, which don't keep the counts.
+ */
+
+int
+rank(
+	one_block *ob,
+	void *key
+);
+
+/*
+ * select_key -- keyval
+ *
+ * the key at position i in key order, counting from 0, so that
+ * rank(ob, select_key(ob, i)) == i. O(log n) on the tree. named to
+ * stay clear of the posix select.
+ *
+ * returns the key, or NULL if i is out of range or on error.
+ */
+
+void *
+select_key(
+	one_block *ob,
+	int i
+);
+
+/*
+ * priority queue -- built on a doubly linked list with a key, or on
+ * heaps if created via make_one_backed(pqueue, bk_heap or
+ * bk_dual_heap).
+ *
+ * every backing returns the oldest item among those of equal
+ * priority first from the max end, and the newest first from the
+ * min end.
+ *
+ * on the linked list adds are O(n) and everything else is O(1). on
+ * the heap adds and get_max are O(log n), peek_max and max_priority
+ * are O(1), and the min side functions have to scan, O(n). on the
+ * dual heap adds and both gets are O(log n) and the peeks and
+ * priorities are O(1).
  *
  * returns NULL on error.
  */
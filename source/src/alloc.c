@@ -82,6 +82,8 @@
  * t(s)malloc(n)           -- allocate 'n' bytes
  * t(s)calloc(c, n)        -- allocate and zero contiguous memory
  *                            to hold 'c' blocks each of 'n' bytes
+ * t(s)realloc(p, n)       -- resize the allocated memory at 'p' to
+ *                            'n' bytes, possibly moving it
  * t(s)free(p)             -- free the allocated memory at 'p'
  *
  * The reporting option bits will report allocations (malloc, calloc),
@@ -283,6 +285,73 @@ txballoc_malloc(
 	return pool->table[i].addr;
 }
 
+/*
+ * txballoc_realloc
+ *
+ * hook for tracing realloc calls.
+ *
+ *     in: address of c/malloc to resize, or NULL
+ *
+ *     in: size_t new length in bytes
+ *
+ *     in: string __FILE__
+ *
+ *     in: integer __LINE__
+ *
+ * return: address of the resized storage
+ *
+ * If tracing is not active, pass the request straight through to
+ * realloc.
+ *
+ * If tracing is active, a NULL address is a malloc. Otherwise find
+ * the entry for the allocation and update its address and size after
+ * the realloc. The entry keeps its original allocation number, file,
+ * and line.
+ *
+ * If the allocation isn't in the trace table, report it and return
+ * NULL without touching the memory.
+ */
+
+void *
+txballoc_realloc(
+	void *p,
+	size_t n,
+	bool user_or_libs,
+	char *f,
+	int l
+) {
+	pool *pool = user_or_libs ? &user_pool : &library_pool;
+	if (!pool->active) return realloc(p, n);
+	if (!p) return txballoc_malloc(n, user_or_libs, f, l);
+
+	int i;
+	for (i = 0; i < pool->capacity; i++)
+		if (pool->table[i].addr == p)
+			break;
+
+	if (i >= pool->capacity) {
+		char *ft = file_basename(f);
+		if (pool->flags & txballoc_f_errors)
+			fprintf(pool->report,
+				"error: %5d %p for %s %d -- realloc not in trace\n",
+				pool->odometer, p, ft, l);
+		return NULL;
+	}
+
+	void *q = realloc(p, n);
+	if (!q) return NULL;
+
+	if (pool->flags & txballoc_f_allocs) {
+		char *ft = file_basename(f);
+		fprintf(pool->report, "realc: %5d %p len %lu -> %p len %lu for %s %d\n",
+			pool->table[i].number, pool->table[i].addr, pool->table[i].size, q, n, ft, l);
+	}
+
+	pool->table[i].addr = q;
+	pool->table[i].size = n;
+	return q;
+}
+
 /*
  * txballoc_free
  *
@@ -22,8 +22,13 @@
  * to copy, modify, publish, and distribute this file as you see fit.
  */
 
+#include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sched.h>
 #include <string.h>
+#include <time.h>
 
 #include "../inc/alloc.h"
 #include "../inc/one.h"
@@ -33,6 +38,14 @@
 #ifndef FPRINTF_INFO
 #define FPRINTF_INFO if (false)
 #endif
+
+/* scrub storage that is being given up so that stale pointers show
+ * up quickly. only in debug builds, release builds define NDEBUG. */
+#ifdef NDEBUG
+#define ONE_POISON(p, n) ((void)0)
+#else
+#define ONE_POISON(p, n) memset((p), 253, (n))
+#endif
 
 /*
  * This is a copy paste from my txblog2 header, which implements a
@@ -135,6 +148,9 @@ one_tags[] = {
 	"dynamic array",         /* dynarray */
 	"key:value store",       /* keyval */
 	"priority queue",        /* pqueue */
+	"spsc bounded queue",    /* spsc */
+	"mpmc bounded queue",    /* mpmc */
+	"work stealing deque",   /* wsdeque */
 	"unknowable",         /* -- end of list -- */
 	NULL
 };
@@ -149,11 +165,115 @@ one_tags[] = {
 static
 void
 btree_node_free(one_tree *, one_node *);
+
+/*
+ * node pools for the linked structures and the tree. nodes are handed
+ * out from the free list, and when that is empty a new slab is carved
+ * up onto it. the first word of a free node links to the next free
+ * node.
+ *
+ * every node in a pool is the same size, the caller passes it on each
+ * take so the pool doesn't have to be told its node type up front.
+ */
 
 static
-int
-btree_node_children_free(one_tree *, one_node *);
-
+void *
+pool_take(
+	one_pool *self,
+	size_t size
+) {
+	if (!self->free) {
+		if (self->next_slab < ONE_POOL_FIRST_SLAB)
+			self->next_slab = ONE_POOL_FIRST_SLAB;
+		int n = self->next_slab;
+		one_slab *slab = tsmalloc(sizeof(one_slab) + n * size);
+		slab->next = self->slabs;
+		slab->nodes = n;
+		if (!self->slabs)
+			self->oldest = slab;
+		self->slabs = slab;
+		self->slab_count += 1;
+		if (self->next_slab < ONE_POOL_MAX_SLAB)
+			self->next_slab *= 2;
+		/* thread the nodes so the lowest address comes off first */
+		char *node = (char *)(slab + 1) + (n - 1) * size;
+		self->free_last = node;
+		for (int i = 0; i < n; i++, node -= size) {
+			*(void **)node = self->free;
+			self->free = node;
+		}
+	}
+	void *node = self->free;
+	self->free = *(void **)node;
+	memset(node, 0, size);
+	return node;
+}
+
+static
+void
+pool_give(
+	one_pool *self,
+	void *node,
+	size_t size
+) {
+	ONE_POISON(node, size);
+	if (!self->free)
+		self->free_last = node;
+	*(void **)node = self->free;
+	self->free = node;
+}
+
+/*
+ * hand all of other's slabs and free nodes to self, leaving other
+ * empty. nodes in use stay where they are, only their ownership
+ * changes. both pools must hold nodes of the same size.
+ */
+
+static
+void
+pool_merge(
+	one_pool *self,
+	one_pool *other
+) {
+	if (other->slabs) {
+		other->oldest->next = self->slabs;
+		if (!self->slabs)
+			self->oldest = other->oldest;
+		self->slabs = other->slabs;
+	}
+	if (other->free) {
+		*(void **)other->free_last = self->free;
+		if (!self->free)
+			self->free_last = other->free_last;
+		self->free = other->free;
+	}
+	self->slab_count += other->slab_count;
+	if (self->next_slab < other->next_slab)
+		self->next_slab = other->next_slab;
+	memset(other, 0, sizeof(*other));
+}
+
+/*
+ * release every slab. any nodes still in use are gone with them, so
+ * this is only for purge and free_one.
+ */
+
+static
+void
+pool_release(
+	one_pool *self,
+	size_t size
+) {
+	one_slab *slab = self->slabs;
+	while (slab) {
+		one_slab *next = slab->next;
+		ONE_POISON(slab, sizeof(one_slab) + slab->nodes * size);
+		tsfree(slab);
+		slab = next;
+	}
+	memset(self, 0, sizeof(*self));
+}
+
 /*
  * a singly linked list (singly) behaves as one would expect, and
  * the parameters of it functions should all be obvious. this
@@ -171,11 +291,13 @@ btree_node_children_free(one_tree *, one_node *);
 static
 one_singly *
 singly_add_first(one_singly *self, void *item) {
-	sgl_item *next = tsmalloc(sizeof(*next));
-	memset(next, 0, sizeof(*next));
+	sgl_item *next = pool_take(&self->pool, sizeof(*next));
 	next->item = item;
 	next->next = self->first;
+	if (!self->first)
+		self->last = next;
 	self->first = next;
+	self->length += 1;
 	return self;
 }
 
@@ -193,46 +315,37 @@ singly_get_first(one_singly *self) {
 	if (!first)
 		return NULL;
 	self->first = first->next;
+	if (!self->first)
+		self->last = NULL;
+	self->length -= 1;
 	void *res = first->item;
-	memset(first, 253, sizeof(*first));
-	tsfree(first);
+	pool_give(&self->pool, first, sizeof(*first));
 	return res;
 }
 
 static
 one_singly *
 singly_add_last(one_singly *self, void *item) {
-	sgl_item *next = tsmalloc(sizeof(*next));
-	memset(next, 0, sizeof(*next));
+	sgl_item *next = pool_take(&self->pool, sizeof(*next));
 	next->item = item;
+	self->length += 1;
 
 	/* empty list is dead simple */
 	if (!self->first) {
 		self->first = next;
+		self->last = next;
 		return self;
 	}
 
-	/* find current end and link */
-	sgl_item *curr = self->first;
-	while (curr->next)
-		curr = curr->next;
-	curr->next = next;
+	self->last->next = next;
+	self->last = next;
 	return self;
 }
 
 static
 void *
 singly_peek_last(one_singly *self) {
-	sgl_item *curr = self->first;
-	if (!curr)
-		return NULL;
-
-	/* chase to end. */
-	while (curr->next)
-		curr = curr->next;
-
-	/* and item back */
-	return curr->item;
+	return self->last ? self->last->item : NULL;
 }
 
 static
@@ -255,39 +368,51 @@ singly_get_last(one_singly *self) {
 		previous->next = NULL;
 	else
 		self->first = NULL;
+	self->last = previous;
+	self->length -= 1;
 
 	/* extract item, clear and free old item */
 	void *res = curr->item;
-	memset(curr, 253, sizeof(*curr));
-	tsfree(curr);
+	pool_give(&self->pool, curr, sizeof(*curr));
 	return res;
 }
 
 static
 int
 singly_count(one_singly *self) {
-	int count = 0;
-	sgl_item *curr = self->first;
-	while (curr) {
-		count += 1;
-		curr = curr->next;
+	return self->length;
+}
+
+/*
+ * move other's items onto the end of self, taking its pool.
+ */
+
+static
+one_singly *
+singly_splice(one_singly *self, one_singly *other) {
+	if (other->first) {
+		if (self->last)
+			self->last->next = other->first;
+		else
+			self->first = other->first;
+		self->last = other->last;
+		self->length += other->length;
 	}
-	return count;
+	pool_merge(&self->pool, &other->pool);
+	other->first = NULL;
+	other->last = NULL;
+	other->length = 0;
+	return self;
 }
 
 static
 int
 singly_purge(one_singly *self) {
-	int count = 0;
-	sgl_item *curr = self->first;
+	int count = self->length;
 	self->first = NULL;
-	while (curr) {
-		count += 1;
-		sgl_item *del = curr;
-		curr = curr->next;
-		memset(del, 253, sizeof(*del));
-		tsfree(del);
-	}
+	self->last = NULL;
+	self->length = 0;
+	pool_release(&self->pool, sizeof(sgl_item));
 	return count;
 }
 
@@ -299,11 +424,11 @@ singly_purge(one_singly *self) {
 static
 one_doubly *
 doubly_add_first(one_doubly *self, void *item) {
-	dbl_item *first = tsmalloc(sizeof(*first));
-	memset(first, 0, sizeof(*first));
+	dbl_item *first = pool_take(&self->pool, sizeof(*first));
 	first->item = item;
 	first->next = self->first;
 	first->previous = NULL;
+	self->length += 1;
 
 	/* empty list, easy peasy */
 	if (!self->first) {
@@ -331,25 +456,25 @@ doubly_get_first(one_doubly *self) {
 
 	dbl_item *first = self->first;
 	self->first = first->next;
+	self->length -= 1;
 
 	if (first->next)
 		first->next->previous = NULL;
 	else self->last = NULL;
 
 	void *res = first->item;
-	memset(first, 253, sizeof(*first));
-	tsfree(first);
+	pool_give(&self->pool, first, sizeof(*first));
 	return res;
 }
 
 static
 one_doubly *
 doubly_add_last(one_doubly *self, void *item) {
-	dbl_item *last = tsmalloc(sizeof(*last));
-	memset(last, 0, sizeof(*last));
+	dbl_item *last = pool_take(&self->pool, sizeof(*last));
 	last->item = item;
 	last->previous = self->last;
 	last->next = NULL;
+	self->length += 1;
 
 	/* empty list is easy peasy */
 	if (!self->first) {
@@ -377,6 +502,7 @@ doubly_get_last(one_doubly *self) {
 
 	dbl_item *last = self->last;
 	self->last = last->previous;
+	self->length -= 1;
 
 	/* watch for the only item on the list */
 	if (last->previous)
@@ -387,1133 +513,3926 @@ doubly_get_last(one_doubly *self) {
 	}
 
 	void *res = last->item;
-	memset(last, 253, sizeof(*last));
-	tsfree(last);
+	pool_give(&self->pool, last, sizeof(*last));
 	return res;
 }
 
 static
 int
 doubly_count(one_doubly *self) {
-	int count = 0;
-	dbl_item *curr = self->first;
-	while (curr) {
-		count += 1;
-		curr = curr->next;
+	return self->length;
+}
+
+static
+one_doubly *
+doubly_splice(one_doubly *self, one_doubly *other) {
+	if (other->first) {
+		other->first->previous = self->last;
+		if (self->last)
+			self->last->next = other->first;
+		else
+			self->first = other->first;
+		self->last = other->last;
+		self->length += other->length;
 	}
-	return count;
+	pool_merge(&self->pool, &other->pool);
+	other->first = NULL;
+	other->last = NULL;
+	other->length = 0;
+	return self;
 }
 
 static
 int
 doubly_purge(one_doubly *self) {
-	int count = 0;
-	dbl_item *curr = self->first;
+	int count = self->length;
 	self->first = NULL;
 	self->last = NULL;
-	while (curr) {
-		count += 1;
-		dbl_item *del = curr;
-		curr = curr->next;
-		memset(del, 253, sizeof(*del));
-		tsfree(del);
-	}
+	self->length = 0;
+	pool_release(&self->pool, sizeof(dbl_item));
 	return count;
 }
 
 /*
- * the accumulator list (alist) is a cross between a java array list and a
- * lisp or sml list. while it has some similarities to the dynamic array
- * i kept the implementations separate to avoid special subtype specific
- * conditionals from cruding up the code.
- *
- * the motivation for the alist as that it provide the functionality of
- * lists in recursions.
- *
- * as the list is stored separately from it's controlling self block,
- * the external api passes the whole one_block.
- *
- * some operations (slice) create copies of a portion of the alist. in
- * a java array list, this would just be a view over the array list.
- *
- * the api convention is the returned list is meant to replace the
- * primary list in arguments. if the list has been significantly
- * mutated, the original primary list is freed and an updated
- * copy is returned.
+ * a ring buffer (ring) can back a stack, queue, or deque in place of
+ * the linked lists. items are pointers held in a circular array that
+ * doubles when full, so there is no allocation per item.
  *
- * always use the array list you get back from an api call, not the
- * one you sent in.
- *
- * repeat: ALWAYS USE THE ARRAY LIST YOU GET BACK FROM AN API CALL,
- * NOT THE ONE YOU SENT IN.
- *
- * for illustration, here is an example where consing repeatedly
- * will force the alist to grow, creating a new list and destroying
- * the old list. the default allocation is ALIST_DEFAULT_CAPACITY.
- *
- * one_block *xs = make_one(alist);
- * one_block *remember = xs;
- * for (int i = 0; i > ALIST_DEFAULT_CAP * 2; i++)
- *         xs = cons_to_alist(xs, (uintptr_t)i);
- * assert(remember != xs);
- * xs = free_one(xs);
- * assert(xs == NULL);
- *
- * 'remember' holds the original address of 'xs', but that storage was
- * released when 'xs' was expanded.
- *
- * some of the api is inspired by the java arraylist, and the rest
- * from lisp. it's pseudo lisp lists with fake garbage collection.
+ * the front of the ring is slot head, the back is the slot length-1
+ * past it, wrapping. a stack pushes and pops at the back.
  */
 
 static
-int
-alist_purge(one_block *xs) {
-	int ret = xs->u.acc.used;
-	xs->u.acc.used = 0;
-	memset(xs->u.acc.list, 0, ret * sizeof(uintptr_t));
-	return ret;
+void
+ring_grow(
+	one_ring *self
+) {
+	int cap = self->capacity * 2;
+	void **slot = tsmalloc(cap * sizeof(void *));
+	memset(slot, 0, cap * sizeof(void *));
+
+	/* unwrap into the front of the new array */
+	int mask = self->capacity - 1;
+	for (int i = 0; i < self->length; i++)
+		slot[i] = self->slot[(self->head + i) & mask];
+
+	ONE_POISON(self->slot, self->capacity * sizeof(void *));
+	tsfree(self->slot);
+	self->slot = slot;
+	self->capacity = cap;
+	self->head = 0;
 }
 
-/*
- * add something that fits in a unintprt_t (currently 8 bytes) to the
- * end of the array list.
- */
+static
+void
+ring_push_front(
+	one_ring *self,
+	void *item
+) {
+	if (self->length == self->capacity)
+		ring_grow(self);
+	self->head = (self->head - 1) & (self->capacity - 1);
+	self->slot[self->head] = item;
+	self->length += 1;
+}
 
 static
-one_block *
-alist_cons(one_block *xs, uintptr_t p) {
-	if (xs->u.acc.used == xs->u.acc.capacity) {
-		int lena = xs->u.acc.capacity * sizeof(uintptr_t);
-		one_block *new = tsmalloc(sizeof(*xs));
-		memcpy(new, xs, sizeof(*xs));
-		uintptr_t *acc = tsmalloc(lena * 2);
-		memset(acc, 0, lena * 2);
-		memcpy(acc, xs->u.acc.list, lena);
-		new->u.acc.capacity = xs->u.acc.capacity * 2;
-		new->u.acc.list = acc;
-		free_one(xs);
-		xs = new;
-	}
-	xs->u.acc.list[xs->u.acc.used] = p;
-	xs->u.acc.used += 1;
-	return xs;
+void
+ring_push_back(
+	one_ring *self,
+	void *item
+) {
+	if (self->length == self->capacity)
+		ring_grow(self);
+	self->slot[(self->head + self->length) & (self->capacity - 1)] = item;
+	self->length += 1;
 }
 
-/*
- * create a new alist of the contents from inclusive->to exclusive.
- *
- * ie, [from, to) in standard mathematic notation.
- *
- * this does not have the same semantics as the java arraylist
- * sublist. here we create an entirely new list holding only the
- * elements requested. i've gone with 'slice' as more intention
- * revealing.
- *
- * the original list is preserved.
- */
+static
+void *
+ring_peek_front(
+	one_ring *self
+) {
+	return self->length ? self->slot[self->head] : NULL;
+}
 
 static
-one_block *
-alist_slice(one_block *xs, int from_inclusive, int to_exclusive) {
-	if (to_exclusive > xs->u.acc.used || from_inclusive < 0) {
-		fprintf(stderr,
-			"\nERROR txbone-slice: range out of bounds holds [0..%d) requested [%d..%d)\n",
-			xs->u.acc.used, from_inclusive, to_exclusive);
+void *
+ring_peek_back(
+	one_ring *self
+) {
+	if (!self->length)
 		return NULL;
-	}
-	one_block *res = make_one(alist);
-	/* to be explicit about this. */
-	if (from_inclusive >= to_exclusive)
-		return res;
-
-	for (int i = from_inclusive; i < to_exclusive; i++)
-		res = alist_cons(res, xs->u.acc.list[i]);
-	return res;
+	return self->slot[(self->head + self->length - 1) & (self->capacity - 1)];
 }
 
-/*
- * an iterator of sorts over the alist. call it repeatedly and *index
- * *index is updated. reaching the end of the array list is signalled
- * by *index == -1.
- */
-
 static
-uintptr_t
-alist_iterate(one_block *xs, int *curr) {
-	if (*curr < 0)
-		return 0;
-	if (!xs || xs->u.acc.used < 1)
-		return 0;
-	if (*curr >= xs->u.acc.used) {
-		*curr = -1;  /* as a null might be valid, use a negative count to also signal end */
-		return 0;
-	}
-	uintptr_t res = xs->u.acc.list[*curr];
-	*curr += 1;
+void *
+ring_pop_front(
+	one_ring *self
+) {
+	if (!self->length)
+		return NULL;
+	void *res = self->slot[self->head];
+	self->head = (self->head + 1) & (self->capacity - 1);
+	self->length -= 1;
 	return res;
 }
 
 static
-one_block *
-alist_cdr(one_block *xs) {
-	return alist_slice(xs, 1, xs->u.acc.used);;
+void *
+ring_pop_back(
+	one_ring *self
+) {
+	if (!self->length)
+		return NULL;
+	self->length -= 1;
+	return self->slot[(self->head + self->length) & (self->capacity - 1)];
 }
 
-/*
- * creates a shallow copy of an array list.
- */
-
 static
-one_block *
-alist_clone(
-	one_block *xs
+int
+ring_purge(
+	one_ring *self
 ) {
-	int lenu = sizeof(*xs);
-	one_block *resu = tsmalloc(lenu);
-	memset(resu, 0, lenu);
-	memcpy(resu, xs, lenu);
-
-	int lena = xs->u.acc.capacity * sizeof(uintptr_t);
-	memcpy(resu->u.acc.list, xs->u.acc.list, lena);
-	resu->u.acc.list = tsmalloc(lena);
-	memset(resu->u.acc.list, 0, lena);
-	memcpy(resu->u.acc.list, xs->u.acc.list, lena);
-	return resu;
+	int i = self->length;
+	memset(self->slot, 0, self->capacity * sizeof(void *));
+	self->head = 0;
+	self->length = 0;
+	return i;
 }
 
 /*
- * append one array list to the end of another.
+ * an intrusive list (itr) can back a singly, doubly, stack, queue, or
+ * deque. the links are in the client's items, offset bytes in, and
+ * the list only strings them together. items go in and come out as
+ * pointers to the items, the links are found by adding the offset
+ * and the items by taking it off again.
+ *
+ * the links are always double so every end is O(1). a stack pushes
+ * and pops at the first end. a link is cleared when its item comes
+ * off so a stale link can't reach back into the list.
  */
 
-static
-one_block *
-alist_append(one_block *xs, one_block *ys) {
+static inline
+one_link *
+intrusive_link(
+	one_intrusive *self,
+	void *item
+) {
+	return (one_link *)((char *)item + self->offset);
+}
 
-	/* be rational if list to append is empty */
-	if (!ys || ys->u.acc.used < 1)
-		return xs;
+static inline
+void *
+intrusive_item(
+	one_intrusive *self,
+	one_link *link
+) {
+	return link ? (char *)link - self->offset : NULL;
+}
 
-	/* if the 'append to' list is empty, return a copy of the
-	 * append list. this is consistent with the idea that only the
-	 * primary list will be mutated. */
-	if (xs->u.acc.used < 1) {
-		free_one(xs);
-		return alist_clone(ys);
-	}
+static
+void
+intrusive_add_first(
+	one_intrusive *self,
+	void *item
+) {
+	one_link *link = intrusive_link(self, item);
+	link->previous = NULL;
+	link->next = self->first;
+	if (self->first)
+		self->first->previous = link;
+	else
+		self->last = link;
+	self->first = link;
+	self->length += 1;
+}
 
-	/* be lazy and just use the iterator for now. we should always
-	 * pass through the append loop at least once. */
-	one_block *new = alist_clone(xs);
-	free_one(xs);
-	int index = 0;
-	while (true) {
-		if (index < 0) break;
-		uintptr_t got = alist_iterate(ys, &index);
-		new = alist_cons(new, got);
-	}
+static
+void
+intrusive_add_last(
+	one_intrusive *self,
+	void *item
+) {
+	one_link *link = intrusive_link(self, item);
+	link->next = NULL;
+	link->previous = self->last;
+	if (self->last)
+		self->last->next = link;
+	else
+		self->first = link;
+	self->last = link;
+	self->length += 1;
+}
 
-	return new;
+static
+void *
+intrusive_peek_first(
+	one_intrusive *self
+) {
+	return intrusive_item(self, self->first);
 }
 
-/*
- * return the first element in the alist.
- */
-
 static
-uintptr_t
-alist_car(one_block *xs) {
-	if (xs->u.acc.used > 0)
-		return xs->u.acc.list[0];
-	else return 0;
+void *
+intrusive_peek_last(
+	one_intrusive *self
+) {
+	return intrusive_item(self, self->last);
 }
 
-/*
- * return the nth element in the alist.
- */
+static
+void *
+intrusive_get_first(
+	one_intrusive *self
+) {
+	one_link *link = self->first;
+	if (!link)
+		return NULL;
+	self->first = link->next;
+	if (self->first)
+		self->first->previous = NULL;
+	else
+		self->last = NULL;
+	link->next = NULL;
+	self->length -= 1;
+	return intrusive_item(self, link);
+}
 
 static
-uintptr_t
-alist_nth(one_block *xs, int n) {
-	uintptr_t atom = 0;
-	if (n >= xs->u.acc.used || n < 0)
-		fprintf(stderr,
-			"\nERROR txbone-nth: index out of range %d lies outside [0..%d)\n",
-			n, xs->u.acc.used);
+void *
+intrusive_get_last(
+	one_intrusive *self
+) {
+	one_link *link = self->last;
+	if (!link)
+		return NULL;
+	self->last = link->previous;
+	if (self->last)
+		self->last->next = NULL;
 	else
-		atom =  xs->u.acc.list[n];
-	return atom;
+		self->first = NULL;
+	link->previous = NULL;
+	self->length -= 1;
+	return intrusive_item(self, link);
+}
+
+static
+void
+intrusive_splice(
+	one_intrusive *self,
+	one_intrusive *other
+) {
+	if (!other->first)
+		return;
+	if (self->last) {
+		self->last->next = other->first;
+		other->first->previous = self->last;
+	} else
+		self->first = other->first;
+	self->last = other->last;
+	self->length += other->length;
+	other->first = NULL;
+	other->last = NULL;
+	other->length = 0;
 }
 
 /*
- * set the nth element in the alist.
+ * the items belong to the client, so a purge only unhooks them.
  */
 
 static
-one_block *
-alist_setnth(one_block *xs, int n, uintptr_t atom) {
-	if (n >= xs->u.acc.used || n < 0)
-		fprintf(stderr,
-			"\nERROR txbone-setnth: index out of range %d lies outside [0..%d)\n",
-			n, xs->u.acc.used);
-	else
-		xs->u.acc.list[n] = atom;
-	return xs;
+int
+intrusive_purge(
+	one_intrusive *self
+) {
+	int count = self->length;
+	one_link *link = self->first;
+	while (link) {
+		one_link *next = link->next;
+		link->next = NULL;
+		link->previous = NULL;
+		link = next;
+	}
+	self->first = NULL;
+	self->last = NULL;
+	self->length = 0;
+	return count;
 }
-
+
 /*
- * key comparison
+ * the bounded queues (spq, mpq) for passing items between threads.
+ * see one.h for how they work.
+ *
+ * the try functions never wait. the _n functions move up to n items
+ * and publish them with a single store to the tail or head (spsc),
+ * or claim the run of cells with a single swap (mpmc).
  */
 
+static
+bq_ends *
+bq_make_ends(void) {
+	bq_ends *e = tsmalloc(sizeof(*e));
+	memset(e, 0, sizeof(*e));
+	atomic_init(&e->head, 0);
+	atomic_init(&e->tail, 0);
+	return e;
+}
+
+static
+void
+spsc_init(
+	one_spsc *self,
+	size_t capacity
+) {
+	self->slot = tsmalloc(capacity * sizeof(void *));
+	memset(self->slot, 0, capacity * sizeof(void *));
+	self->mask = capacity - 1;
+	self->ends = bq_make_ends();
+}
+
 /*
- * some structures use keys to uniquely identify an item. so far the
- * only externally visible structure is the key:value store, which is
- * internally a binary search tree.
- *
- * as keys and values are most usually passed as `void *` pointers, the
- * client must let us know how to compare the keys. the comparator
- * function has the same basic interface as the standard `strcmp`.
- *
- * the key's type and comparator function are set when a structure is
- * created via `make_one_keyed()`.
- *
- * integral and string compares are set automatically to either
- * `integral_comp` or `strcmp`.
- *
- * argument 'left' tends to be searched for key, and argument 'right'
- * tends to be the key of the node being checked against.
+ * the producer's side. head only moves on from the copy, so room
+ * worked out from the copy is never more than there really is.
  */
 
 static
 int
-integral_comp(void *left, void *right) {
-	return (long)left - (long)right;
+spsc_put_n(
+	one_spsc *self,
+	void **items,
+	int n
+) {
+	bq_ends *e = self->ends;
+	size_t tail = atomic_load_explicit(&e->tail, memory_order_relaxed);
+	size_t room = self->mask + 1 - (tail - e->head_seen);
+	if (room < (size_t)n) {
+		e->head_seen = atomic_load_explicit(&e->head, memory_order_acquire);
+		room = self->mask + 1 - (tail - e->head_seen);
+	}
+	if (room > (size_t)n)
+		room = n;
+	for (size_t i = 0; i < room; i++)
+		self->slot[(tail + i) & self->mask] = items[i];
+	if (room)
+		atomic_store_explicit(&e->tail, tail + room, memory_order_release);
+	return room;
 }
 
 /*
- * the key comparison happens often enough that it was worth factoring
- * out. going with three discreet values instead of 'less than/greather
- * than zero' is a peersonal preference.
+ * and the consumer's.
  */
 
-enum keycmp_result {
-	kcr_unknown = 0,                /* always have an invalid value  */
-	LESS,
-	EQUAL,
-	GREATER
-};
-typedef enum keycmp_result keycmp_result;
+static
+int
+spsc_take_n(
+	one_spsc *self,
+	void **items,
+	int n
+) {
+	bq_ends *e = self->ends;
+	size_t head = atomic_load_explicit(&e->head, memory_order_relaxed);
+	size_t ready = e->tail_seen - head;
+	if (ready < (size_t)n) {
+		e->tail_seen = atomic_load_explicit(&e->tail, memory_order_acquire);
+		ready = e->tail_seen - head;
+	}
+	if (ready > (size_t)n)
+		ready = n;
+	for (size_t i = 0; i < ready; i++)
+		items[i] = self->slot[(head + i) & self->mask];
+	if (ready)
+		atomic_store_explicit(&e->head, head + ready, memory_order_release);
+	return ready;
+}
 
 static
-keycmp_result
-keycmp(one_tree *self, void *left, void *right) {
-	int cmp = self->fn_cmp(left, right);
-	if (cmp < 0) return LESS;
-	else if (cmp > 0) return GREATER;
-	else return EQUAL;
+int
+spsc_purge(
+	one_spsc *self
+) {
+	bq_ends *e = self->ends;
+	size_t head = atomic_load(&e->head);
+	size_t tail = atomic_load(&e->tail);
+	atomic_store(&e->head, tail);
+	e->tail_seen = tail;
+	e->head_seen = tail;
+	return tail - head;
 }
-
-/*
- * free memory for the tree and its Nodes. returns the now invalid
- * pointer to the old tree.
- */
 
-one_tree *
-btree_free(one_tree *self) {
-	int freed = 0;
-	if (self->root) {
-		freed += btree_node_children_free(self, self->root);
-		btree_node_free(self, self->root);
-		freed += 1;
+static
+void
+mpmc_init(
+	one_mpmc *self,
+	size_t capacity
+) {
+	self->cell = tsmalloc(capacity * sizeof(mpmc_cell));
+	for (size_t i = 0; i < capacity; i++) {
+		atomic_init(&self->cell[i].sequence, i);
+		self->cell[i].item = NULL;
 	}
-	memset(self, 253, sizeof(*self));
-	// tsfree(self);
-	FPRINTF_INFO fprintf(stderr, "INFO free_Tree %d nodes freed\n", freed);
-	return self;
+	self->mask = capacity - 1;
+	self->ends = bq_make_ends();
 }
 
 /*
- * get a node or its parent (for insertion).
+ * claim a run of up to n cells starting at the position in end, each
+ * of whose sequence is its position plus lag. lag is 0 to fill and 1
+ * to take. a cell further along can only be claimed by someone moving
+ * end past ours first, so once the swap succeeds the whole run is
+ * ours.
+ *
+ * returns the length of the run and its first position in *pos.
  */
 
-one_node *
-btree_get_Node_or_parent(one_tree *self, void *key) {
-	/* we can only return a NULL if the tree is empty */
-	if (!self->root)
-		return NULL;
-
-	/* walk to find node or parent */
-	one_node *prior = NULL;
-	one_node *curr = self->root;
-	while (curr) {
-		keycmp_result cmp = keycmp(self, key, curr->key);
-		prior = curr;
-		switch (cmp) {
-		case LESS:
-			curr = curr->left;
-			break;
-		case EQUAL:
-			return curr;
-		case GREATER:
-			curr = curr->right;
-			break;
-		default:
-			fprintf(stderr, "ERROR keycmp invalid key comparison result\n");
+static
+size_t
+mpmc_claim(
+	one_mpmc *self,
+	atomic_size_t *end,
+	size_t lag,
+	size_t n,
+	size_t *pos
+) {
+	size_t at = atomic_load_explicit(end, memory_order_relaxed);
+	for (;;) {
+		size_t run = 0;
+		while (run < n) {
+			mpmc_cell *c = &self->cell[(at + run) & self->mask];
+			size_t seq = atomic_load_explicit(&c->sequence, memory_order_acquire);
+			if (seq != at + run + lag)
+				break;
+			run += 1;
+		}
+		if (run == 0) {
+			/* behind means full or empty, ahead means we lost a race */
+			mpmc_cell *c = &self->cell[at & self->mask];
+			size_t seq = atomic_load_explicit(&c->sequence, memory_order_acquire);
+			if ((intptr_t)(seq - (at + lag)) < 0)
+				return 0;
+			at = atomic_load_explicit(end, memory_order_relaxed);
+			continue;
+		}
+		if (atomic_compare_exchange_weak_explicit(end, &at, at + run,
+				memory_order_relaxed, memory_order_relaxed)) {
+			*pos = at;
+			return run;
 		}
 	}
+}
 
-	/* if NULL here then Node with key not found, pass parent back */
-	return curr
-		? curr
-		: prior;
+static
+int
+mpmc_put_n(
+	one_mpmc *self,
+	void **items,
+	int n
+) {
+	size_t pos;
+	size_t run = mpmc_claim(self, &self->ends->tail, 0, n, &pos);
+	for (size_t i = 0; i < run; i++) {
+		mpmc_cell *c = &self->cell[(pos + i) & self->mask];
+		c->item = items[i];
+		atomic_store_explicit(&c->sequence, pos + i + 1, memory_order_release);
+	}
+	return run;
 }
 
-/*
- * get a node or return NULL if the key is not found. this
- * is a wrapper over btree_get_Node_or_parent for the times
- * we aren't wanting to insert.
- */
+static
+int
+mpmc_take_n(
+	one_mpmc *self,
+	void **items,
+	int n
+) {
+	size_t pos;
+	size_t run = mpmc_claim(self, &self->ends->head, 1, n, &pos);
+	for (size_t i = 0; i < run; i++) {
+		mpmc_cell *c = &self->cell[(pos + i) & self->mask];
+		items[i] = c->item;
+		atomic_store_explicit(&c->sequence, pos + i + self->mask + 1,
+			memory_order_release);
+	}
+	return run;
+}
 
-one_node *
-btree_get_Node_or_NULL(one_tree *self, void *key) {
-	one_node *n = btree_get_Node_or_parent(self, key);
-	if (!n) return NULL;
-	if (n->deleted) return NULL;
-	if (keycmp(self, key, n->key) != EQUAL) return NULL;
+static
+int
+mpmc_purge(
+	one_mpmc *self
+) {
+	int n = 0;
+	void *item;
+	while (mpmc_take_n(self, &item, 1))
+		n += 1;
 	return n;
 }
 
 /*
- * height (or depth) of a node in the tree. this is distance
- * from root.
+ * items held, as of a moment ago. the head is read first so that the
+ * tail read after it can't be behind it.
  */
 
+static
 int
-btree_height(one_tree *self, one_node *n) {
-	int height = 0;
-	while (n->parent) {
-		height += 1;
-		n = n->parent;
-	}
-	return height;
+bq_count(
+	one_block *ob
+) {
+	bq_ends *e = ob->isa == spsc ? ob->u.spq.ends : ob->u.mpq.ends;
+	size_t head = atomic_load(&e->head);
+	size_t tail = atomic_load(&e->tail);
+	return tail - head;
 }
 
 /*
- * for analysis functions, what is the height of the node
- * holding a key? returns -1 if the key is not found.
+ * the work stealing deque (wsd). see one.h for the layout. the
+ * orderings follow le et al, "correct and efficient work-stealing
+ * for weak memory models", 2013.
+ *
+ * an owner grows its array on its own thread, and in a pool of
+ * workers several can grow at once. txballoc's trace tables aren't
+ * safe for that, so the arrays come straight from malloc.
  */
 
-int
-btree_height_for_key(one_tree *self, void *key) {
-	if (!key) return -1;
-	one_node *n = btree_get_Node_or_NULL(self, key);
-	if (!n) return -1;
-	return btree_height(self, n);
+static
+ws_array *
+ws_make_array(
+	size_t capacity
+) {
+	ws_array *a = malloc(sizeof(ws_array) + capacity * sizeof(void *));
+	if (!a)
+		return NULL;
+	a->retired = NULL;
+	a->mask = capacity - 1;
+	for (size_t i = 0; i < capacity; i++)
+		atomic_init(&a->slot[i], NULL);
+	return a;
+}
+
+static
+bool
+ws_init(
+	one_wsdeque *self
+) {
+	ws_array *a = ws_make_array(ONE_WSDEQUE_DEFAULT_CAPACITY);
+	if (!a)
+		return false;
+	atomic_init(&self->array, a);
+	atomic_init(&self->top, 0);
+	atomic_init(&self->bottom, 0);
+	return true;
 }
 
 /*
- * the number of items in the tree (or subtree).
+ * copy the live items, top through bottom, to an array twice the
+ * size at the same positions. thieves that already loaded the old
+ * array can still read it, so it is retired and not freed. returns
+ * NULL, leaving the old array in place, if there's no memory.
  */
 
-int
-btree_size(one_tree *self, one_node *n) {
-	if (!n) return 0;
-	return 1 + btree_size(self, n->left) + btree_size(self, n->right);
+static
+ws_array *
+ws_grow(
+	one_wsdeque *self,
+	ws_array *old,
+	long long top,
+	long long bottom
+) {
+	ws_array *a = ws_make_array(2 * (old->mask + 1));
+	if (!a)
+		return NULL;
+	for (long long i = top; i < bottom; i++)
+		atomic_store_explicit(&a->slot[i & a->mask],
+			atomic_load_explicit(&old->slot[i & old->mask], memory_order_relaxed),
+			memory_order_relaxed);
+	a->retired = old;
+	atomic_store_explicit(&self->array, a, memory_order_release);
+	return a;
 }
 
 /*
- * is the tree out of balance? determined by checking the height of
- * the current node against the optimal size (log2(N)).
+ * the owner's end. returns false if the array was full and couldn't
+ * grow.
  */
 
+static
 bool
-btree_is_unbalanced(one_tree *self, one_node *n) {
-	int h = btree_height(self, n);
-	int s = btree_size(self, self->root);
-	return (h > ONE_REBALANCE_ALPHA * u32_log2(s));
+ws_push(
+	one_wsdeque *self,
+	void *item
+) {
+	long long b = atomic_load_explicit(&self->bottom, memory_order_relaxed);
+	long long t = atomic_load_explicit(&self->top, memory_order_acquire);
+	ws_array *a = atomic_load_explicit(&self->array, memory_order_relaxed);
+	if (b - t > (long long)a->mask)
+		a = ws_grow(self, a, t, b);
+	if (!a)
+		return false;
+	atomic_store_explicit(&a->slot[b & a->mask], item, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&self->bottom, b + 1, memory_order_relaxed);
+	return true;
 }
 
 /*
- * if the node high enough to trigger a rebalance (see
- * btree_is_unbalanced), walk back toward root to find a node that
- * holds more than 3/2 of its parent's children.
+ * step bottom back to claim the last item, then look at top. if that
+ * leaves no other item a thief could be after the same one, and the
+ * swap on top decides.
  */
 
-bool
-btree_is_scapegoat(one_tree *self, one_node *n) {
-	return n && (3*btree_size(self, n) > 2*btree_size(self, n->parent));
+static
+void *
+ws_pop(
+	one_wsdeque *self
+) {
+	long long b = atomic_load_explicit(&self->bottom, memory_order_relaxed) - 1;
+	ws_array *a = atomic_load_explicit(&self->array, memory_order_relaxed);
+	atomic_store_explicit(&self->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long t = atomic_load_explicit(&self->top, memory_order_relaxed);
+	if (t > b) {
+		atomic_store_explicit(&self->bottom, b + 1, memory_order_relaxed);
+		return NULL;
+	}
+	void *item = atomic_load_explicit(&a->slot[b & a->mask], memory_order_relaxed);
+	if (t == b) {
+		if (!atomic_compare_exchange_strong_explicit(&self->top, &t, t + 1,
+				memory_order_seq_cst, memory_order_relaxed))
+			item = NULL;
+		atomic_store_explicit(&self->bottom, b + 1, memory_order_relaxed);
+	}
+	return item;
 }
-
+
 /*
- * tree traversal.
- *
- * the standard tree traversal functions. these require a client
- * provided callback function. that function's api is documented in
- * the this library's header.
- *
- * these are currently marked static, and three other functions
- * provide the external api.
- *
- * each traversal has a 'cap' function and the actual traversal
- * recursion function (name suffixed _r).
+ * and the thieves'. the item is read before the swap on top, and is
+ * only ours if the swap succeeds.
  */
 
 static
-int
-btree_pre_order_traversal_r(one_tree *self, one_node *n,
-	void *context, fn_traversal_cb fn) {
-	if (!n) return 0;
-	if (!n->deleted) fn(n->key, n->value, context, self);
-	btree_pre_order_traversal_r(self, n->left, context, fn);
-	btree_pre_order_traversal_r(self, n->right, context, fn);
-	return 1;
-}
-
-static
-int
-btree_in_order_traversal_r(one_tree *self, one_node *n,
-	void *context, fn_traversal_cb fn) {
-	if (!n) return 0;
-	btree_in_order_traversal_r(self, n->left, context, fn);
-	if (!n->deleted) fn(n->key, n->value, context, self);
-	btree_in_order_traversal_r(self, n->right, context, fn);
-	return 1;
-}
-
-static
-int
-btree_post_order_traversal_r(one_tree *self, one_node *n,
-	void *context, fn_traversal_cb fn) {
-	if (!n) return 0;
-	btree_post_order_traversal_r(self, n->left, context, fn);
-	btree_post_order_traversal_r(self, n->right, context, fn);
-	if (!n->deleted) fn(n->key, n->value, context, self);
-	return 1;
+void *
+ws_steal(
+	one_wsdeque *self
+) {
+	for (;;) {
+		long long t = atomic_load_explicit(&self->top, memory_order_acquire);
+		atomic_thread_fence(memory_order_seq_cst);
+		long long b = atomic_load_explicit(&self->bottom, memory_order_acquire);
+		if (t >= b)
+			return NULL;
+		ws_array *a = atomic_load_explicit(&self->array, memory_order_acquire);
+		void *item = atomic_load_explicit(&a->slot[t & a->mask], memory_order_relaxed);
+		if (atomic_compare_exchange_strong_explicit(&self->top, &t, t + 1,
+				memory_order_seq_cst, memory_order_relaxed))
+			return item;
+	}
 }
 
 static
 int
-pre_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
-	return btree_pre_order_traversal_r(self, self->root, context, fn);
+ws_count(
+	one_wsdeque *self
+) {
+	long long t = atomic_load(&self->top);
+	long long b = atomic_load(&self->bottom);
+	return b > t ? b - t : 0;
 }
 
 static
 int
-in_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
-	return btree_in_order_traversal_r(self, self->root, context, fn);
+ws_purge(
+	one_wsdeque *self
+) {
+	int n = ws_count(self);
+	atomic_store(&self->top, atomic_load(&self->bottom));
+	return n;
 }
 
 static
-int
-post_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
-	return btree_post_order_traversal_r(self, self->root, context, fn);
+void
+ws_free(
+	one_wsdeque *self
+) {
+	ws_array *a = atomic_load(&self->array);
+	while (a) {
+		ws_array *retired = a->retired;
+		memset(a, 253, sizeof(ws_array) + (a->mask + 1) * sizeof(void *));
+		free(a);
+		a = retired;
+	}
 }
-
-/*
- * keys and values are packed into nodes, and the tree is composed of
- * nodes.
- */
 
 /*
- * create a new unlinked Node
+ * the accumulator list (alist) is a cross between a java array list and a
+ * lisp or sml list. while it has some similarities to the dynamic array
+ * i kept the implementations separate to avoid special subtype specific
+ * conditionals from cruding up the code.
+ *
+ * the motivation for the alist as that it provide the functionality of
+ * lists in recursions.
+ *
+ * as the list is stored separately from it's controlling self block,
+ * the external api passes the whole one_block.
+ *
+ * some operations (slice) create copies of a portion of the alist. in
+ * a java array list, this would just be a view over the array list.
+ *
+ * the api convention is the returned list is meant to replace the
+ * primary list in arguments. if the list has been significantly
+ * mutated, the original primary list is freed and an updated
+ * copy is returned.
+ *
+ * always use the array list you get back from an api call, not the
+ * one you sent in.
+ *
+ * repeat: ALWAYS USE THE ARRAY LIST YOU GET BACK FROM AN API CALL,
+ * NOT THE ONE YOU SENT IN.
+ *
+ * for illustration, here is an example where consing repeatedly
+ * will force the alist to grow, creating a new list and destroying
+ * the old list. the default allocation is ALIST_DEFAULT_CAPACITY.
+ *
+ * one_block *xs = make_one(alist);
+ * one_block *remember = xs;
+ * for (int i = 0; i > ALIST_DEFAULT_CAP * 2; i++)
+ *         xs = cons_to_alist(xs, (uintptr_t)i);
+ * assert(remember != xs);
+ * xs = free_one(xs);
+ * assert(xs == NULL);
+ *
+ * 'remember' holds the original address of 'xs', but that storage was
+ * released when 'xs' was expanded.
+ *
+ * some of the api is inspired by the java arraylist, and the rest
+ * from lisp. it's pseudo lisp lists with fake garbage collection.
  */
 
-one_node *
-btree_make_Node(one_tree *self, void *key, void *value) {
-	one_node *n = tsmalloc(sizeof(*n));
-	memset(n, 0, sizeof(*n));
-	n->key = key;
-	n->value = value;
-	return n;
+static
+int
+alist_purge(one_block *xs) {
+	int ret = xs->u.acc.used;
+	xs->u.acc.used = 0;
+	memset(xs->u.acc.list, 0, ret * sizeof(uintptr_t));
+	return ret;
 }
 
 /*
- * free an individual Node, warning if it has children and clearing
- * the parent's link to it if there is one.
+ * add something that fits in a unintprt_t (currently 8 bytes) to the
+ * end of the array list.
+ *
+ * growing returns NULL if the list can't be made big enough. the
+ * list passed in is left as it was and still belongs to the caller.
  */
 
-void
-btree_node_free(one_tree *self, one_node *n) {
-	/* warn on linked children but allow it through for now */
-	if (n->left || n->right) {
-		fprintf(stderr, "WARNING free_Node: freed a Node with linked children\n");
+static
+one_block *
+alist_grow(one_block *xs, int need) {
+	if (need > (1 << 30)) {
+		fprintf(stderr,
+			"\nERROR txbone-cons: capacity %d is too large\n", need);
+		return NULL;
 	}
-	/* unlink from parent */
-	if (n->parent) {
-		if (n->parent->left == n) n->parent->left = NULL;
-		if (n->parent->right == n) n->parent->right = NULL;
+	int cap = xs->u.acc.capacity;
+	while (cap < need)
+		cap *= 2;
+
+	/* a stable list keeps its one_block and only moves the list */
+	if (xs->u.acc.stable) {
+		uintptr_t *acc = tsrealloc(xs->u.acc.list, cap * sizeof(uintptr_t));
+		if (!acc) {
+			fprintf(stderr,
+				"\nERROR txbone-cons: could not grow to capacity %d\n", cap);
+			return NULL;
+		}
+		memset(acc + xs->u.acc.capacity, 0,
+			(cap - xs->u.acc.capacity) * sizeof(uintptr_t));
+		xs->u.acc.list = acc;
+		xs->u.acc.capacity = cap;
+		return xs;
 	}
-	/* scrub and free */
-	memset(n, 253, sizeof(*n));
-	tsfree(n);
-}
 
-/*
- * free child Nodes.
- */
+	int lena = xs->u.acc.capacity * sizeof(uintptr_t);
+	one_block *new = tsmalloc(sizeof(*xs));
+	uintptr_t *acc = tsmalloc(cap * sizeof(uintptr_t));
+	if (!new || !acc) {
+		if (new)
+			tsfree(new);
+		if (acc)
+			tsfree(acc);
+		fprintf(stderr,
+			"\nERROR txbone-cons: could not grow to capacity %d\n", cap);
+		return NULL;
+	}
+	memcpy(new, xs, sizeof(*xs));
+	memset(acc, 0, cap * sizeof(uintptr_t));
+	memcpy(acc, xs->u.acc.list, lena);
+	new->u.acc.capacity = cap;
+	new->u.acc.list = acc;
+	free_one(xs);
+	return new;
+}
 
-int
-btree_node_children_free(one_tree *self, one_node *n) {
-	if (!n) return 0;
-	int freed = 0;
-	if (n->left) {
-		freed += btree_node_children_free(self, n->left);
-		n->left->left = NULL;
-		n->left->right =NULL;
-		freed += 1;
-		btree_node_free(self, n->left);
-	}
-	if (n->right) {
-		freed += btree_node_children_free(self, n->right);
-		n->right->left = NULL;
-		n->right->right =NULL;
-		freed += 1;
-		btree_node_free(self, n->right);
-	}
-	return freed + 1;
+static
+one_block *
+alist_cons(one_block *xs, uintptr_t p) {
+	if (xs->u.acc.used == xs->u.acc.capacity)
+		xs = alist_grow(xs, xs->u.acc.used + 1);
+	if (!xs)
+		return NULL;
+	xs->u.acc.list[xs->u.acc.used] = p;
+	xs->u.acc.used += 1;
+	return xs;
 }
-
 
 /*
- * recursively snip off all the branches of a (sub)tree for the
- * rebuild.
+ * add n items to the end of the array list with one capacity check
+ * and one copy. the items may come from the list itself, so if the
+ * list moves they are found again.
  */
 
-void
-btree_reset_subtree_r(one_tree *self, one_node *subtree) {
-	if (!subtree)
-		return;
-
-	if (subtree->left) {
-		btree_reset_subtree_r(self, subtree->left);
-		subtree->left = NULL;
-	}
-	if (subtree->right) {
-		btree_reset_subtree_r(self, subtree->right);
-		subtree->right = NULL;
-	}
-	if (subtree->parent) {
-		if (subtree->parent->left && subtree->parent->left == subtree)
-			subtree->parent->left = NULL;
-		if (subtree->parent->right && subtree->parent->right == subtree)
-			subtree->parent->right = NULL;
-		subtree->parent = NULL;
+static
+one_block *
+alist_cons_n(one_block *xs, const uintptr_t *p, int n) {
+	if (n < 1)
+		return xs;
+	if (xs->u.acc.used + n > xs->u.acc.capacity) {
+		bool own = p >= xs->u.acc.list && p < xs->u.acc.list + xs->u.acc.used;
+		ptrdiff_t at = own ? p - xs->u.acc.list : 0;
+		xs = alist_grow(xs, xs->u.acc.used + n);
+		if (!xs)
+			return NULL;
+		if (own)
+			p = xs->u.acc.list + at;
 	}
-
-	btree_node_free(self, subtree);
+	memcpy(xs->u.acc.list + xs->u.acc.used, p, n * sizeof(uintptr_t));
+	xs->u.acc.used += n;
+	return xs;
 }
 
 /*
- * recursively go through key ordered list of nodes to rebuild the
- * tree (or subtree) in balance.
+ * create a new alist of the contents from inclusive->to exclusive.
+ *
+ * ie, [from, to) in standard mathematic notation.
  *
- * given an ordered list of nodes, create a subtree from the center
- * node's key & value, building out the left and right child branches
- * by halving the list repeatedly. this halving via sub_alist creates
- * a new alist with duplicate node pointers. we delete these new lists
- * as soon as we are finished with them.
+ * this does not have the same semantics as the java arraylist
+ * sublist. here we create an entirely new list holding only the
+ * elements requested. i've gone with 'slice' as more intention
+ * revealing.
  *
- * it would be possible to delete the old node after the new node is
- * built here instead of doing a sweep over the whole list again
- * later in balancing, but for now we'll leave them alone.
+ * the original list is preserved.
  */
 
-one_node *
-btree_make_subtree_r(one_tree *self, one_block *nodes) {
-	int k = count(nodes);
-	if (k == 0)
+static
+one_block *
+alist_slice(one_block *xs, int from_inclusive, int to_exclusive) {
+	if (to_exclusive > xs->u.acc.used || from_inclusive < 0) {
+		fprintf(stderr,
+			"\nERROR txbone-slice: range out of bounds holds [0..%d) requested [%d..%d)\n",
+			xs->u.acc.used, from_inclusive, to_exclusive);
 		return NULL;
+	}
+	one_block *res = make_one(alist);
+	res->u.acc.stable = xs->u.acc.stable;
+	/* to be explicit about this. */
+	if (from_inclusive >= to_exclusive)
+		return res;
 
-	/* next subtree root */
-	int j = k/2;
-	one_node *old = (one_node *)nth(nodes, j);
-	one_node *new = btree_make_Node(self, old->key, old->value);
-
-	/* and to either side of the root, we have further subtrees */
-	one_block *left_side = slice(nodes, 0, j);
-	one_block *right_side = slice(nodes, j+1, k);
-
-	/* so do the left children */
-	new->left = btree_make_subtree_r(self, left_side);
-	free_one(left_side);
-	if (new->left)
-		new->left->parent = new;
-
-	/* and the right children */
-	new->right = btree_make_subtree_r(self, right_side);
-	free_one(right_side);
-	if (new->right)
-		new->right->parent = new;
-
-	/* and return our subtree root */
-	return new;
+	one_block *filled = alist_cons_n(res, xs->u.acc.list + from_inclusive,
+			to_exclusive - from_inclusive);
+	if (!filled)
+		free_one(res);
+	return filled;
 }
 
 /*
- * an in order traversal recursively collect all the non-deleted
- * nodes for rebalancing.
+ * an iterator of sorts over the alist. call it repeatedly and *index
+ * *index is updated. reaching the end of the array list is signalled
+ * by *index == -1.
  */
 
+static
+uintptr_t
+alist_iterate(one_block *xs, int *curr) {
+	if (*curr < 0)
+		return 0;
+	if (!xs || xs->u.acc.used < 1)
+		return 0;
+	if (*curr >= xs->u.acc.used) {
+		*curr = -1;  /* as a null might be valid, use a negative count to also signal end */
+		return 0;
+	}
+	uintptr_t res = xs->u.acc.list[*curr];
+	*curr += 1;
+	return res;
+}
+
+static
 one_block *
-btree_node_collector(one_tree *self, one_node *n, one_block *xs) {
-	if (!n)
-		return xs;
-	xs = btree_node_collector(self, n->left, xs);
-	if (!n->deleted)
-		xs = cons(xs, (uintptr_t)n);
-	xs = btree_node_collector(self, n->right, xs);
-	return xs;
+alist_cdr(one_block *xs) {
+	return alist_slice(xs, 1, xs->u.acc.used);;
 }
 
 /*
- * an in order traversal recursively collect the keys of all the
- * non-deleted nodes for rebalancing.
+ * creates a shallow copy of an array list.
  */
 
+static
 one_block *
-btree_key_collector(one_tree *self, one_node *n, one_block *xs) {
-	if (!n)
-		return xs;
-	xs = btree_key_collector(self, n->left, xs);
-	if (!n->deleted)
-		xs = cons(xs, (uintptr_t)n->key);
-	xs = btree_key_collector(self, n->right, xs);
-	return xs;
+alist_clone(
+	one_block *xs
+) {
+	int lenu = sizeof(*xs);
+	one_block *resu = tsmalloc(lenu);
+	memset(resu, 0, lenu);
+	memcpy(resu, xs, lenu);
+
+	int lena = xs->u.acc.capacity * sizeof(uintptr_t);
+	memcpy(resu->u.acc.list, xs->u.acc.list, lena);
+	resu->u.acc.list = tsmalloc(lena);
+	memset(resu->u.acc.list, 0, lena);
+	memcpy(resu->u.acc.list, xs->u.acc.list, lena);
+	return resu;
 }
 
 /*
- * an in order traversal recursively collect the values of all the
- * non-deleted nodes for rebalancing.
+ * append one array list to the end of another.
  */
 
+static
 one_block *
-btree_value_collector(one_tree *self, one_node *n, one_block *xs) {
-	if (!n)
+alist_append(one_block *xs, one_block *ys) {
+
+	/* be rational if list to append is empty */
+	if (!ys || ys->u.acc.used < 1)
 		return xs;
-	xs = btree_value_collector(self, n->left, xs);
-	if (!n->deleted)
-		xs = cons(xs, (uintptr_t)n->value);
-	xs = btree_value_collector(self, n->right, xs);
-	return xs;
+
+	/* if the 'append to' list is empty, return a copy of the
+	 * append list. this is consistent with the idea that only the
+	 * primary list will be mutated. a stable list keeps its handle
+	 * and is just filled. */
+	if (xs->u.acc.used < 1 && !xs->u.acc.stable) {
+		free_one(xs);
+		return alist_clone(ys);
+	}
+
+	return alist_cons_n(xs, ys->u.acc.list, ys->u.acc.used);
 }
 
 /*
- * once we know where we need to rebalance from, use the old (sub)tree
- * to build a balanced (sub)tree and and replace the old (sub)tree.
- *
- * to rebalance the whole Tree, pass self->root as the subtree.
+ * return the first element in the alist.
+ */
+
+static
+uintptr_t
+alist_car(one_block *xs) {
+	if (xs->u.acc.used > 0)
+		return xs->u.acc.list[0];
+	else return 0;
+}
+
+/*
+ * return the nth element in the alist.
+ */
+
+static
+uintptr_t
+alist_nth(one_block *xs, int n) {
+	uintptr_t atom = 0;
+	if (n >= xs->u.acc.used || n < 0)
+		fprintf(stderr,
+			"\nERROR txbone-nth: index out of range %d lies outside [0..%d)\n",
+			n, xs->u.acc.used);
+	else
+		atom =  xs->u.acc.list[n];
+	return atom;
+}
+
+/*
+ * set the nth element in the alist.
+ */
+
+static
+one_block *
+alist_setnth(one_block *xs, int n, uintptr_t atom) {
+	if (n >= xs->u.acc.used || n < 0)
+		fprintf(stderr,
+			"\nERROR txbone-setnth: index out of range %d lies outside [0..%d)\n",
+			n, xs->u.acc.used);
+	else
+		xs->u.acc.list[n] = atom;
+	return xs;
+}
+
+/*
+ * key comparison
+ */
+
+/*
+ * some structures use keys to uniquely identify an item. so far the
+ * only externally visible structure is the key:value store, which is
+ * internally a binary search tree.
+ *
+ * as keys and values are most usually passed as `void *` pointers, the
+ * client must let us know how to compare the keys. the comparator
+ * function has the same basic interface as the standard `strcmp`.
+ *
+ * the key's type and comparator function are set when a structure is
+ * created via `make_one_keyed()`.
+ *
+ * integral and string compares are set automatically to either
+ * `integral_comp` or `strcmp`.
+ *
+ * argument 'left' tends to be searched for key, and argument 'right'
+ * tends to be the key of the node being checked against.
+ */
+
+static
+int
+integral_comp(void *left, void *right) {
+	return ((long)left > (long)right) - ((long)left < (long)right);
+}
+
+/*
+ * the key comparison happens often enough that it was worth factoring
+ * out. going with three discreet values instead of 'less than/greather
+ * than zero' is a peersonal preference.
+ */
+
+enum keycmp_result {
+	kcr_unknown = 0,                /* always have an invalid value  */
+	LESS,
+	EQUAL,
+	GREATER
+};
+typedef enum keycmp_result keycmp_result;
+
+/*
+ * integral keys are compared in line, every step of a search would
+ * otherwise be an indirect call to integral_comp.
+ */
+
+static
+keycmp_result
+keycmp(one_tree *self, void *left, void *right) {
+	if (self->kt == integral) {
+		if ((long)left < (long)right) return LESS;
+		else if ((long)left > (long)right) return GREATER;
+		else return EQUAL;
+	}
+	int cmp = self->fn_cmp(left, right);
+	if (cmp < 0) return LESS;
+	else if (cmp > 0) return GREATER;
+	else return EQUAL;
+}
+
+/*
+ * each node of a tree with string keys holds the first eight bytes
+ * of its key packed big end first, zero filled past the end of the
+ * string. comparing two prefixes as unsigned integers orders them as
+ * strcmp would, so only keys that share their first eight bytes need
+ * strcmp and a trip out to the key.
+ */
+
+static
+uint64_t
+key_prefix(one_tree *self, void *key) {
+	if (self->kt != string)
+		return 0;
+	const unsigned char *s = key;
+	uint64_t p = 0;
+	for (int i = 0; i < 8; i++) {
+		p = p << 8 | *s;
+		if (*s)
+			s++;
+	}
+	return p;
+}
+
+/*
+ * compare a search key and its prefix against a node's key.
+ */
+
+static
+keycmp_result
+keycmp_node(one_tree *self, void *key, uint64_t prefix, one_node *n) {
+	if (prefix != n->prefix)
+		return prefix < n->prefix ? LESS : GREATER;
+	return keycmp(self, key, n->key);
+}
+
+/*
+ * free memory for the tree and its Nodes. returns the now invalid
+ * pointer to the old tree. the nodes all live in the tree's pool,
+ * so there's no need to walk the tree.
+ */
+
+one_tree *
+btree_free(one_tree *self) {
+	int freed = self->nodes + self->marked_deleted;
+	pool_release(&self->pool, sizeof(one_node));
+	memset(self, 253, sizeof(*self));
+	// tsfree(self);
+	FPRINTF_INFO fprintf(stderr, "INFO free_Tree %d nodes freed\n", freed);
+	return self;
+}
+
+/*
+ * get a node or its parent (for insertion).
  */
 
 one_node *
-btree_rebalance_r(one_tree *self, one_node *subtree) {
+btree_get_Node_or_parent(one_tree *self, void *key) {
+	/* we can only return a NULL if the tree is empty */
+	if (!self->root)
+		return NULL;
 
-	FPRINTF_INFO fprintf(stderr, "INFO rebalance begin rebalancing\n");
+	/* walk to find node or parent */
+	uint64_t prefix = key_prefix(self, key);
+	one_node *prior = NULL;
+	one_node *curr = self->root;
+	while (curr) {
+		keycmp_result cmp = keycmp_node(self, key, prefix, curr);
+		prior = curr;
+		switch (cmp) {
+		case LESS:
+			curr = curr->left;
+			break;
+		case EQUAL:
+			return curr;
+		case GREATER:
+			curr = curr->right;
+			break;
+		default:
+			fprintf(stderr, "ERROR keycmp invalid key comparison result\n");
+		}
+	}
 
-	/* remember where to hang the subtree. if parent is NULL,
-	 * this is root. if it isn't remember if the subtree was
-	 * on the left or right. */
+	/* if NULL here then Node with key not found, pass parent back */
+	return curr
+		? curr
+		: prior;
+}
+
+/*
+ * get a node or return NULL if the key is not found. this
+ * is a wrapper over btree_get_Node_or_parent for the times
+ * we aren't wanting to insert.
+ */
+
+one_node *
+btree_get_Node_or_NULL(one_tree *self, void *key) {
+	one_node *n = btree_get_Node_or_parent(self, key);
+	if (!n) return NULL;
+	if (n->deleted) return NULL;
+	if (keycmp_node(self, key, key_prefix(self, key), n) != EQUAL) return NULL;
+	return n;
+}
+
+/*
+ * height (or depth) of a node in the tree. this is distance
+ * from root.
+ */
+
+int
+btree_height(one_tree *self, one_node *n) {
+	int height = 0;
+	while (n->parent) {
+		height += 1;
+		n = n->parent;
+	}
+	return height;
+}
+
+/*
+ * for analysis functions, what is the height of the node
+ * holding a key? returns -1 if the key is not found.
+ */
+
+int
+btree_height_for_key(one_tree *self, void *key) {
+	if (!key) return -1;
+	one_node *n = btree_get_Node_or_NULL(self, key);
+	if (!n) return -1;
+	return btree_height(self, n);
+}
+
+/*
+ * the number of items in the tree (or subtree). each node keeps the
+ * count for its subtree, deleted nodes included, and the count of
+ * live nodes.
+ */
+
+int
+btree_size(one_tree *self, one_node *n) {
+	return n ? n->size : 0;
+}
+
+static
+int
+btree_live_size(one_node *n) {
+	return n ? n->live : 0;
+}
+
+/*
+ * adjust the counts of a node and everything above it.
+ */
+
+static
+void
+btree_adjust_sizes(one_node *n, int size, int live) {
+	while (n) {
+		n->size += size;
+		n->live += live;
+		n = n->parent;
+	}
+}
+
+/*
+ * is the tree out of balance? determined by checking the height of
+ * the current node against the optimal size (log2(N)).
+ */
+
+bool
+btree_is_unbalanced(one_tree *self, one_node *n) {
+	int h = btree_height(self, n);
+	int s = btree_size(self, self->root);
+	return (h > self->policy.alpha * u32_log2(s));
+}
+
+/*
+ * if the node high enough to trigger a rebalance (see
+ * btree_is_unbalanced), walk back toward root to find a node that
+ * holds more than 2/3 of its parent's subtree. the parent is the
+ * scapegoat, and rebuilding it shortens the path. rebuilding the
+ * heavy child instead left the path as long as before, so sorted
+ * inserts rebuilt ever larger subtrees on every insert.
+ */
+
+bool
+btree_is_scapegoat(one_tree *self, one_node *n) {
+	return n && (3*btree_size(self, n) > 2*btree_size(self, n->parent));
+}
+
+/*
+ * in order stepping over the tree using the parent pointers, no
+ * stack or recursion needed. deleted nodes are still in the tree
+ * and still order their children, btree_live steps past them.
+ */
+
+static
+one_node *
+btree_leftmost(one_node *n) {
+	while (n && n->left)
+		n = n->left;
+	return n;
+}
+
+static
+one_node *
+btree_successor(one_node *n) {
+	if (n->right)
+		return btree_leftmost(n->right);
+	while (n->parent && n->parent->right == n)
+		n = n->parent;
+	return n->parent;
+}
+
+static
+one_node *
+btree_live(one_node *n) {
+	while (n && n->deleted)
+		n = btree_successor(n);
+	return n;
+}
+
+/*
+ * and the same stepping backward.
+ */
+
+static
+one_node *
+btree_rightmost(one_node *n) {
+	while (n && n->right)
+		n = n->right;
+	return n;
+}
+
+static
+one_node *
+btree_predecessor(one_node *n) {
+	if (n->left)
+		return btree_rightmost(n->left);
+	while (n->parent && n->parent->left == n)
+		n = n->parent;
+	return n->parent;
+}
+
+static
+one_node *
+btree_live_back(one_node *n) {
+	while (n && n->deleted)
+		n = btree_predecessor(n);
+	return n;
+}
+
+/*
+ * tree traversal.
+ *
+ * the standard tree traversal functions. these require a client
+ * provided callback function. that function's api is documented in
+ * the this library's header.
+ *
+ * these are currently marked static, and three other functions
+ * provide the external api.
+ *
+ * each traversal has a 'cap' function and the actual traversal
+ * recursion function (name suffixed _r).
+ */
+
+static
+int
+btree_pre_order_traversal_r(one_tree *self, one_node *n,
+	void *context, fn_traversal_cb fn) {
+	if (!n) return 0;
+	if (!n->deleted) fn(n->key, n->value, context, self);
+	btree_pre_order_traversal_r(self, n->left, context, fn);
+	btree_pre_order_traversal_r(self, n->right, context, fn);
+	return 1;
+}
+
+static
+int
+btree_in_order_traversal_r(one_tree *self, one_node *n,
+	void *context, fn_traversal_cb fn) {
+	if (!n) return 0;
+	btree_in_order_traversal_r(self, n->left, context, fn);
+	if (!n->deleted) fn(n->key, n->value, context, self);
+	btree_in_order_traversal_r(self, n->right, context, fn);
+	return 1;
+}
+
+static
+int
+btree_post_order_traversal_r(one_tree *self, one_node *n,
+	void *context, fn_traversal_cb fn) {
+	if (!n) return 0;
+	btree_post_order_traversal_r(self, n->left, context, fn);
+	btree_post_order_traversal_r(self, n->right, context, fn);
+	if (!n->deleted) fn(n->key, n->value, context, self);
+	return 1;
+}
+
+static
+int
+pre_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
+	return btree_pre_order_traversal_r(self, self->root, context, fn);
+}
+
+static
+int
+in_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
+	return btree_in_order_traversal_r(self, self->root, context, fn);
+}
+
+static
+int
+post_order_traversal(one_tree *self, void *context, fn_traversal_cb fn) {
+	return btree_post_order_traversal_r(self, self->root, context, fn);
+}
+
+/*
+ * keys and values are packed into nodes, and the tree is composed of
+ * nodes.
+ */
+
+/*
+ * create a new unlinked Node
+ */
+
+one_node *
+btree_make_Node(one_tree *self, void *key, void *value) {
+	one_node *n = pool_take(&self->pool, sizeof(*n));
+	n->key = key;
+	n->prefix = key_prefix(self, key);
+	n->value = value;
+	n->size = 1;
+	n->live = 1;
+	return n;
+}
+
+/*
+ * free an individual Node, warning if it has children and clearing
+ * the parent's link to it if there is one.
+ */
+
+void
+btree_node_free(one_tree *self, one_node *n) {
+	/* warn on linked children but allow it through for now */
+	if (n->left || n->right) {
+		fprintf(stderr, "WARNING free_Node: freed a Node with linked children\n");
+	}
+	/* unlink from parent */
+	if (n->parent) {
+		if (n->parent->left == n) n->parent->left = NULL;
+		if (n->parent->right == n) n->parent->right = NULL;
+	}
+	/* scrub and free */
+	pool_give(&self->pool, n, sizeof(*n));
+}
+
+
+
+/*
+ * an in order traversal recursively collect the keys of all the
+ * non-deleted nodes for rebalancing.
+ */
+
+one_block *
+btree_key_collector(one_tree *self, one_node *n, one_block *xs) {
+	if (!n)
+		return xs;
+	xs = btree_key_collector(self, n->left, xs);
+	if (!n->deleted)
+		xs = cons(xs, (uintptr_t)n->key);
+	xs = btree_key_collector(self, n->right, xs);
+	return xs;
+}
+
+/*
+ * an in order traversal recursively collect the values of all the
+ * non-deleted nodes for rebalancing.
+ */
+
+one_block *
+btree_value_collector(one_tree *self, one_node *n, one_block *xs) {
+	if (!n)
+		return xs;
+	xs = btree_value_collector(self, n->left, xs);
+	if (!n->deleted)
+		xs = cons(xs, (uintptr_t)n->value);
+	xs = btree_value_collector(self, n->right, xs);
+	return xs;
+}
+
+/*
+ * the subtree is rebuilt in place, day-stout-warren style. it is
+ * first flattened into a vine, an ordered list linked through the
+ * right pointers. deleted nodes are cut out as the vine forms. the
+ * vine is then folded back into a tree with runs of left rotations.
+ * no memory is allocated and each step is O(n).
+ *
+ * the vine hangs off the right of a pseudo root node, which stands in
+ * for whatever held the subtree.
+ */
+
+static
+int
+btree_tree_to_vine(one_tree *self, one_node *pseudo) {
+	int n = 0;
+	one_node *tail = pseudo;
+	one_node *rest = tail->right;
+	while (rest) {
+		if (rest->left) {
+			/* rotate right until there's no left child */
+			one_node *l = rest->left;
+			rest->left = l->right;
+			l->right = rest;
+			rest = l;
+			tail->right = l;
+		} else if (rest->deleted) {
+			one_node *gone = rest;
+			rest = rest->right;
+			tail->right = rest;
+			if (self->sweep == gone)
+				self->sweep = NULL;
+			pool_give(&self->pool, gone, sizeof(*gone));
+		} else {
+			n += 1;
+			tail = rest;
+			rest = rest->right;
+		}
+	}
+	return n;
+}
+
+/*
+ * left rotate every other node of the first count on the vine.
+ */
+
+static
+void
+btree_compress(one_node *pseudo, int count) {
+	one_node *scanner = pseudo;
+	for (int i = 0; i < count; i++) {
+		one_node *child = scanner->right;
+		scanner->right = child->right;
+		scanner = scanner->right;
+		child->right = scanner->left;
+		scanner->left = child;
+	}
+}
+
+/*
+ * fold a vine of n nodes into a balanced tree. the nodes beyond the
+ * largest complete tree become the bottom level.
+ */
+
+static
+void
+btree_vine_to_tree(one_node *pseudo, int n) {
+	int leaves = n + 1 - (1 << u32_log2(n + 1));
+	btree_compress(pseudo, leaves);
+	n -= leaves;
+	while (n > 1) {
+		n /= 2;
+		btree_compress(pseudo, n);
+	}
+}
+
+/*
+ * the rotations leave the parent pointers and counts stale. the new
+ * tree is balanced so this recursion is only log n deep.
+ */
+
+static
+int
+btree_relink_r(one_node *n, one_node *parent) {
+	if (!n)
+		return 0;
+	n->parent = parent;
+	n->size = 1 + btree_relink_r(n->left, n) + btree_relink_r(n->right, n);
+	n->live = n->size;
+	return n->size;
+}
+
+/*
+ * seconds from some fixed point, for timing rebalances.
+ */
+
+static
+double
+btree_clock(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * once we know where we need to rebalance from, rebuild the
+ * (sub)tree in balance and hang it back where it was.
+ *
+ * to rebalance the whole Tree, pass self->root as the subtree. a
+ * rebuild from the root counts as a full rebalance, anything else
+ * as partial.
+ */
+
+one_node *
+btree_rebalance_r(one_tree *self, one_node *subtree) {
+
+	FPRINTF_INFO fprintf(stderr, "INFO rebalance begin rebalancing\n");
+	double start = btree_clock();
+
+	/* remember where to hang the subtree. if parent is NULL,
+	 * this is root. if it isn't remember if the subtree was
+	 * on the left or right. */
+
+	one_node *parent = subtree->parent;
+	bool left_side = (parent && parent->left == subtree);
+	int old_size = subtree->size;
+
+	one_node pseudo;
+	memset(&pseudo, 0, sizeof(pseudo));
+	pseudo.right = subtree;
+	int n = btree_tree_to_vine(self, &pseudo);
+	FPRINTF_INFO fprintf(stderr, "INFO rebalance nodes in subtree %d\n", n);
+	btree_vine_to_tree(&pseudo, n);
+	one_node *new_subtree = pseudo.right;
+	btree_relink_r(new_subtree, parent);
+
+	if (!parent) {
+		self->root = new_subtree;
+	} else {
+		if (left_side) parent->left = new_subtree;
+		else           parent->right = new_subtree;
+	}
+
+	/* the deleted nodes are gone, the counts above shrink by them */
+	int dropped = old_size - n;
+	btree_adjust_sizes(parent, -dropped, 0);
+	self->marked_deleted -= dropped;
+
+	double elapsed = btree_clock() - start;
+	if (!parent) {
+		self->full_rebalances += 1;
+		self->full_rebalance_time += elapsed;
+	} else {
+		self->partial_rebalances += 1;
+		self->partial_rebalance_time += elapsed;
+	}
+
+	FPRINTF_INFO fprintf(stderr, "INFO rebalance end rebalancing\n");
+	return new_subtree;
+}
+
+/*
+ * the key:value store is built on a self balancing binary search
+ * tree.
+ *
+ * i originally tried to use sedgewick's left-leaning red-black tree
+ * but even after converting his java to c i can't get a working
+ * solution. the best i got is that the my c of his java loses 23 keys
+ * out of my 10k dataset. i have no idea why. after a couple of weeks
+ * of tracing and banging my head, i gave up.
+ *
+ * next i looked at a plain red-black tree but the implementations are
+ * fugly. it works but i don't really get procedure. at least with
+ * sedgewick i understood what was going on.
+ *
+ * i had heard about scapegoat trees a while back and after reviewing
+ * some documentation on them i know i can put an implementation
+ * together that will work and be comprehensible.
+ *
+ * the basic operations are all externally similar to any other search
+ * tree, but additional work is done both on insert and delete to
+ * determine if the tree is out of balance and if so guide the
+ * rebalancing.
+ *
+ * scapegoat trees are 'loosely' height and width balanced, and while
+ * the rebalance operation can be lenghy, it will be done infrequently,
+ * amortizing the expense.
+ *
+ * the maximum depth for a balanced binary tree is log(2)N, but strict
+ * adherence to that is probably not wise.
+ *
+ * for relatively small trees (~100 nodes? ~1000? testing is needed)
+ * we don't need to rebalance the tree because even if the tree has
+ * degenerated into a list it just doesn't take long to find a node on
+ * modern hardware.
+ *
+ * a bit of tennessee windage is applied (currently +2) to the optimal
+ * depth before rebalancing is triggered. the whole tree or just a
+ * branch may be rebalanced. my current plan is to avoid full tree
+ * rebalancing by backtracking up to the root and if a node is found
+ * where one side or the other has 'too many children', just rebalance
+ * there and continue.
+ *
+ * while checking node depth is valid for insertion, it is not for
+ * deletion.
+ *
+ * the recommendation is to rebalance the entire tree once 'the number
+ * of deletions performed is significant compared with the tree size.'
+ * (lecture notes by Dave Mount for CMSC 420: Lecture 12 Balancing
+ * by Rebuilding – Scapegoat Trees, University of Maryland, fall 2020)
+ *
+ * to do this, count insertions and compare that to the actual number
+ * of nodes in the tree. once there has been enough churn (inserts > 2
+ * * nodes), reblance the whole tree.
+ *
+ * i expect to experiment to find a ratio that works in my use cases.
+ * i am also trying to envision ways to rebalance only a portion of
+ * the tree on deletion.
+ *
+ * for either case, rebalancing is just a matter of recursive bisection
+ * of the nodes and relinking them.
+ */
+
+/*
+ * full Tree rebalance.
+ */
+
+one_tree *
+btree_rebalance(one_tree *self) {
+	if (!self || !self->root)
+		return self;
+	btree_rebalance_r(self, self->root);
+	FPRINTF_INFO fprintf(stderr, "Rebalance:\n");
+	FPRINTF_INFO fprintf(stderr, "  nodes: %d\n", self->nodes);
+	FPRINTF_INFO fprintf(stderr, "inserts: %d\n", self->inserts);
+	FPRINTF_INFO fprintf(stderr, "deletes: %d\n", self->deletes);
+	FPRINTF_INFO fprintf(stderr, "updates: %d\n", self->updates);
+	FPRINTF_INFO fprintf(stderr, " marked: %d\n", self->marked_deleted);
+	FPRINTF_INFO fprintf(stderr, "partial: %d\n", self->partial_rebalances);
+
+	self->inserts = 0;
+	self->deletes = 0;
+	self->updates = 0;
+	self->marked_deleted = 0;
+
+	FPRINTF_INFO fprintf(stderr, "   full: %d\n", self->full_rebalances);
+	return self;
+}
+
+/*
+ * a full tree rebalance is triggered by deletes exceeding some percenta
+ * of total nodes or inserts being currently double nodes. post
+ * insert depth checks are done on insert.
+ */
+
+bool
+btree_should_full_rebalance(one_tree *self) {
+	/* empty tree or too few nodes, don't bother */
+	if (!self->root || self->nodes < self->policy.minimum)
+		return false;
+
+	/* have we done enough deletes? */
+	if (100*((float)self->marked_deleted/self->nodes) >
+		self->policy.delete_percent)
+		return true;
+
+	/* too much churn */
+	if (self->inserts > 2 * self->nodes)
+		return true;
+
+	return false;
+}
+
+/*
+ * deleted nodes can also be collected a few at a time instead of
+ * waiting for a rebalance. a node with at most one child is spliced
+ * out. a node with two children takes the key and value of its
+ * successor, which is then spliced out in its place. either way the
+ * counts are redone up to the root.
+ */
+
+static
+void
+btree_recount_up(one_tree *self, one_node *n) {
+	while (n) {
+		n->size = 1 + btree_size(self, n->left) + btree_size(self, n->right);
+		n->live = !n->deleted + btree_live_size(n->left) + btree_live_size(n->right);
+		n = n->parent;
+	}
+}
+
+static
+void
+btree_splice(one_tree *self, one_node *x) {
+	one_node *child = x->left ? x->left : x->right;
+	one_node *parent = x->parent;
+	if (child)
+		child->parent = parent;
+	if (!parent)
+		self->root = child;
+	else if (parent->left == x)
+		parent->left = child;
+	else
+		parent->right = child;
+	if (self->sweep == x)
+		self->sweep = NULL;
+	pool_give(&self->pool, x, sizeof(*x));
+	btree_recount_up(self, parent);
+}
+
+/*
+ * remove a deleted node and return the node holding the next key in
+ * order. if the successor was itself deleted, that node is still a
+ * tombstone.
+ */
+
+static
+one_node *
+btree_remove_tombstone(one_tree *self, one_node *t) {
+	self->marked_deleted -= 1;
+	if (t->left && t->right) {
+		one_node *s = btree_leftmost(t->right);
+		t->key = s->key;
+		t->prefix = s->prefix;
+		t->value = s->value;
+		t->deleted = s->deleted;
+		btree_splice(self, s);
+		return t;
+	}
+	one_node *next = btree_successor(t);
+	btree_splice(self, t);
+	return next;
+}
+
+/*
+ * walk up to budget nodes in order from where the last sweep stopped,
+ * removing the deleted ones. a budget of 0 or less keeps going until
+ * there are none left.
+ */
+
+static
+int
+btree_sweep(one_tree *self, int budget) {
+	int collected = 0;
+	bool all = budget <= 0;
+	one_node *n = self->sweep;
+	while ((all || budget-- > 0) && self->marked_deleted > 0) {
+		if (!n)
+			n = btree_leftmost(self->root);
+		if (!n)
+			break;
+		if (n->deleted) {
+			n = btree_remove_tombstone(self, n);
+			collected += 1;
+		} else
+			n = btree_successor(n);
+	}
+	self->sweep = n;
+	return collected;
+}
+
+/*
+ * keys and values are passed as if they are pointers, but they do not
+ * have to be.
+ *
+ * if key is a pointer, make sure the value referenced doesn't change
+ * or the Tree will be broken.
+ *
+ * see the comments on get() below for more on pointers.
+ */
+
+/*
+ * insert a new node into the tree
+ */
+
+bool
+btree_insert_r(one_tree *self, one_node *parent, one_node *new) {
+
+	/* tree is empty */
+	if (!parent) {
+		self->root = new;
+		return true;
+	}
+
+	/* were does new key fit? */
+	keycmp_result side = keycmp_node(self, new->key, new->prefix, parent);
+
+	/* key match, but is it a deleted node? */
+	if (side == EQUAL) {
+		if (parent->deleted) {
+			parent->deleted = false;
+			parent->value = new->value;
+			btree_node_free(self, new);
+			return true;
+		}
+		btree_node_free(self, new);
+		/* fprintf(stderr, "ERROR insert: attempt to insert an existing key\n"); */
+		return false;
+	}
+
+	new->parent = parent;
+
+	/* counting on deletion of leaf Nodes to really delete, not just
+	 * mark the Node as deleted. */
+	if (side == LESS && !parent->left)
+		parent->left = new;
+	else if (side == GREATER && !parent->right)
+		parent->right = new;
+	else {
+		fprintf(stderr, "ERROR insert: attempting to overlay existing node %p %p\n",
+			(void *)new, (void *)parent);
+		btree_node_free(self, new);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+btree_insert(one_tree *self, void *key, void *value) {
+	one_node *parent = btree_get_Node_or_parent(self, key);
+
+	/* a key marked deleted is brought back in place. there is no new
+	 * node to check for balance. */
+	if (parent && parent->deleted && keycmp(self, key, parent->key) == EQUAL) {
+		parent->deleted = false;
+		parent->value = value;
+		btree_adjust_sizes(parent, 0, 1);
+		self->marked_deleted -= 1;
+		self->nodes += 1;
+		self->inserts += 1;
+		return true;
+	}
+
+	one_node *n = btree_make_Node(self, key, value);
+	bool did = btree_insert_r(self, parent, n);
+	if (did) {
+		btree_adjust_sizes(n->parent, 1, 1);
+		self->nodes += 1;
+		self->inserts += 1;
+		if (self->policy.rebalance_allowed && btree_is_unbalanced(self, n)) {
+			FPRINTF_INFO fprintf(stderr, "INFO insert: unbalanced@ %d %d %d %d %ld\n",
+				self->nodes, self->inserts,
+				btree_size(self, self->root), btree_height(self, n), (uintptr_t)key);
+			one_node *s = n->parent;
+			while (s) {
+				if (!btree_is_scapegoat(self, s)) {
+					s = s->parent;
+					continue;
+				}
+				FPRINTF_INFO fprintf(stderr, "INFO insert:  scapegoat@ %d %d %d %d %ld\n",
+					self->nodes, self->inserts,
+					btree_size(self, self->root), btree_height(self, s), (uintptr_t)s->key);
+				s = btree_rebalance_r(self, s->parent ? s->parent : s);
+				break;
+			}
+			if (!s) FPRINTF_INFO fprintf(stderr, "INFO insert: no scapegoat found!\n");
+		}
+		if (self->policy.sweep_budget > 0)
+			btree_sweep(self, self->policy.sweep_budget);
+	}
+	return did;
+}
+
+/*
+ * delete a node from the tree.
+ *
+ * most deletes are deferred. rather than juggle pointers we'll drop the
+ * deleted Nodes during a rebalance.
+ */
+
+bool
+btree_delete(one_tree *self, void *key) {
+	one_node *n = btree_get_Node_or_NULL(self, key);
+	if (!n || n->deleted) {
+		fprintf(stderr, "WARNING delete: key not found in tree.\n");
+		return false;
+	}
+
+	/* if it's a terminal Node that isn't root, really delete it. */
+
+	if (!n->left && !n->right) {
+		FPRINTF_INFO fprintf(stderr, "INFO deleting leaf: %p\n", (void *)n->key);
+		btree_adjust_sizes(n->parent, -1, -1);
+		if (self->sweep == n)
+			self->sweep = btree_successor(n);
+		if (n->parent && n->parent->left == n) n->parent->left = NULL;
+		if (n->parent && n->parent->right == n) n->parent->right = NULL;
+		if (n->parent == NULL && self->root == n)
+			self->root = NULL;
+		n->parent = NULL;
+		btree_node_free(self, n);
+		self->deletes += 1;
+		self->nodes -= 1;
+		return true;
+	};
+
+	/* flag the Node as deleted, it will be removed during rebalancing. */
+
+	FPRINTF_INFO fprintf(stderr, "INFO marking deleted non-leaf: %p\n",
+		(void *)n->key);
+
+	n->deleted = true;
+	n->value = NULL;
+	btree_adjust_sizes(n, 0, -1);
+	self->marked_deleted += 1;
+	self->deletes += 1;
+	self->nodes -= 1;
+
+	/* as an experiment, i tried to rebalance on every delete, but only under
+	 * node's parent. this leads to a read of a freed node. it's not worth
+	 * chasing down at this time.*/
+
+	if (self->policy.sweep_budget > 0)
+		btree_sweep(self, self->policy.sweep_budget);
+	if (btree_should_full_rebalance(self))
+		btree_rebalance(self);
+
+	return true;
+}
+
+/*
+ * get and return the value associated with a key
+ *
+ * while the code reads as if key and value are pointers, that is
+ * not strictly enforced. any value that will fit into a pointer
+ * sized space is legal.
+ *
+ * if the key is not found or deleted, a NULL is returned, but a
+ * NULL could be a valid value in the client's schema. if this
+ * is true, exists() should be used before get() if the client
+ * cares that a given key did not exist.
+ */
+
+void *
+btree_get(one_tree *self, void *key) {
+	one_node *n = btree_get_Node_or_NULL(self, key);
+	if (!n || n->deleted) return NULL;
+	return n->value;
+}
+
+/*
+ * update the value associated with a key
+ *
+ * if value is a pointer, this isn't strictly needed.
+ */
+
+bool
+btree_update(one_tree *self, void *key, void *value) {
+	one_node *n = btree_get_Node_or_NULL(self, key);
+	if (n == NULL) return false;
+	n->value = value;
+	self->updates += 1;
+	return true;
+}
+
+/*
+ * predicates and queries on the Tree or its contents
+ */
+
+bool
+btree_is_empty(one_tree *self) {
+	return self->nodes == 0;
+}
+
+int
+btree_count(one_tree* self) {
+	return self->nodes;
+}
+
+bool
+btree_exists(one_tree *self, void *key) {
+	one_node *n = btree_get_Node_or_NULL(self, key);
+	if (!n || n->deleted) return NULL;
+	return n;
+}
+
+/*
+ * the first live node with a key at or above the key, or strictly
+ * above it. the descent remembers the last node that qualified, and
+ * if that one is deleted its live successor is the answer.
+ */
+
+static
+one_node *
+btree_lower_bound(one_tree *self, void *key, bool strict) {
+	uint64_t prefix = key_prefix(self, key);
+	one_node *found = NULL;
+	one_node *n = self->root;
+	while (n) {
+		keycmp_result cmp = keycmp_node(self, key, prefix, n);
+		if (cmp == LESS || (cmp == EQUAL && !strict)) {
+			found = n;
+			n = n->left;
+		} else
+			n = n->right;
+	}
+	return btree_live(found);
+}
+
+/*
+ * the last live node with a key at or below the key.
+ */
+
+static
+one_node *
+btree_floor(one_tree *self, void *key) {
+	uint64_t prefix = key_prefix(self, key);
+	one_node *found = NULL;
+	one_node *n = self->root;
+	while (n) {
+		if (keycmp_node(self, key, prefix, n) != LESS) {
+			found = n;
+			n = n->right;
+		} else
+			n = n->left;
+	}
+	return btree_live_back(found);
+}
+
+/*
+ * count the live keys less than the key on the way down.
+ */
+
+static
+int
+btree_rank(one_tree *self, void *key) {
+	uint64_t prefix = key_prefix(self, key);
+	int r = 0;
+	one_node *n = self->root;
+	while (n) {
+		switch (keycmp_node(self, key, prefix, n)) {
+		case LESS:
+			n = n->left;
+			break;
+		case EQUAL:
+			return r + btree_live_size(n->left);
+		default:
+			r += btree_live_size(n->left) + (n->deleted ? 0 : 1);
+			n = n->right;
+		}
+	}
+	return r;
+}
+
+/*
+ * the live node at position i, or NULL.
+ */
+
+static
+one_node *
+btree_select(one_tree *self, int i) {
+	one_node *n = self->root;
+	if (i < 0 || i >= btree_live_size(n))
+		return NULL;
+	while (n) {
+		int left = btree_live_size(n->left);
+		if (i < left)
+			n = n->left;
+		else if (i == left && !n->deleted)
+			return n;
+		else {
+			i -= left + (n->deleted ? 0 : 1);
+			n = n->right;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * call the client for each live node with a key in [lo, hi]. finding
+ * lo is O(log n) and stepping to the next node is O(1) amortized.
+ */
+
+static
+int
+btree_range(one_tree *self, void *lo, void *hi, void *context, fn_traversal_cb fn) {
+	int called = 0;
+	one_node *n = btree_lower_bound(self, lo, false);
+	while (n && keycmp(self, n->key, hi) != GREATER) {
+		called += 1;
+		if (!fn(n->key, n->value, context, self))
+			break;
+		n = btree_live(btree_successor(n));
+	}
+	return called;
+}
+
+/*
+ * build a perfectly balanced subtree over keys[lo, hi), which are
+ * known to be in order, and hang it from parent. the middle key is
+ * the root and each half goes on the same way, so this is O(n) and
+ * only log n deep.
+ */
+
+static
+one_node *
+btree_load_r(one_tree *self, void **keys, void **values, int lo, int hi, one_node *parent) {
+	if (lo >= hi)
+		return NULL;
+	int mid = lo + (hi - lo) / 2;
+	one_node *n = btree_make_Node(self, keys[mid], values[mid]);
+	n->parent = parent;
+	n->left = btree_load_r(self, keys, values, lo, mid, n);
+	n->right = btree_load_r(self, keys, values, mid + 1, hi, n);
+	n->size = hi - lo;
+	n->live = hi - lo;
+	return n;
+}
+
+static
+void
+btree_load(one_tree *self, void **keys, void **values, int n) {
+	self->root = btree_load_r(self, keys, values, 0, n, NULL);
+	self->nodes += n;
+	self->inserts += n;
+}
+
+/*
+ * the priority queue (pqueue) is a non-uniquely keyed doubly
+ * linked list. many of the functions look redundant with their
+ * doubly counterparts, but i prefer duplication to a bunch of
+ * special case if/else blocks.
+ */
+
+static
+int
+pq_count(
+	one_block *pq
+) {
+	return pq->u.pqu.length;
+}
+
+static
+pq_item *
+pq_create_item(
+	one_block *pq,
+	long priority,
+	void * payload
+) {
+	pq_item *qi = pool_take(&pq->u.pqu.pool, sizeof(*qi));
+	qi->priority = priority;
+	qi->item = payload;
+	qi->next = NULL;
+	qi->previous = NULL;
+	return qi;
+}
+
+static
+int
+pq_purge(
+	one_block *pq
+) {
+	int i = pq->u.pqu.length;
+	pq->u.pqu.first = NULL;
+	pq->u.pqu.last = NULL;
+	pq->u.pqu.length = 0;
+	pool_release(&pq->u.pqu.pool, sizeof(pq_item));
+	return i;
+}
+
+/*
+ * loading a linked pqueue in bulk sorts the pairs and then links
+ * them. to match the order that repeated adds would give, equal
+ * priorities are held newest to oldest, so later pairs sort first
+ * among equals.
+ */
+
+typedef struct pq_sort_key pq_sort_key;
+struct pq_sort_key {
+	long priority;
+	int index;
+};
+
+static
+int
+pq_sort_cmp(
+	const void *left,
+	const void *right
+) {
+	const pq_sort_key *l = left;
+	const pq_sort_key *r = right;
+	if (l->priority != r->priority)
+		return l->priority < r->priority ? -1 : 1;
+	return r->index - l->index;
+}
+
+static
+void
+pq_load(
+	one_block *pq,
+	const pq_pair *pairs,
+	int n
+) {
+	pq_sort_key *keys = tsmalloc(n * sizeof(pq_sort_key));
+	for (int i = 0; i < n; i++) {
+		keys[i].priority = pairs[i].priority;
+		keys[i].index = i;
+	}
+	qsort(keys, n, sizeof(pq_sort_key), pq_sort_cmp);
+	pq_item *last = NULL;
+	for (int i = 0; i < n; i++) {
+		pq_item *qi = pq_create_item(pq, keys[i].priority, pairs[keys[i].index].item);
+		qi->previous = last;
+		if (last)
+			last->next = qi;
+		else
+			pq->u.pqu.first = qi;
+		last = qi;
+	}
+	pq->u.pqu.last = last;
+	pq->u.pqu.length = n;
+	ONE_POISON(keys, n * sizeof(pq_sort_key));
+	tsfree(keys);
+}
+
+/*
+ * the heap backed priority queue (pqheap) keeps its slots in an array
+ * as a binary max heap. the children of slot i are at 2i+1 and 2i+2.
+ *
+ * every item is stamped on arrival and the stamp breaks priority
+ * ties, older first from the max and newer first from the min.
+ * that's what keeps the heap's ordering the same as the linked
+ * list's.
+ *
+ * the heap is only ordered for the max. the min side functions scan
+ * the leaves.
+ */
+
+/*
+ * should slot a sit above slot b in the heap?
+ */
+
+static
+bool
+pqh_above(
+	pq_slot *a,
+	pq_slot *b
+) {
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return a->stamp < b->stamp;
+}
+
+/*
+ * and should a come out before b when taking from the min side? the
+ * linked list holds equal priorities newest first, so its min end
+ * gives the newest. newer first here too.
+ */
+
+static
+bool
+pqh_below(
+	pq_slot *a,
+	pq_slot *b
+) {
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+	return a->stamp > b->stamp;
+}
+
+static
+void
+pqh_sift_up(
+	one_pqheap *self,
+	int i
+) {
+	pq_slot hold = self->heap[i];
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!pqh_above(&hold, &self->heap[parent]))
+			break;
+		self->heap[i] = self->heap[parent];
+		i = parent;
+	}
+	self->heap[i] = hold;
+}
+
+static
+void
+pqh_sift_down(
+	one_pqheap *self,
+	int i
+) {
+	pq_slot hold = self->heap[i];
+	int n = self->length;
+	while (true) {
+		int child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && pqh_above(&self->heap[child + 1], &self->heap[child]))
+			child += 1;
+		if (!pqh_above(&self->heap[child], &hold))
+			break;
+		self->heap[i] = self->heap[child];
+		i = child;
+	}
+	self->heap[i] = hold;
+}
+
+static
+one_pqheap *
+pqh_add(
+	one_pqheap *self,
+	long priority,
+	void *item
+) {
+	if (self->length == self->capacity) {
+		pq_slot *old = self->heap;
+		self->heap = tsmalloc(2 * self->capacity * sizeof(pq_slot));
+		memcpy(self->heap, old, self->capacity * sizeof(pq_slot));
+		ONE_POISON(old, self->capacity * sizeof(pq_slot));
+		tsfree(old);
+		self->capacity *= 2;
+	}
+	pq_slot *s = &self->heap[self->length];
+	s->priority = priority;
+	s->stamp = self->stamp;
+	s->item = item;
+	self->stamp += 1;
+	self->length += 1;
+	pqh_sift_up(self, self->length - 1);
+	return self;
+}
+
+/*
+ * remove the slot at index i, filling the hole with the last slot and
+ * moving that either up or down as needed.
+ */
+
+static
+void *
+pqh_remove_at(
+	one_pqheap *self,
+	int i
+) {
+	void *res = self->heap[i].item;
+	self->length -= 1;
+	if (i == self->length)
+		return res;
+	self->heap[i] = self->heap[self->length];
+	if (i > 0 && pqh_above(&self->heap[i], &self->heap[(i - 1) / 2]))
+		pqh_sift_up(self, i);
+	else
+		pqh_sift_down(self, i);
+	return res;
+}
+
+/*
+ * pqh_below is the exact reverse of pqh_above, so the min is the
+ * least slot in the heap's order and can't have children. it's one
+ * of the leaves, the bottom half of the array.
+ */
+
+static
+int
+pqh_min_index(
+	one_pqheap *self
+) {
+	if (self->length == 0)
+		return -1;
+	int m = self->length / 2;
+	for (int i = m + 1; i < self->length; i++)
+		if (pqh_below(&self->heap[i], &self->heap[m]))
+			m = i;
+	return m;
+}
+
+static
+int
+pqh_purge(
+	one_pqheap *self
+) {
+	int i = self->length;
+	memset(self->heap, 0, self->capacity * sizeof(pq_slot));
+	self->length = 0;
+	return i;
+}
+
+/*
+ * load a heap in one go, floyd's heapify. the slots are already in
+ * place with their stamps, so sift down from the last parent to the
+ * root. O(n).
+ */
+
+static
+void
+pqh_heapify(
+	one_pqheap *self
+) {
+	for (int i = self->length / 2 - 1; i >= 0; i--)
+		pqh_sift_down(self, i);
+}
+
+/*
+ * the dual heap backed priority queue (pqdual) keeps a max heap and a
+ * min heap of indices into one packed array of slots. h selects the
+ * heap, 0 for the max and 1 for the min. each slot carries its index
+ * in both heaps, so a slot taken from the top of one heap can be cut
+ * out of the middle of the other in O(log n).
+ *
+ * the stamp tie breaker is the same as for pqheap, older first at
+ * the max and newer first at the min.
+ */
+
+#define PQD_MAX 0
+#define PQD_MIN 1
+
+static
+bool
+pqd_before(
+	one_pqdual *self,
+	int h,
+	int a,
+	int b
+) {
+	if (h == PQD_MAX)
+		return pqh_above(&self->slot[a].s, &self->slot[b].s);
+	return pqh_below(&self->slot[a].s, &self->slot[b].s);
+}
+
+static
+void
+pqd_place(
+	one_pqdual *self,
+	int h,
+	int i,
+	int slot
+) {
+	self->heap[h][i] = slot;
+	self->slot[slot].at[h] = i;
+}
+
+static
+void
+pqd_sift_up(
+	one_pqdual *self,
+	int h,
+	int i
+) {
+	int hold = self->heap[h][i];
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!pqd_before(self, h, hold, self->heap[h][parent]))
+			break;
+		pqd_place(self, h, i, self->heap[h][parent]);
+		i = parent;
+	}
+	pqd_place(self, h, i, hold);
+}
+
+static
+void
+pqd_sift_down(
+	one_pqdual *self,
+	int h,
+	int i,
+	int n
+) {
+	int hold = self->heap[h][i];
+	while (true) {
+		int child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && pqd_before(self, h, self->heap[h][child + 1], self->heap[h][child]))
+			child += 1;
+		if (!pqd_before(self, h, self->heap[h][child], hold))
+			break;
+		pqd_place(self, h, i, self->heap[h][child]);
+		i = child;
+	}
+	pqd_place(self, h, i, hold);
+}
+
+static
+one_pqdual *
+pqd_add(
+	one_pqdual *self,
+	long priority,
+	void *item
+) {
+	if (self->length == self->capacity) {
+		int cap = 2 * self->capacity;
+		pq_dslot *old_slot = self->slot;
+		self->slot = tsmalloc(cap * sizeof(pq_dslot));
+		memcpy(self->slot, old_slot, self->capacity * sizeof(pq_dslot));
+		ONE_POISON(old_slot, self->capacity * sizeof(pq_dslot));
+		tsfree(old_slot);
+		for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+			int *old_heap = self->heap[h];
+			self->heap[h] = tsmalloc(cap * sizeof(int));
+			memcpy(self->heap[h], old_heap, self->capacity * sizeof(int));
+			ONE_POISON(old_heap, self->capacity * sizeof(int));
+			tsfree(old_heap);
+		}
+		self->capacity = cap;
+	}
+	int n = self->length;
+	pq_dslot *d = &self->slot[n];
+	d->s.priority = priority;
+	d->s.stamp = self->stamp;
+	d->s.item = item;
+	self->stamp += 1;
+	self->length += 1;
+	for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+		pqd_place(self, h, n, n);
+		pqd_sift_up(self, h, n);
+	}
+	return self;
+}
+
+/*
+ * take the slot at the top of heap h. it comes out of both heaps,
+ * and the last slot in the array moves into the hole it leaves so
+ * the slots stay packed.
+ */
+
+static
+void *
+pqd_take(
+	one_pqdual *self,
+	int h
+) {
+	if (self->length == 0)
+		return NULL;
+	int victim = self->heap[h][0];
+	void *res = self->slot[victim].s.item;
+	int n = self->length - 1;
+
+	/* out of both heaps, filling from the end of each */
+	for (int k = PQD_MAX; k <= PQD_MIN; k++) {
+		int i = self->slot[victim].at[k];
+		if (i == n)
+			continue;
+		pqd_place(self, k, i, self->heap[k][n]);
+		if (i > 0 && pqd_before(self, k, self->heap[k][i], self->heap[k][(i - 1) / 2]))
+			pqd_sift_up(self, k, i);
+		else
+			pqd_sift_down(self, k, i, n);
+	}
+
+	/* and pack the slots */
+	if (victim != n) {
+		self->slot[victim] = self->slot[n];
+		for (int k = PQD_MAX; k <= PQD_MIN; k++)
+			self->heap[k][self->slot[victim].at[k]] = victim;
+	}
+	self->length = n;
+	return res;
+}
+
+/*
+ * as pqh_heapify, but for both heaps. the slots must be in place, and
+ * each heap starts out as the identity.
+ */
+
+static
+void
+pqd_heapify(
+	one_pqdual *self
+) {
+	int n = self->length;
+	for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+		for (int i = 0; i < n; i++)
+			pqd_place(self, h, i, i);
+		for (int i = n / 2 - 1; i >= 0; i--)
+			pqd_sift_down(self, h, i, n);
+	}
+}
+
+static
+pq_slot *
+pqd_peek(
+	one_pqdual *self,
+	int h
+) {
+	return self->length ? &self->slot[self->heap[h][0]].s : NULL;
+}
+
+static
+int
+pqd_purge(
+	one_pqdual *self
+) {
+	int i = self->length;
+	memset(self->slot, 0, self->capacity * sizeof(pq_dslot));
+	self->length = 0;
+	return i;
+}
+
+/*
+ * the hash backed keyval. an open addressing table with linear probing.
+ * the capacity is always a power of two so a probe wraps with a mask.
+ *
+ * the stored hash is never zero, zero marks an empty bucket. deleting
+ * shifts later members of the probe run back into the hole, so there
+ * are no tombstones to clean up and lookups never get slower with
+ * churn.
+ */
+
+/*
+ * the default hash functions. integral keys get the splitmix64
+ * finalizer, which spreads sequential keys nicely. strings use
+ * fnv-1a.
+ */
+
+static
+uint64_t
+hash_integral(
+	const void *key
+) {
+	uint64_t h = (uint64_t)(uintptr_t)key;
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+static
+uint64_t
+hash_string(
+	const void *key
+) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (const unsigned char *s = key; *s; s++) {
+		h ^= *s;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static
+uint64_t
+hash_of(
+	one_hash *self,
+	void *key
+) {
+	uint64_t h = self->fn_hash(key);
+	return h ? h : 1;
+}
+
+/*
+ * integral keys are compared directly. the comparator would do, but
+ * this is the hot path and equality is all we need.
+ */
+
+static
+bool
+hash_same(
+	one_hash *self,
+	void *left,
+	void *right
+) {
+	if (self->kt == integral)
+		return left == right;
+	return self->fn_cmp(left, right) == 0;
+}
+
+/*
+ * return the bucket index holding key, or -1 if it isn't there.
+ */
+
+static
+int
+hash_find(
+	one_hash *self,
+	void *key
+) {
+	uint64_t h = hash_of(self, key);
+	int mask = self->capacity - 1;
+	int i = h & mask;
+	while (self->table[i].hash) {
+		if (self->table[i].hash == h && hash_same(self, key, self->table[i].key))
+			return i;
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+/*
+ * place an entry known not to be in the table. used by insert and
+ * when rehashing.
+ */
+
+static
+void
+hash_place(
+	one_hash *self,
+	uint64_t h,
+	void *key,
+	void *value
+) {
+	int mask = self->capacity - 1;
+	int i = h & mask;
+	while (self->table[i].hash)
+		i = (i + 1) & mask;
+	self->table[i].hash = h;
+	self->table[i].key = key;
+	self->table[i].value = value;
+	self->entries += 1;
+}
+
+static
+void
+hash_grow(
+	one_hash *self
+) {
+	hash_entry *old = self->table;
+	int old_capacity = self->capacity;
+	self->capacity = old_capacity * 2;
+	self->table = tsmalloc(self->capacity * sizeof(hash_entry));
+	memset(self->table, 0, self->capacity * sizeof(hash_entry));
+	self->entries = 0;
+	for (int i = 0; i < old_capacity; i++)
+		if (old[i].hash)
+			hash_place(self, old[i].hash, old[i].key, old[i].value);
+	ONE_POISON(old, old_capacity * sizeof(hash_entry));
+	tsfree(old);
+}
+
+static
+bool
+hash_insert(
+	one_hash *self,
+	void *key,
+	void *value
+) {
+	if (hash_find(self, key) >= 0)
+		return false;
+	if ((self->entries + 1) * 100 > self->capacity * ONE_HASH_LOAD_PERCENT)
+		hash_grow(self);
+	hash_place(self, hash_of(self, key), key, value);
+	return true;
+}
+
+static
+void *
+hash_get(
+	one_hash *self,
+	void *key
+) {
+	int i = hash_find(self, key);
+	return i < 0 ? NULL : self->table[i].value;
+}
+
+static
+bool
+hash_update(
+	one_hash *self,
+	void *key,
+	void *value
+) {
+	int i = hash_find(self, key);
+	if (i < 0)
+		return false;
+	self->table[i].value = value;
+	return true;
+}
+
+/*
+ * remove the entry and close the gap. each later member of the run
+ * moves back into the hole unless its home bucket lies cyclically
+ * after the hole, in which case it is already as close to home as it
+ * can get.
+ */
+
+static
+bool
+hash_delete(
+	one_hash *self,
+	void *key
+) {
+	int hole = hash_find(self, key);
+	if (hole < 0) {
+		fprintf(stderr, "WARNING delete: key not found in table.\n");
+		return false;
+	}
+	int mask = self->capacity - 1;
+	int i = (hole + 1) & mask;
+	while (self->table[i].hash) {
+		int home = self->table[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			self->table[hole] = self->table[i];
+			hole = i;
+		}
+		i = (i + 1) & mask;
+	}
+	memset(&self->table[hole], 0, sizeof(hash_entry));
+	self->entries -= 1;
+	return true;
+}
+
+static
+int
+hash_purge(
+	one_hash *self
+) {
+	int i = self->entries;
+	memset(self->table, 0, self->capacity * sizeof(hash_entry));
+	self->entries = 0;
+	return i;
+}
+
+/*
+ * collect the keys or values into an alist in table order.
+ */
+
+static
+one_block *
+hash_collector(
+	one_hash *self,
+	bool want_keys,
+	one_block *xs
+) {
+	for (int i = 0; i < self->capacity; i++)
+		if (self->table[i].hash)
+			xs = alist_cons(xs,
+					(uintptr_t)(want_keys ? self->table[i].key : self->table[i].value));
+	return xs;
+}
+
+/*
+ * sort collected keys in place with the table's comparator. a heap
+ * sort, since qsort won't carry the comparator to its callback.
+ */
+
+static
+void
+hash_sift_down(
+	one_hash *self,
+	uintptr_t *a,
+	int i,
+	int n
+) {
+	for (;;) {
+		int big = i;
+		int l = 2 * i + 1;
+		int r = l + 1;
+		if (l < n && self->fn_cmp((void *)a[l], (void *)a[big]) > 0) big = l;
+		if (r < n && self->fn_cmp((void *)a[r], (void *)a[big]) > 0) big = r;
+		if (big == i)
+			return;
+		uintptr_t t = a[i];
+		a[i] = a[big];
+		a[big] = t;
+		i = big;
+	}
+}
+
+static
+void
+hash_sort_keys(
+	one_hash *self,
+	uintptr_t *a,
+	int n
+) {
+	for (int i = n / 2 - 1; i >= 0; i--)
+		hash_sift_down(self, a, i, n);
+	for (int end = n - 1; end > 0; end--) {
+		uintptr_t t = a[0];
+		a[0] = a[end];
+		a[end] = t;
+		hash_sift_down(self, a, 0, end);
+	}
+}
+
+/*
+ * the next bucket in use at or after i, or capacity if there are no
+ * more.
+ */
+
+static
+int
+hash_next_used(
+	one_hash *self,
+	int i
+) {
+	while (i < self->capacity && self->table[i].hash == 0)
+		i += 1;
+	return i;
+}
+
+/*
+ * the B+ tree backed keyval. nodes hold up to ONE_BPLUS_KEYS keys,
+ * and the keys and values live in the leaves.
+ *
+ * both insert and delete work top down in one pass. on the way down
+ * an insert splits any full node before entering it, so there is
+ * always room for a split below to push a key up. a delete tops up
+ * any node at the minimum before entering it, borrowing from a
+ * sibling or merging with one, so a removal below never leaves a
+ * node short.
+ *
+ * a delete doesn't fix the routing keys above the leaf. a stale key
+ * in an inner node still separates its children correctly, it just
+ * isn't held any more.
+ *
+ * snapshots share nodes. each node counts the roots and parents that
+ * point to it, and a node is only changed in place when that count
+ * is one. otherwise the writer copies it first (bplus_own), so an
+ * insert, update, or delete copies at most the nodes on its path and
+ * the ones it borrows from or merges with. the leaves are not linked,
+ * a leaf can be under more than one version of the tree, so a cursor
+ * keeps the inner nodes it came down through and steps along those
+ * to the next leaf.
+ *
+ * all versions take their nodes from the same arena, which goes when
+ * the last of them is freed.
+ */
+
+#define BP_MIN ((ONE_BPLUS_KEYS - 1) / 2)
+
+/*
+ * as with keycmp, integral keys skip the comparator.
+ */
+
+static
+int
+bplus_cmp(
+	one_bplus *self,
+	void *left,
+	void *right
+) {
+	if (self->kt == integral)
+		return ((long)left > (long)right) - ((long)left < (long)right);
+	return self->fn_cmp(left, right);
+}
+
+/*
+ * the first key in a node at or above the key, and the first key
+ * strictly above it. a search in an inner node follows the child
+ * under bplus_upper.
+ *
+ * for integral keys it's quicker to count the keys below than to
+ * binary search. the count has no branches to mispredict and the
+ * keys are already in cache.
+ */
+
+static
+int
+bplus_lower(
+	one_bplus *self,
+	bp_node *n,
+	void *key
+) {
+	if (self->kt == integral) {
+		int i = 0;
+		for (int j = 0; j < n->count; j++)
+			i += (long)n->key[j] < (long)key;
+		return i;
+	}
+	int lo = 0;
+	int hi = n->count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (bplus_cmp(self, key, n->key[mid]) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static
+int
+bplus_upper(
+	one_bplus *self,
+	bp_node *n,
+	void *key
+) {
+	if (self->kt == integral) {
+		int i = 0;
+		for (int j = 0; j < n->count; j++)
+			i += (long)n->key[j] <= (long)key;
+		return i;
+	}
+	int lo = 0;
+	int hi = n->count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (bplus_cmp(self, key, n->key[mid]) >= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * the leaf that holds the key, or would if it were there.
+ */
 
-	one_node *parent = subtree->parent;
-	bool left_side = (parent && parent->left == subtree);
+static
+bp_leaf *
+bplus_leaf_for(
+	one_bplus *self,
+	void *key
+) {
+	bp_node *n = self->root;
+	if (!n)
+		return NULL;
+	while (!n->leaf)
+		n = ((bp_inner *)n)->child[bplus_upper(self, n, key)];
+	return (bp_leaf *)n;
+}
 
-	/* do an in_order traversal to get an alist of all non-deleted
-	 * nodes in the (sub)tree rooted at *subtree.
-	 *
-	 * this can be very slow when running with sanitizers and
-	 * debugging help. 10k items over 10 seconds vs 10k items
-	 * <2 seconds.
-	 *
-	 * and then there's the additinal memory consumed. we need
-	 * to start deleting once we're done with a node. */
-
-	one_block *xs = make_one(alist);
-	xs = btree_node_collector(self, subtree, xs);
-
-	/* build a new subtree by going over the node list in the
-	 * optimal order for insertion: that is, repeatedly halving
-	 * the list to create the ordered list and then linking the
-	 * nodes into a subtree. */
-
-	FPRINTF_INFO fprintf(stderr, "INFO rebalance nodes in subtree %d\n", count(xs));
-	one_node *new_subtree = btree_make_subtree_r(self, xs);
-	free_one(xs);
+/*
+ * the leaves at either end of a subtree.
+ */
 
-	/* destroy the old nodes and replace them with the new
-	 * nodes. */
+static
+bp_leaf *
+bplus_first_leaf(
+	bp_node *n
+) {
+	if (!n)
+		return NULL;
+	while (!n->leaf)
+		n = ((bp_inner *)n)->child[0];
+	return (bp_leaf *)n;
+}
 
-	btree_reset_subtree_r(self, subtree);
+static
+bp_leaf *
+bplus_last_leaf(
+	bp_node *n
+) {
+	if (!n)
+		return NULL;
+	while (!n->leaf)
+		n = ((bp_inner *)n)->child[n->count];
+	return (bp_leaf *)n;
+}
 
-	if (!parent) {
-		self->root = new_subtree;
-	} else {
-		if (left_side) parent->left = new_subtree;
-		else           parent->right = new_subtree;
-		self->partial_rebalances += 1;
-	}
+/*
+ * the leaves just after and just before the one that holds the key.
+ * on the way down remember the nearest subtree to that side, its
+ * first or last leaf is the answer. NULL at either end.
+ */
 
-	FPRINTF_INFO fprintf(stderr, "INFO rebalance end rebalancing\n");
-	return new_subtree;
+static
+bp_leaf *
+bplus_next_leaf(
+	one_bplus *self,
+	void *key
+) {
+	bp_node *after = NULL;
+	bp_node *n = self->root;
+	while (n && !n->leaf) {
+		int i = bplus_upper(self, n, key);
+		if (i < n->count)
+			after = ((bp_inner *)n)->child[i + 1];
+		n = ((bp_inner *)n)->child[i];
+	}
+	return bplus_first_leaf(after);
 }
 
 /*
- * the key:value store is built on a self balancing binary search
- * tree.
- *
- * i originally tried to use sedgewick's left-leaning red-black tree
- * but even after converting his java to c i can't get a working
- * solution. the best i got is that the my c of his java loses 23 keys
- * out of my 10k dataset. i have no idea why. after a couple of weeks
- * of tracing and banging my head, i gave up.
- *
- * next i looked at a plain red-black tree but the implementations are
- * fugly. it works but i don't really get procedure. at least with
- * sedgewick i understood what was going on.
- *
- * i had heard about scapegoat trees a while back and after reviewing
- * some documentation on them i know i can put an implementation
- * together that will work and be comprehensible.
- *
- * the basic operations are all externally similar to any other search
- * tree, but additional work is done both on insert and delete to
- * determine if the tree is out of balance and if so guide the
- * rebalancing.
- *
- * scapegoat trees are 'loosely' height and width balanced, and while
- * the rebalance operation can be lenghy, it will be done infrequently,
- * amortizing the expense.
- *
- * the maximum depth for a balanced binary tree is log(2)N, but strict
- * adherence to that is probably not wise.
- *
- * for relatively small trees (~100 nodes? ~1000? testing is needed)
- * we don't need to rebalance the tree because even if the tree has
- * degenerated into a list it just doesn't take long to find a node on
- * modern hardware.
- *
- * a bit of tennessee windage is applied (currently +2) to the optimal
- * depth before rebalancing is triggered. the whole tree or just a
- * branch may be rebalanced. my current plan is to avoid full tree
- * rebalancing by backtracking up to the root and if a node is found
- * where one side or the other has 'too many children', just rebalance
- * there and continue.
- *
- * while checking node depth is valid for insertion, it is not for
- * deletion.
- *
- * the recommendation is to rebalance the entire tree once 'the number
- * of deletions performed is significant compared with the tree size.'
- * (lecture notes by Dave Mount for CMSC 420: Lecture 12 Balancing
- * by Rebuilding – Scapegoat Trees, University of Maryland, fall 2020)
- *
- * to do this, count insertions and compare that to the actual number
- * of nodes in the tree. once there has been enough churn (inserts > 2
- * * nodes), reblance the whole tree.
- *
- * i expect to experiment to find a ratio that works in my use cases.
- * i am also trying to envision ways to rebalance only a portion of
- * the tree on deletion.
- *
- * for either case, rebalancing is just a matter of recursive bisection
- * of the nodes and relinking them.
+ * go down to the leaf that holds the key, or to the first leaf if
+ * leftmost, and note the inner nodes passed and the child taken in
+ * each in the cursor. the first ONE_CURSOR_DEPTH levels are kept.
  */
 
+static
+bp_leaf *
+bplus_down(
+	one_bplus *self,
+	void *key,
+	bool leftmost,
+	one_cursor *cur
+) {
+	bp_node *n = self->root;
+	cur->depth = 0;
+	while (n && !n->leaf) {
+		int i = leftmost ? 0 : bplus_upper(self, n, key);
+		if (cur->depth < ONE_CURSOR_DEPTH) {
+			cur->path[cur->depth] = (bp_inner *)n;
+			cur->slot[cur->depth] = i;
+		}
+		cur->depth += 1;
+		n = ((bp_inner *)n)->child[i];
+	}
+	return (bp_leaf *)n;
+}
+
 /*
- * full Tree rebalance.
+ * the leaf after the cursor's leaf l. back up the path to the nearest
+ * node with a child to the right, take it, and follow first children
+ * down again. a leaf is passed on the way up and down once per level,
+ * so a full walk averages O(1) a leaf. NULL past the last leaf.
  */
 
-one_tree *
-btree_rebalance(one_tree *self) {
-	if (!self || !self->root)
-		return self;
-	btree_rebalance_r(self, self->root);
-	FPRINTF_INFO fprintf(stderr, "Rebalance:\n");
-	FPRINTF_INFO fprintf(stderr, "  nodes: %d\n", self->nodes);
-	FPRINTF_INFO fprintf(stderr, "inserts: %d\n", self->inserts);
-	FPRINTF_INFO fprintf(stderr, "deletes: %d\n", self->deletes);
-	FPRINTF_INFO fprintf(stderr, "updates: %d\n", self->updates);
-	FPRINTF_INFO fprintf(stderr, " marked: %d\n", self->marked_deleted);
-	FPRINTF_INFO fprintf(stderr, "partial: %d\n", self->partial_rebalances);
+static
+bp_leaf *
+bplus_step(
+	one_bplus *self,
+	one_cursor *cur,
+	bp_leaf *l
+) {
+	if (cur->depth > ONE_CURSOR_DEPTH)
+		return bplus_next_leaf(self, l->h.key[l->h.count - 1]);
+	int d = cur->depth - 1;
+	while (d >= 0 && cur->slot[d] == cur->path[d]->h.count)
+		d -= 1;
+	if (d < 0)
+		return NULL;
+	cur->slot[d] += 1;
+	bp_node *n = cur->path[d]->child[cur->slot[d]];
+	for (d += 1; d < cur->depth; d++) {
+		cur->path[d] = (bp_inner *)n;
+		cur->slot[d] = 0;
+		n = cur->path[d]->child[0];
+	}
+	return (bp_leaf *)n;
+}
 
-	self->inserts = 0;
-	self->deletes = 0;
-	self->updates = 0;
-	self->marked_deleted = 0;
-	self->full_rebalances += 1;
+static
+bp_leaf *
+bplus_make_leaf(
+	one_bplus *self
+) {
+	bp_leaf *l = pool_take(&self->arena->leaves, sizeof(bp_leaf));
+	l->h.leaf = true;
+	l->h.refs = 1;
+	return l;
+}
 
-	FPRINTF_INFO fprintf(stderr, "   full: %d\n", self->full_rebalances);
-	return self;
+static
+bp_inner *
+bplus_make_inner(
+	one_bplus *self
+) {
+	bp_inner *in = pool_take(&self->arena->inners, sizeof(bp_inner));
+	in->h.refs = 1;
+	return in;
 }
 
 /*
- * a full tree rebalance is triggered by deletes exceeding some percenta
- * of total nodes or inserts being currently double nodes. post
- * insert depth checks are done on insert.
+ * drop a reference to a node. when the last one goes the node goes,
+ * and with it a reference to each of its children.
  */
 
-bool
-btree_should_full_rebalance(one_tree *self) {
-	/* empty tree or less than (arbitrarily) 64 nodes, don't bother */
-	if (!self->root || self->nodes < 64)
-		return false;
+static
+void
+bplus_release(
+	one_bplus *self,
+	bp_node *n
+) {
+	if (!n)
+		return;
+	n->refs -= 1;
+	if (n->refs > 0)
+		return;
+	if (n->leaf) {
+		pool_give(&self->arena->leaves, n, sizeof(bp_leaf));
+		return;
+	}
+	bp_inner *in = (bp_inner *)n;
+	for (int i = 0; i <= n->count; i++)
+		bplus_release(self, in->child[i]);
+	pool_give(&self->arena->inners, in, sizeof(bp_inner));
+}
 
-	/* have we done enough deletes? */
-	if (100*((float)self->marked_deleted/self->nodes) >
-		ONE_REBALANCE_DELETE_PERCENT)
-		return true;
+/*
+ * make the node in the slot, a root or child pointer, this version's
+ * alone so it can be changed. a shared node is copied, the copy's
+ * children gain a reference, and the slot is pointed at the copy.
+ */
 
-	/* too much churn */
-	if (self->inserts > 2 * self->nodes)
-		return true;
+static
+bp_node *
+bplus_own(
+	one_bplus *self,
+	bp_node **slot
+) {
+	bp_node *n = *slot;
+	if (n->refs == 1)
+		return n;
+	bp_node *c;
+	if (n->leaf) {
+		c = pool_take(&self->arena->leaves, sizeof(bp_leaf));
+		memcpy(c, n, sizeof(bp_leaf));
+	} else {
+		c = pool_take(&self->arena->inners, sizeof(bp_inner));
+		memcpy(c, n, sizeof(bp_inner));
+		for (int i = 0; i <= n->count; i++)
+			((bp_inner *)c)->child[i]->refs += 1;
+	}
+	c->refs = 1;
+	n->refs -= 1;
+	*slot = c;
+	return c;
+}
 
-	return false;
+/*
+ * split the full child i of p in two. a leaf keeps the lower half
+ * and the first key of the upper half is copied up. an inner node
+ * moves its middle key up. p must already be owned.
+ */
+
+static
+void
+bplus_split_child(
+	one_bplus *self,
+	bp_inner *p,
+	int i
+) {
+	bp_node *c = bplus_own(self, &p->child[i]);
+	bp_node *r;
+	void *up;
+	int keep = ONE_BPLUS_KEYS / 2;
+
+	if (c->leaf) {
+		bp_leaf *cl = (bp_leaf *)c;
+		bp_leaf *rl = bplus_make_leaf(self);
+		int moved = c->count - keep;
+		memcpy(rl->h.key, cl->h.key + keep, moved * sizeof(void *));
+		memcpy(rl->value, cl->value + keep, moved * sizeof(void *));
+		rl->h.count = moved;
+		c->count = keep;
+		r = &rl->h;
+		up = rl->h.key[0];
+	} else {
+		bp_inner *ci = (bp_inner *)c;
+		bp_inner *ri = bplus_make_inner(self);
+		int moved = c->count - keep - 1;
+		up = c->key[keep];
+		memcpy(ri->h.key, c->key + keep + 1, moved * sizeof(void *));
+		memcpy(ri->child, ci->child + keep + 1, (moved + 1) * sizeof(bp_node *));
+		ri->h.count = moved;
+		c->count = keep;
+		r = &ri->h;
+	}
+
+	memmove(p->h.key + i + 1, p->h.key + i, (p->h.count - i) * sizeof(void *));
+	memmove(p->child + i + 2, p->child + i + 1, (p->h.count - i) * sizeof(bp_node *));
+	p->h.key[i] = up;
+	p->child[i + 1] = r;
+	p->h.count += 1;
 }
-
+
 /*
- * keys and values are passed as if they are pointers, but they do not
- * have to be.
- *
- * if key is a pointer, make sure the value referenced doesn't change
- * or the Tree will be broken.
- *
- * see the comments on get() below for more on pointers.
+ * where a key is held, as a leaf and index. returns NULL if it isn't.
  */
 
+static
+bp_leaf *
+bplus_find(
+	one_bplus *self,
+	void *key,
+	int *at
+) {
+	bp_leaf *l = bplus_leaf_for(self, key);
+	if (!l)
+		return NULL;
+	int i = bplus_lower(self, &l->h, key);
+	if (i == l->h.count || bplus_cmp(self, key, l->h.key[i]) != 0)
+		return NULL;
+	*at = i;
+	return l;
+}
+
+static
+void *
+bplus_get(
+	one_bplus *self,
+	void *key
+) {
+	int i;
+	bp_leaf *l = bplus_find(self, key, &i);
+	return l ? l->value[i] : NULL;
+}
+
+static
+bool
+bplus_exists(
+	one_bplus *self,
+	void *key
+) {
+	int i;
+	return bplus_find(self, key, &i) != NULL;
+}
+
 /*
- * insert a new node into the tree
+ * insert a new key. returns false if the key is already held. while
+ * there are snapshots, check first so a repeated key doesn't copy a
+ * path for nothing.
  */
 
+static
 bool
-btree_insert_r(one_tree *self, one_node *parent, one_node *new) {
+bplus_insert(
+	one_bplus *self,
+	void *key,
+	void *value
+) {
+	if (self->arena->versions > 1 && bplus_exists(self, key))
+		return false;
+	if (!self->root) {
+		self->root = &bplus_make_leaf(self)->h;
+		self->height = 1;
+	}
+	bplus_own(self, &self->root);
+	if (self->root->count == ONE_BPLUS_KEYS) {
+		bp_inner *r = bplus_make_inner(self);
+		r->child[0] = self->root;
+		bplus_split_child(self, r, 0);
+		self->root = &r->h;
+		self->height += 1;
+	}
 
-	/* tree is empty */
-	if (!parent) {
-		self->root = new;
-		return true;
+	bp_node *n = self->root;
+	while (!n->leaf) {
+		bp_inner *in = (bp_inner *)n;
+		int i = bplus_upper(self, n, key);
+		if (in->child[i]->count == ONE_BPLUS_KEYS) {
+			bplus_split_child(self, in, i);
+			if (bplus_cmp(self, key, n->key[i]) >= 0)
+				i += 1;
+		}
+		n = bplus_own(self, &in->child[i]);
 	}
 
-	/* were does new key fit? */
-	int side = self->fn_cmp(new->key, parent->key);
+	bp_leaf *l = (bp_leaf *)n;
+	int i = bplus_lower(self, n, key);
+	if (i < n->count && bplus_cmp(self, key, n->key[i]) == 0)
+		return false;
+	memmove(n->key + i + 1, n->key + i, (n->count - i) * sizeof(void *));
+	memmove(l->value + i + 1, l->value + i, (n->count - i) * sizeof(void *));
+	n->key[i] = key;
+	l->value[i] = value;
+	n->count += 1;
+	self->entries += 1;
+	return true;
+}
 
-	/* key match, but is it a deleted node? */
-	if (side == 0) {
-		if (parent->deleted) {
-			parent->deleted = false;
-			parent->value = new->value;
-			btree_node_free(self, new);
-			return true;
-		}
-		btree_node_free(self, new);
-		/* fprintf(stderr, "ERROR insert: attempt to insert an existing key\n"); */
+/*
+ * replace the value of a held key, owning the path down to it.
+ */
+
+static
+bool
+bplus_update(
+	one_bplus *self,
+	void *key,
+	void *value
+) {
+	if (!bplus_exists(self, key))
 		return false;
+	bp_node *n = bplus_own(self, &self->root);
+	while (!n->leaf)
+		n = bplus_own(self, &((bp_inner *)n)->child[bplus_upper(self, n, key)]);
+	((bp_leaf *)n)->value[bplus_lower(self, n, key)] = value;
+	return true;
+}
+
+/*
+ * move one key from a sibling into child i of p, through p for an
+ * inner node. the routing key in p is reset to the new boundary.
+ * p and both children must already be owned.
+ */
+
+static
+void
+bplus_borrow_left(
+	bp_inner *p,
+	int i
+) {
+	bp_node *c = p->child[i];
+	bp_node *s = p->child[i - 1];
+	memmove(c->key + 1, c->key, c->count * sizeof(void *));
+	if (c->leaf) {
+		bp_leaf *cl = (bp_leaf *)c;
+		bp_leaf *sl = (bp_leaf *)s;
+		memmove(cl->value + 1, cl->value, c->count * sizeof(void *));
+		c->key[0] = s->key[s->count - 1];
+		cl->value[0] = sl->value[s->count - 1];
+		p->h.key[i - 1] = c->key[0];
+	} else {
+		bp_inner *ci = (bp_inner *)c;
+		bp_inner *si = (bp_inner *)s;
+		memmove(ci->child + 1, ci->child, (c->count + 1) * sizeof(bp_node *));
+		c->key[0] = p->h.key[i - 1];
+		ci->child[0] = si->child[s->count];
+		p->h.key[i - 1] = s->key[s->count - 1];
 	}
+	c->count += 1;
+	s->count -= 1;
+}
 
-	new->parent = parent;
+static
+void
+bplus_borrow_right(
+	bp_inner *p,
+	int i
+) {
+	bp_node *c = p->child[i];
+	bp_node *s = p->child[i + 1];
+	if (c->leaf) {
+		bp_leaf *cl = (bp_leaf *)c;
+		bp_leaf *sl = (bp_leaf *)s;
+		c->key[c->count] = s->key[0];
+		cl->value[c->count] = sl->value[0];
+		memmove(sl->value, sl->value + 1, (s->count - 1) * sizeof(void *));
+		memmove(s->key, s->key + 1, (s->count - 1) * sizeof(void *));
+		p->h.key[i] = s->key[0];
+	} else {
+		bp_inner *ci = (bp_inner *)c;
+		bp_inner *si = (bp_inner *)s;
+		c->key[c->count] = p->h.key[i];
+		ci->child[c->count + 1] = si->child[0];
+		p->h.key[i] = s->key[0];
+		memmove(s->key, s->key + 1, (s->count - 1) * sizeof(void *));
+		memmove(si->child, si->child + 1, s->count * sizeof(bp_node *));
+	}
+	c->count += 1;
+	s->count -= 1;
+}
 
-	/* counting on deletion of leaf Nodes to really delete, not just
-	 * mark the Node as deleted. */
-	if (side < 0 && !parent->left)
-		parent->left = new;
-	else if (side > 0 && !parent->right)
-		parent->right = new;
-	else {
-		fprintf(stderr, "ERROR insert: attempting to overlay existing node %p %p\n",
-			(void *)new, (void *)parent);
-		btree_node_free(self, new);
-		return false;
+/*
+ * fold child i + 1 of p into child i. both are at the minimum so the
+ * result fits. both must already be owned, the children of the
+ * folded node move over with their references.
+ */
+
+static
+void
+bplus_merge(
+	one_bplus *self,
+	bp_inner *p,
+	int i
+) {
+	bp_node *c = p->child[i];
+	bp_node *s = p->child[i + 1];
+	if (c->leaf) {
+		bp_leaf *cl = (bp_leaf *)c;
+		bp_leaf *sl = (bp_leaf *)s;
+		memcpy(c->key + c->count, s->key, s->count * sizeof(void *));
+		memcpy(cl->value + c->count, sl->value, s->count * sizeof(void *));
+		c->count += s->count;
+		pool_give(&self->arena->leaves, sl, sizeof(bp_leaf));
+	} else {
+		bp_inner *ci = (bp_inner *)c;
+		bp_inner *si = (bp_inner *)s;
+		c->key[c->count] = p->h.key[i];
+		memcpy(c->key + c->count + 1, s->key, s->count * sizeof(void *));
+		memcpy(ci->child + c->count + 1, si->child, (s->count + 1) * sizeof(bp_node *));
+		c->count += s->count + 1;
+		pool_give(&self->arena->inners, si, sizeof(bp_inner));
 	}
-
-	return true;
+	memmove(p->h.key + i, p->h.key + i + 1, (p->h.count - i - 1) * sizeof(void *));
+	memmove(p->child + i + 1, p->child + i + 2, (p->h.count - i - 1) * sizeof(bp_node *));
+	p->h.count -= 1;
 }
 
-bool
-btree_insert(one_tree *self, void *key, void *value) {
-	one_node *parent = btree_get_Node_or_parent(self, key);
-	one_node *n = btree_make_Node(self, key, value);
-	bool did = btree_insert_r(self, parent, n);
-	if (did) {
-		self->nodes += 1;
-		self->inserts += 1;
-		if (self->rebalance_allowed && btree_is_unbalanced(self, n)) {
-			FPRINTF_INFO fprintf(stderr, "INFO insert: unbalanced@ %d %d %d %d %ld\n",
-				self->nodes, self->inserts,
-				btree_size(self, self->root), btree_height(self, n), (uintptr_t)key);
-			one_node *s = n->parent;
-			while (s) {
-				if (!btree_is_scapegoat(self, s)) {
-					s = s->parent;
-					continue;
-				}
-				FPRINTF_INFO fprintf(stderr, "INFO insert:  scapegoat@ %d %d %d %d %ld\n",
-					self->nodes, self->inserts,
-					btree_size(self, self->root), btree_height(self, s), (uintptr_t)s->key);
-				s = btree_rebalance_r(self, s);
-				break;
-			}
-			if (!s) FPRINTF_INFO fprintf(stderr, "INFO insert: no scapegoat found!\n");
-		}
+/*
+ * make sure child i of p can give up a key, owning it and whichever
+ * sibling is used. returns the index of the child to descend into,
+ * which moves left if it merged with its left sibling.
+ */
+
+static
+int
+bplus_fill_child(
+	one_bplus *self,
+	bp_inner *p,
+	int i
+) {
+	if (bplus_own(self, &p->child[i])->count > BP_MIN)
+		return i;
+	if (i > 0 && p->child[i - 1]->count > BP_MIN) {
+		bplus_own(self, &p->child[i - 1]);
+		bplus_borrow_left(p, i);
+		return i;
 	}
-	return did;
+	if (i < p->h.count && p->child[i + 1]->count > BP_MIN) {
+		bplus_own(self, &p->child[i + 1]);
+		bplus_borrow_right(p, i);
+		return i;
+	}
+	if (i < p->h.count) {
+		bplus_own(self, &p->child[i + 1]);
+		bplus_merge(self, p, i);
+		return i;
+	}
+	bplus_own(self, &p->child[i - 1]);
+	bplus_merge(self, p, i - 1);
+	return i - 1;
 }
 
 /*
- * delete a node from the tree.
- *
- * most deletes are deferred. rather than juggle pointers we'll drop the
- * deleted Nodes during a rebalance.
+ * remove a key. returns false if it isn't held. a root left with no
+ * keys gives way to its only child, or to nothing if it was a leaf.
  */
 
+static
 bool
-btree_delete(one_tree *self, void *key) {
-	one_node *n = btree_get_Node_or_NULL(self, key);
-	if (n && n->deleted) {
-		fprintf(stderr, "WARNING delete: key not found in tree.\n");
+bplus_delete(
+	one_bplus *self,
+	void *key
+) {
+	if (!bplus_exists(self, key))
 		return false;
-	}
 
-	/* if it's a terminal Node that isn't root, really delete it. */
+	bp_node *n = bplus_own(self, &self->root);
+	while (!n->leaf) {
+		bp_inner *in = (bp_inner *)n;
+		int i = bplus_fill_child(self, in, bplus_upper(self, n, key));
+		n = in->child[i];
+	}
 
-	if (!n->left && !n->right) {
-		FPRINTF_INFO fprintf(stderr, "INFO deleting leaf: %p\n", (void *)n->key);
-		if (n->parent && n->parent->left == n) n->parent->left = NULL;
-		if (n->parent && n->parent->right == n) n->parent->right = NULL;
-		if (n->parent == NULL && self->root == n)
+	bp_leaf *l = (bp_leaf *)n;
+	int i = bplus_lower(self, n, key);
+	memmove(n->key + i, n->key + i + 1, (n->count - i - 1) * sizeof(void *));
+	memmove(l->value + i, l->value + i + 1, (n->count - i - 1) * sizeof(void *));
+	n->count -= 1;
+	self->entries -= 1;
+
+	bp_node *r = self->root;
+	if (r->count == 0) {
+		if (r->leaf) {
+			pool_give(&self->arena->leaves, r, sizeof(bp_leaf));
 			self->root = NULL;
-		n->parent = NULL;
-		btree_node_free(self, n);
-		self->deletes += 1;
-		self->nodes -= 1;
-		return true;
-	};
+		} else {
+			self->root = ((bp_inner *)r)->child[0];
+			pool_give(&self->arena->inners, r, sizeof(bp_inner));
+		}
+		self->height -= 1;
+	}
+	return true;
+}
 
-	/* flag the Node as deleted, it will be removed during rebalancing. */
+/*
+ * drop every node of this version. returns the number of keys that
+ * were held. with no snapshots sharing the arena the pools are simply
+ * emptied.
+ */
 
-	FPRINTF_INFO fprintf(stderr, "INFO marking deleted non-leaf: %p\n",
-		(void *)n->key);
+static
+int
+bplus_purge(
+	one_bplus *self
+) {
+	int i = self->entries;
+	if (self->arena->versions == 1) {
+		pool_release(&self->arena->leaves, sizeof(bp_leaf));
+		pool_release(&self->arena->inners, sizeof(bp_inner));
+	} else
+		bplus_release(self, self->root);
+	self->root = NULL;
+	self->entries = 0;
+	self->height = 0;
+	return i;
+}
 
-	n->deleted = true;
-	n->value = NULL;
-	self->marked_deleted += 1;
-	self->deletes += 1;
-	self->nodes -= 1;
+/*
+ * let go of this version, and the arena if it was the last.
+ */
 
-	/* as an experiment, i tried to rebalance on every delete, but only under
-	 * node's parent. this leads to a read of a freed node. it's not worth
-	 * chasing down at this time.*/
+static
+void
+bplus_free(
+	one_bplus *self
+) {
+	bplus_purge(self);
+	self->arena->versions -= 1;
+	if (self->arena->versions == 0) {
+		memset(self->arena, 253, sizeof(*self->arena));
+		tsfree(self->arena);
+	}
+	memset(self, 253, sizeof(*self));
+}
 
-	if (btree_should_full_rebalance(self))
-		btree_rebalance(self);
+/*
+ * a new version sharing every node with this one.
+ */
 
-	return true;
+static
+void
+bplus_snapshot(
+	one_bplus *self,
+	one_bplus *copy
+) {
+	*copy = *self;
+	if (self->root)
+		self->root->refs += 1;
+	self->arena->versions += 1;
 }
 
 /*
- * get and return the value associated with a key
- *
- * while the code reads as if key and value are pointers, that is
- * not strictly enforced. any value that will fit into a pointer
- * sized space is legal.
- *
- * if the key is not found or deleted, a NULL is returned, but a
- * NULL could be a valid value in the client's schema. if this
- * is true, exists() should be used before get() if the client
- * cares that a given key did not exist.
+ * keys or values in key order, appended to an alist.
  */
 
-void *
-btree_get(one_tree *self, void *key) {
-	one_node *n = btree_get_Node_or_NULL(self, key);
-	if (!n || n->deleted) return NULL;
-	return n->value;
+static
+one_block *
+bplus_collector_r(
+	bp_node *n,
+	bool want_keys,
+	one_block *xs
+) {
+	if (!n)
+		return xs;
+	if (n->leaf) {
+		bp_leaf *l = (bp_leaf *)n;
+		for (int i = 0; i < n->count; i++)
+			xs = cons(xs, (uintptr_t)(want_keys ? n->key[i] : l->value[i]));
+		return xs;
+	}
+	for (int i = 0; i <= n->count; i++)
+		xs = bplus_collector_r(((bp_inner *)n)->child[i], want_keys, xs);
+	return xs;
 }
 
 /*
- * update the value associated with a key
- *
- * if value is a pointer, this isn't strictly needed.
+ * put the cursor on the first key at or above, or strictly above, the
+ * key. cur->at is left NULL if there is no such key.
  */
 
-bool
-btree_update(one_tree *self, void *key, void *value) {
-	one_node *n = btree_get_Node_or_NULL(self, key);
-	if (n == NULL) return false;
-	n->value = value;
-	self->updates += 1;
-	return true;
+static
+void
+bplus_lower_bound(
+	one_bplus *self,
+	void *key,
+	bool strict,
+	one_cursor *cur
+) {
+	bp_leaf *l = bplus_down(self, key, false, cur);
+	if (!l)
+		return;
+	int i = strict ? bplus_upper(self, &l->h, key) : bplus_lower(self, &l->h, key);
+	if (i == l->h.count) {
+		l = bplus_step(self, cur, l);
+		i = 0;
+	}
+	cur->at = l;
+	cur->index = i;
 }
 
 /*
- * predicates and queries on the Tree or its contents
+ * the greatest key at or below the key, or NULL if there isn't one.
+ * on the way down remember the nearest subtree to the left, its last
+ * key is the answer if the leaf has nothing at or below the key.
+ */
+
+static
+void *
+bplus_floor(
+	one_bplus *self,
+	void *key
+) {
+	bp_node *before = NULL;
+	bp_node *n = self->root;
+	if (!n)
+		return NULL;
+	while (!n->leaf) {
+		int i = bplus_upper(self, n, key);
+		if (i > 0)
+			before = ((bp_inner *)n)->child[i - 1];
+		n = ((bp_inner *)n)->child[i];
+	}
+	int i = bplus_upper(self, n, key) - 1;
+	if (i >= 0)
+		return n->key[i];
+	bp_leaf *l = bplus_last_leaf(before);
+	return l ? l->h.key[l->h.count - 1] : NULL;
+}
+
+/*
+ * call the client for each key in [lo, hi], or all of them when
+ * everything is true. each subtree is entered at the child that
+ * could hold lo, and the walk stops at the first key past hi or
+ * when the callback returns false.
  */
 
+static
 bool
-btree_is_empty(one_tree *self) {
-	return self->nodes == 0;
+bplus_walk_r(
+	one_bplus *self,
+	bp_node *n,
+	void *lo,
+	void *hi,
+	bool everything,
+	void *context,
+	fn_traversal_cb fn,
+	int *called
+) {
+	if (n->leaf) {
+		bp_leaf *l = (bp_leaf *)n;
+		for (int i = everything ? 0 : bplus_lower(self, n, lo); i < n->count; i++) {
+			if (!everything && bplus_cmp(self, n->key[i], hi) > 0)
+				return false;
+			*called += 1;
+			if (!fn(n->key[i], l->value[i], context, NULL))
+				return false;
+		}
+		return true;
+	}
+	bp_inner *in = (bp_inner *)n;
+	for (int i = everything ? 0 : bplus_upper(self, n, lo); i <= n->count; i++)
+		if (!bplus_walk_r(self, in->child[i], lo, hi, everything, context, fn, called))
+			return false;
+	return true;
 }
 
+static
 int
-btree_count(one_tree* self) {
-	return self->nodes;
+bplus_walk(
+	one_bplus *self,
+	void *lo,
+	void *hi,
+	bool everything,
+	void *context,
+	fn_traversal_cb fn
+) {
+	int called = 0;
+	if (self->root)
+		bplus_walk_r(self, self->root, lo, hi, everything, context, fn, &called);
+	return called;
 }
 
-bool
-btree_exists(one_tree *self, void *key) {
-	one_node *n = btree_get_Node_or_NULL(self, key);
-	if (!n || n->deleted) return NULL;
-	return n;
-}
-
 /*
- * the priority queue (pqueue) is a non-uniquely keyed doubly
- * linked list. many of the functions look redundant with their
- * doubly counterparts, but i prefer duplication to a bunch of
- * special case if/else blocks.
+ * build the tree bottom up from keys known to be in order. the keys
+ * are spread evenly over as few leaves as will hold them, and then
+ * the nodes of each level over as few parents as will hold them.
+ * spreading evenly keeps every node at least half full.
+ *
+ * low[] holds the least key under each node of the level being
+ * grouped, which becomes its routing key in the parent.
  */
 
 static
-int
-pq_count(
-	one_block *pq
+void
+bplus_load(
+	one_bplus *self,
+	void **keys,
+	void **values,
+	int n
 ) {
-	int i = 0;
-	pq_item *qi = pq->u.pqu.first;
-	while (qi) {
-		i += 1;
-		qi = qi->next;
+	if (n == 0)
+		return;
+	int count = (n + ONE_BPLUS_KEYS - 1) / ONE_BPLUS_KEYS;
+	bp_node **level = tsmalloc(count * sizeof(bp_node *));
+	void **low = tsmalloc(count * sizeof(void *));
+
+	int k = 0;
+	for (int i = 0; i < count; i++) {
+		bp_leaf *l = bplus_make_leaf(self);
+		int take = (n - k) / (count - i);
+		memcpy(l->h.key, keys + k, take * sizeof(void *));
+		memcpy(l->value, values + k, take * sizeof(void *));
+		l->h.count = take;
+		level[i] = &l->h;
+		low[i] = keys[k];
+		k += take;
 	}
-	return i;
+	self->height = 1;
+
+	while (count > 1) {
+		int parents = (count + ONE_BPLUS_KEYS) / (ONE_BPLUS_KEYS + 1);
+		int c = 0;
+		for (int i = 0; i < parents; i++) {
+			bp_inner *p = bplus_make_inner(self);
+			int take = (count - c) / (parents - i);
+			for (int j = 0; j < take; j++) {
+				p->child[j] = level[c + j];
+				if (j > 0)
+					p->h.key[j - 1] = low[c + j];
+			}
+			p->h.count = take - 1;
+			level[i] = &p->h;
+			low[i] = low[c];
+			c += take;
+		}
+		count = parents;
+		self->height += 1;
+	}
+
+	self->root = level[0];
+	self->entries = n;
+	tsfree(low);
+	tsfree(level);
 }
 
+/*
+ * the locks of a concurrent keyval. each does nothing if the store
+ * wasn't made concurrent.
+ *
+ * a reader waits for any writer to finish and then counts itself
+ * in. a writer announces itself first, so that no new readers come
+ * in, and then waits to swap an empty reader count for -1. writers
+ * get in one at a time through the same swap.
+ *
+ * nothing is reentrant. a reader that asks for the lock again waits
+ * behind any writer that is waiting for it to leave.
+ */
+
 static
-pq_item *
-pq_create_item(
-	long priority,
-	void * payload
-) {
-	pq_item *qi = tmalloc(sizeof(*qi));
-	memset(qi, 0, sizeof(*qi));
-	qi->priority = priority;
-	qi->item = payload;
-	qi->next = NULL;
-	qi->previous = NULL;
-	return qi;
+void
+kv_lock_shared(one_block *ob) {
+	one_rwlock *lock = ob->lock;
+	if (!lock)
+		return;
+	for (;;) {
+		if (atomic_load(&lock->writers) == 0) {
+			int n = atomic_load(&lock->readers);
+			if (n >= 0 && atomic_compare_exchange_weak(&lock->readers, &n, n + 1))
+				return;
+		}
+		sched_yield();
+	}
 }
 
 static
-int
-pq_purge(
-	one_block *pq
-) {
-	int i = 0;
-	pq_item *qi = NULL;
-	while (qi = pq->u.pqu.first, qi) {
-		i += 1;
-		pq->u.pqu.first = qi->next;
-		memset(qi, 253, sizeof(*qi));
-		tfree(qi);
+void
+kv_unlock_shared(one_block *ob) {
+	if (ob->lock)
+		atomic_fetch_sub(&ob->lock->readers, 1);
+}
+
+static
+void
+kv_lock(one_block *ob) {
+	one_rwlock *lock = ob->lock;
+	if (!lock)
+		return;
+	atomic_fetch_add(&lock->writers, 1);
+	for (;;) {
+		int n = 0;
+		if (atomic_compare_exchange_weak(&lock->readers, &n, -1))
+			return;
+		sched_yield();
 	}
-	return i;
 }
-
+
+static
+void
+kv_unlock(one_block *ob) {
+	if (!ob->lock)
+		return;
+	atomic_store(&ob->lock->readers, 0);
+	atomic_fetch_sub(&ob->lock->writers, 1);
+}
+
+/*
+ * is a keyval empty? the caller holds the lock.
+ */
+
+static
+bool
+kv_empty(one_block *ob) {
+	if (ob->backing == bk_hash)
+		return ob->u.hsh.entries == 0;
+	if (ob->backing == bk_bplus)
+		return ob->u.bpt.root == NULL;
+	return ob->u.kvl.root == NULL;
+}
+
 /*
  * the unified or generic api.
  *
@@ -1567,32 +4486,124 @@ pq_purge(
 one_block *
 make_one(
 	one_type isa
+) {
+	return make_one_backed(isa, bk_default);
+}
+
+/*
+ * make_one_backed
+ *
+ * as make_one, but the client can pick an alternate backing for those
+ * types that have one. asking for bk_default is the same as calling
+ * make_one.
+ *
+ * returns the instance handle or NULL on error.
+ */
+
+one_block *
+make_one_backed(
+	one_type isa,
+	one_backing backing
 ) {
 	one_block *ob = tsmalloc(sizeof(*ob));
 	memset(ob, 0, sizeof(*ob));
 	ob->isa = isa;
+	ob->backing = backing;
 	if (isa <= ONE_TYPE_MAX && isa > 0)
 		strncpy(ob->tag, one_tags[isa], ONE_TAG_LEN-1);
 	else
 		strncpy(ob->tag, "*invalid one type*", ONE_TAG_LEN-1);
 
+	/* only some types have a choice. */
+	if (backing != bk_default
+		&& isa != pqueue && isa != stack && isa != queue && isa != deque) {
+		fprintf(stderr,
+			"\nERROR txbone-make_one: backing %d not available for type %d %s\n",
+			backing, isa, ob->tag);
+		memset(ob, 253, sizeof(*ob));
+		tsfree(ob);
+		return NULL;
+	}
+
 	switch (ob->isa) {
+	case stack:
+	case queue:
+	case deque:
+		if (backing == bk_ring) {
+			ob->u.rng.head = 0;
+			ob->u.rng.length = 0;
+			ob->u.rng.capacity = ONE_RING_DEFAULT_CAPACITY;
+			ob->u.rng.slot = tsmalloc(ONE_RING_DEFAULT_CAPACITY * sizeof(void *));
+			memset(ob->u.rng.slot, 0, ONE_RING_DEFAULT_CAPACITY * sizeof(void *));
+			return ob;
+		}
+		if (backing != bk_default && backing != bk_linked) {
+			fprintf(stderr,
+				"\nERROR txbone-make_one: backing %d not available for type %d %s\n",
+				backing, isa, ob->tag);
+			memset(ob, 253, sizeof(*ob));
+			tsfree(ob);
+			return NULL;
+		}
+		ob->backing = bk_linked;
+		if (isa != stack) {
+			ob->u.dbl.first = NULL;
+			ob->u.dbl.last = NULL;
+			ob->u.dbl.length = 0;
+			return ob;
+		}
+		ob->u.sgl.first = NULL;
+		ob->u.sgl.last = NULL;
+		ob->u.sgl.length = 0;
+		return ob;
+
 	case singly:
-	case stack:
 		ob->u.sgl.first = NULL;
+		ob->u.sgl.last = NULL;
+		ob->u.sgl.length = 0;
 		return ob;
 
 	case doubly:
-	case queue:
-	case deque:
 		ob->u.dbl.first = NULL;
 		ob->u.dbl.last = NULL;
+		ob->u.dbl.length = 0;
 		return ob;
 
 	case pqueue:
-		ob->u.pqu.first = NULL;
-		ob->u.pqu.last = NULL;
-		return ob;
+		switch (backing) {
+		case bk_default:
+		case bk_linked:
+			ob->backing = bk_linked;
+			ob->u.pqu.first = NULL;
+			ob->u.pqu.last = NULL;
+			ob->u.pqu.length = 0;
+			return ob;
+		case bk_heap:
+			ob->u.pqh.length = 0;
+			ob->u.pqh.capacity = ONE_PQUEUE_HEAP_DEFAULT_CAPACITY;
+			ob->u.pqh.stamp = 0;
+			ob->u.pqh.heap = tsmalloc(ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(pq_slot));
+			memset(ob->u.pqh.heap, 0, ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(pq_slot));
+			return ob;
+		case bk_dual_heap:
+			ob->u.pqd.length = 0;
+			ob->u.pqd.capacity = ONE_PQUEUE_HEAP_DEFAULT_CAPACITY;
+			ob->u.pqd.stamp = 0;
+			ob->u.pqd.slot = tsmalloc(ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(pq_dslot));
+			memset(ob->u.pqd.slot, 0, ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(pq_dslot));
+			for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+				ob->u.pqd.heap[h] = tsmalloc(ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(int));
+				memset(ob->u.pqd.heap[h], 0, ONE_PQUEUE_HEAP_DEFAULT_CAPACITY * sizeof(int));
+			}
+			return ob;
+		default:
+			fprintf(stderr,
+				"\nERROR txbone-make_one: backing %d not available for type %d %s\n",
+				backing, isa, ob->tag);
+			memset(ob, 253, sizeof(*ob));
+			tsfree(ob);
+			return NULL;
+		}
 
 	case alist:
 		ob->u.acc.used = 0;
@@ -1608,6 +4619,23 @@ make_one(
 		memset(ob->u.dyn.array, 0, ONE_DYNARRAY_DEFAULT_CAPACITY * sizeof(void *));
 		return ob;
 
+	case spsc:
+		spsc_init(&ob->u.spq, ONE_BOUNDED_DEFAULT_CAPACITY);
+		return ob;
+
+	case mpmc:
+		mpmc_init(&ob->u.mpq, ONE_BOUNDED_DEFAULT_CAPACITY);
+		return ob;
+
+	case wsdeque:
+		if (ws_init(&ob->u.wsd))
+			return ob;
+		fprintf(stderr,
+			"\nERROR txbone-make_one: could not allocate %s\n", ob->tag);
+		memset(ob, 253, sizeof(*ob));
+		tsfree(ob);
+		return NULL;
+
 	default:
 		fprintf(stderr,
 			"\nERROR txbone-make_one: unknown or not yet implemented type %d %s\n",
@@ -1618,6 +4646,153 @@ make_one(
 	}
 }
 
+/*
+ * make_one_intrusive
+ *
+ * as make_one, but the links are embedded in the client's items at
+ * offset. the one block is the only allocation.
+ *
+ * returns the instance handle or NULL on error.
+ */
+
+one_block *
+make_one_intrusive(
+	one_type isa,
+	size_t offset
+) {
+	if (isa != singly && isa != doubly && isa != stack
+		&& isa != queue && isa != deque) {
+		fprintf(stderr,
+			"\nERROR txbone-make_one_intrusive: backing %d not available for type %d\n",
+			bk_intrusive, isa);
+		return NULL;
+	}
+	one_block *ob = tsmalloc(sizeof(*ob));
+	memset(ob, 0, sizeof(*ob));
+	ob->isa = isa;
+	ob->backing = bk_intrusive;
+	strncpy(ob->tag, one_tags[isa], ONE_TAG_LEN-1);
+	ob->u.itr.first = NULL;
+	ob->u.itr.last = NULL;
+	ob->u.itr.length = 0;
+	ob->u.itr.offset = offset;
+	return ob;
+}
+
+/*
+ * make_one_bounded
+ *
+ * as make_one, but with the capacity of a bounded queue. it is
+ * rounded up to a power of two so a position can be masked down to
+ * a slot.
+ *
+ * returns the instance handle or NULL on error.
+ */
+
+one_block *
+make_one_bounded(
+	one_type isa,
+	int capacity
+) {
+	if ((isa != spsc && isa != mpmc) || capacity < 1 || capacity > INT_MAX / 2) {
+		fprintf(stderr,
+			"\nERROR txbone-make_one_bounded: invalid type %d or capacity %d\n",
+			isa, capacity);
+		return NULL;
+	}
+	size_t cap = 2;
+	while (cap < (size_t)capacity)
+		cap *= 2;
+	one_block *ob = tsmalloc(sizeof(*ob));
+	memset(ob, 0, sizeof(*ob));
+	ob->isa = isa;
+	strncpy(ob->tag, one_tags[isa], ONE_TAG_LEN-1);
+	if (isa == spsc)
+		spsc_init(&ob->u.spq, cap);
+	else
+		mpmc_init(&ob->u.mpq, cap);
+	return ob;
+}
+
+/*
+ * make_one_prioritized
+ *
+ * create a pqueue and load it from an array of pairs in one pass.
+ * the pairs are stamped in array order, so the result matches n
+ * calls to add_with_priority.
+ *
+ * the heap backings are sized up front and heapified, O(n). the
+ * linked list is sorted and linked, O(n log n).
+ *
+ * returns the instance handle or NULL on error.
+ */
+
+one_block *
+make_one_prioritized(
+	one_type isa,
+	one_backing backing,
+	const pq_pair *pairs,
+	int n
+) {
+	if (isa != pqueue || n < 0 || (n > 0 && !pairs)) {
+		fprintf(stderr,
+			"\nERROR txbone-make_one_prioritized: invalid type %d or pairs %p/%d\n",
+			isa, (void *)pairs, n);
+		return NULL;
+	}
+	one_block *ob = make_one_backed(isa, backing);
+	if (!ob || n == 0)
+		return ob;
+
+	/* size the heaps to hold all the pairs, doubling as usual */
+	int cap = ONE_PQUEUE_HEAP_DEFAULT_CAPACITY;
+	while (cap < n)
+		cap *= 2;
+
+	switch (ob->backing) {
+
+	case bk_heap:
+		if (cap > ob->u.pqh.capacity) {
+			tsfree(ob->u.pqh.heap);
+			ob->u.pqh.heap = tsmalloc(cap * sizeof(pq_slot));
+			ob->u.pqh.capacity = cap;
+		}
+		for (int i = 0; i < n; i++) {
+			ob->u.pqh.heap[i].priority = pairs[i].priority;
+			ob->u.pqh.heap[i].stamp = i;
+			ob->u.pqh.heap[i].item = pairs[i].item;
+		}
+		ob->u.pqh.length = n;
+		ob->u.pqh.stamp = n;
+		pqh_heapify(&ob->u.pqh);
+		return ob;
+
+	case bk_dual_heap:
+		if (cap > ob->u.pqd.capacity) {
+			tsfree(ob->u.pqd.slot);
+			ob->u.pqd.slot = tsmalloc(cap * sizeof(pq_dslot));
+			for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+				tsfree(ob->u.pqd.heap[h]);
+				ob->u.pqd.heap[h] = tsmalloc(cap * sizeof(int));
+			}
+			ob->u.pqd.capacity = cap;
+		}
+		for (int i = 0; i < n; i++) {
+			ob->u.pqd.slot[i].s.priority = pairs[i].priority;
+			ob->u.pqd.slot[i].s.stamp = i;
+			ob->u.pqd.slot[i].s.item = pairs[i].item;
+		}
+		ob->u.pqd.length = n;
+		ob->u.pqd.stamp = n;
+		pqd_heapify(&ob->u.pqd);
+		return ob;
+
+	default:
+		pq_load(ob, pairs, n);
+		return ob;
+	}
+}
+
 /*
  * create a new empty keyed instance. this will usually be a backed by
  * a binary search tree, but it may present an different api.
@@ -1633,10 +4808,95 @@ make_one_keyed(
 	one_type isa,
 	one_key_type kt,
 	one_key_comparator func_or_NULL
+) {
+	return make_one_keyed_backed(isa, bk_default, kt, func_or_NULL, NULL);
+}
+
+/*
+ * as make_one_keyed, but with the client's balancing policy for the
+ * tree.
+ */
+
+one_block *
+make_one_keyed_policy(
+	one_type isa,
+	one_key_type kt,
+	one_key_comparator func_or_NULL,
+	const one_policy *policy
+) {
+	if (policy && !(policy->alpha > 1.0)) {
+		fprintf(stderr, "\nERROR txbone-make_one_keyed_policy: alpha must be above 1.0, got %g\n",
+			policy->alpha);
+		return NULL;
+	}
+	one_block *ob = make_one_keyed_backed(isa, bk_tree, kt, func_or_NULL, NULL);
+	if (ob && policy)
+		ob->u.kvl.policy = *policy;
+	return ob;
+}
+
+/*
+ * as make_one_keyed_backed, with a lock so threads can share the
+ * store.
+ */
+
+one_block *
+make_one_concurrent(
+	one_type isa,
+	one_backing backing,
+	one_key_type kt,
+	one_key_comparator func_or_NULL,
+	one_key_hasher hash_or_NULL
+) {
+	if (isa != keyval) {
+		fprintf(stderr, "\nERROR txbone-make_one_concurrent: unknown or unsupported type %d\n",
+			isa);
+		return NULL;
+	}
+	one_block *ob = make_one_keyed_backed(isa, backing, kt, func_or_NULL, hash_or_NULL);
+	if (!ob)
+		return NULL;
+	ob->lock = tsmalloc(sizeof(one_rwlock));
+	atomic_init(&ob->lock->readers, 0);
+	atomic_init(&ob->lock->writers, 0);
+	atomic_init(&ob->lock->users, 1);
+	return ob;
+}
+
+/*
+ * the policy from the compile time settings.
+ */
+
+one_policy
+default_policy(void) {
+	one_policy p = {
+		.alpha = ONE_REBALANCE_ALPHA,
+		.delete_percent = ONE_REBALANCE_DELETE_PERCENT,
+		.minimum = ONE_REBALANCE_MINIMUM,
+		.sweep_budget = ONE_TOMBSTONE_SWEEP,
+		.rebalance_allowed = true
+	};
+	return p;
+}
+
+/*
+ * as make_one_keyed, but the client can pick the backing. the hash
+ * function is only meaningful for bk_hash, and like the comparator is
+ * only required for custom keys.
+ */
+
+one_block *
+make_one_keyed_backed(
+	one_type isa,
+	one_backing backing,
+	one_key_type kt,
+	one_key_comparator func_or_NULL,
+	one_key_hasher hash_or_NULL
 ) {
 	one_block *ob = tsmalloc(sizeof(*ob));
 	memset(ob, 0, sizeof(*ob));
 	ob->isa = isa;
+	ob->backing = backing == bk_default ? bk_tree : backing;
 	if (isa <= ONE_TYPE_MAX && isa > 0)
 		strncpy(ob->tag, one_tags[isa], ONE_TAG_LEN-1);
 	else
@@ -1644,44 +4904,81 @@ make_one_keyed(
 
 	switch (ob->isa) {
 	case keyval:
+		break;
 
-		ob->u.kvl.fn_cmp = func_or_NULL;
-		ob->u.kvl.root = NULL;
-		ob->u.kvl.rebalance_allowed = true;
-		ob->u.kvl.kt = kt;
-		switch (kt) {
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-make_one: unknown or not yet implemented type %d %s\n",
+			isa, ob->tag);
+		memset(ob, 253, sizeof(*ob));
+		tsfree(ob);
+		return NULL;
+	}
 
-		case integral:     /* treat the key as a void * sized integer, a long */
-			ob->u.kvl.fn_cmp = (one_key_comparator)integral_comp;
-			if (func_or_NULL)
-				fprintf(stderr,
-					"WARNING make_Tree: client provided comparator function for integral keys ignored.\n");
+	one_key_comparator fn_cmp = NULL;
+	one_key_hasher fn_hash = NULL;
+	switch (kt) {
+
+	case integral:     /* treat the key as a void * sized integer, a long */
+		fn_cmp = (one_key_comparator)integral_comp;
+		fn_hash = hash_integral;
+		if (func_or_NULL || hash_or_NULL)
+			fprintf(stderr,
+				"WARNING make_Tree: client provided functions for integral keys ignored.\n");
+		break;
+
+	case string:      /* strings are standard char * bytestrings */
+		fn_cmp = (one_key_comparator)strcmp;
+		fn_hash = hash_string;
+		if (func_or_NULL || hash_or_NULL)
+			fprintf(stderr,
+				"WARNING make_Tree: client provided functions for string keys ignored.\n");
+		break;
+
+	case custom:    /* client provides comparator, and hash if needed */
+		fn_cmp = func_or_NULL;
+		fn_hash = hash_or_NULL;
+		if (fn_cmp && (fn_hash || ob->backing != bk_hash))
 			break;
+		fprintf(stderr, "ERROR make_Tree: missing comparator or hash function.\n");
 
-		case string:      /* strings are standard char * bytestrings */
-			ob->u.kvl.fn_cmp = (one_key_comparator)strcmp;
-			if (func_or_NULL)
-				fprintf(stderr,
-					"WARNING make_Tree: client provided comparator function for string keys ignored.\n");
-			break;
+	default:
+		fprintf(stderr, "ERROR make_Tree: error in key type or function\n");
+		memset(ob, 253, sizeof(*ob));
+		tsfree(ob);
+		return NULL;
+	}
 
-		case custom:    /* client provides comparator */
-			ob->u.kvl.fn_cmp = func_or_NULL;
-			if (ob->u.kvl.fn_cmp)
-				break;
-			fprintf(stderr, "ERROR make_Tree: missing comparator function.\n");
+	switch (ob->backing) {
+	case bk_tree:
+		ob->u.kvl.fn_cmp = fn_cmp;
+		ob->u.kvl.root = NULL;
+		ob->u.kvl.policy = default_policy();
+		ob->u.kvl.kt = kt;
+		return ob;
 
-		default:
-			fprintf(stderr, "ERROR make_Tree: error in key type or function\n");
-			tsfree(ob);
-			ob = NULL;
-		}
+	case bk_hash:
+		ob->u.hsh.fn_cmp = fn_cmp;
+		ob->u.hsh.fn_hash = fn_hash;
+		ob->u.hsh.kt = kt;
+		ob->u.hsh.capacity = ONE_HASH_DEFAULT_CAPACITY;
+		ob->u.hsh.entries = 0;
+		ob->u.hsh.table = tsmalloc(ob->u.hsh.capacity * sizeof(hash_entry));
+		memset(ob->u.hsh.table, 0, ob->u.hsh.capacity * sizeof(hash_entry));
+		return ob;
+
+	case bk_bplus:
+		ob->u.bpt.fn_cmp = fn_cmp;
+		ob->u.bpt.kt = kt;
+		ob->u.bpt.arena = tsmalloc(sizeof(bp_arena));
+		memset(ob->u.bpt.arena, 0, sizeof(bp_arena));
+		ob->u.bpt.arena->versions = 1;
 		return ob;
 
 	default:
 		fprintf(stderr,
-			"\nERROR txbone-make_one: unknown or not yet implemented type %d %s\n",
-			isa, ob->tag);
+			"\nERROR txbone-make_one: backing %d not available for type %d %s\n",
+			backing, isa, ob->tag);
 		memset(ob, 253, sizeof(*ob));
 		tsfree(ob);
 		return NULL;
@@ -1698,9 +4995,12 @@ one_block *
 clone(
 	one_block *ob
 ) {
+	if (ob->isa == keyval && ob->backing == bk_bplus)
+		return snapshot(ob);
 	if (ob->isa != alist) {
 		fprintf(stderr, "\nERROR txbone-clone: unknown or unsupported type %d %s\n",
 			ob->isa, ob->tag);
+		return NULL;
 	}
 	return alist_clone(ob);
 }
@@ -1721,18 +5021,55 @@ purge(one_block *ob) {
 
 	case singly:
 	case stack:
+		if (ob->backing == bk_ring)
+			return ring_purge(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_purge(&ob->u.itr);
 		return singly_purge(&ob->u.sgl);
 
 	case doubly:
 	case queue:
 	case deque:
+		if (ob->backing == bk_ring)
+			return ring_purge(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_purge(&ob->u.itr);
 		return doubly_purge(&ob->u.dbl);
 
 	case alist:
 		return alist_purge(ob);
 
+	case spsc:
+		return spsc_purge(&ob->u.spq);
+
+	case mpmc:
+		return mpmc_purge(&ob->u.mpq);
+
+	case wsdeque:
+		return ws_purge(&ob->u.wsd);
+
+	case keyval:
+		if (ob->backing == bk_hash || ob->backing == bk_bplus) {
+			kv_lock(ob);
+			int n = ob->backing == bk_hash
+				? hash_purge(&ob->u.hsh)
+				: bplus_purge(&ob->u.bpt);
+			kv_unlock(ob);
+			return n;
+		}
+		fprintf(stderr, "\nERROR txbone-purge: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return -1;
+
 	case pqueue:
-		return pq_purge(ob);
+		switch (ob->backing) {
+		case bk_heap:
+			return pqh_purge(&ob->u.pqh);
+		case bk_dual_heap:
+			return pqd_purge(&ob->u.pqd);
+		default:
+			return pq_purge(ob);
+		}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-purge: unknown or unsupported type %d %s\n",
@@ -1761,7 +5098,11 @@ free_one(one_block *ob) {
 		case doubly:
 		case queue:
 		case deque:
-			purge(ob);
+			if (ob->backing == bk_ring) {
+				memset(ob->u.rng.slot, 253, ob->u.rng.capacity * sizeof(void *));
+				tsfree(ob->u.rng.slot);
+			} else
+				purge(ob);
 			memset(ob, 253, sizeof(*ob));
 			tsfree(ob);
 			return NULL;
@@ -1780,14 +5121,68 @@ free_one(one_block *ob) {
 			tsfree(ob);
 			return NULL;
 
-		case keyval:
+		case spsc:
+			memset(ob->u.spq.slot, 253, (ob->u.spq.mask + 1) * sizeof(void *));
+			tsfree(ob->u.spq.slot);
+			tsfree(ob->u.spq.ends);
+			memset(ob, 253, sizeof(*ob));
+			tsfree(ob);
+			return NULL;
+
+		case mpmc:
+			memset(ob->u.mpq.cell, 253, (ob->u.mpq.mask + 1) * sizeof(mpmc_cell));
+			tsfree(ob->u.mpq.cell);
+			tsfree(ob->u.mpq.ends);
+			memset(ob, 253, sizeof(*ob));
+			tsfree(ob);
+			return NULL;
+
+		case wsdeque:
+			ws_free(&ob->u.wsd);
+			memset(ob, 253, sizeof(*ob));
+			tsfree(ob);
+			return NULL;
+
+		case keyval: {
 			// TODO: fix to use purge as for others ...
-			btree_free(&ob->u.kvl);
+			/* the lock is only needed by a B+ tree with snapshots
+			 * still out, which share its nodes */
+			one_rwlock *lock = ob->lock;
+			kv_lock(ob);
+			if (ob->backing == bk_hash) {
+				memset(ob->u.hsh.table, 253, ob->u.hsh.capacity * sizeof(hash_entry));
+				tsfree(ob->u.hsh.table);
+			} else if (ob->backing == bk_bplus)
+				bplus_free(&ob->u.bpt);
+			else
+				btree_free(&ob->u.kvl);
+			kv_unlock(ob);
+			if (lock && atomic_fetch_sub(&lock->users, 1) == 1) {
+				memset(lock, 253, sizeof(*lock));
+				tsfree(lock);
+			}
 			memset(ob, 253, sizeof(*ob));
 			tsfree(ob);
 			return NULL;
+		}
 
 		case pqueue:
+			switch (ob->backing) {
+			case bk_heap:
+				memset(ob->u.pqh.heap, 253, ob->u.pqh.capacity * sizeof(pq_slot));
+				tsfree(ob->u.pqh.heap);
+				break;
+			case bk_dual_heap:
+				memset(ob->u.pqd.slot, 253, ob->u.pqd.capacity * sizeof(pq_dslot));
+				tsfree(ob->u.pqd.slot);
+				for (int h = PQD_MAX; h <= PQD_MIN; h++) {
+					memset(ob->u.pqd.heap[h], 253, ob->u.pqd.capacity * sizeof(int));
+					tsfree(ob->u.pqd.heap[h]);
+				}
+				break;
+			default:
+				pq_purge(ob);
+			}
 			memset(ob, 253, sizeof(*ob));
 			tsfree(ob);
 			return NULL;
@@ -1824,11 +5219,17 @@ add_first(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case singly:
-		singly_add_first(&ob->u.sgl, item);
+		if (ob->backing == bk_intrusive)
+			intrusive_add_first(&ob->u.itr, item);
+		else
+			singly_add_first(&ob->u.sgl, item);
 		return ob;
 
 	case doubly:
-		doubly_add_first(&ob->u.dbl, item);
+		if (ob->backing == bk_intrusive)
+			intrusive_add_first(&ob->u.itr, item);
+		else
+			doubly_add_first(&ob->u.dbl, item);
 		return ob;
 
 	default:
@@ -1854,11 +5255,17 @@ add_last(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case singly:
-		singly_add_last(&ob->u.sgl, item);
+		if (ob->backing == bk_intrusive)
+			intrusive_add_last(&ob->u.itr, item);
+		else
+			singly_add_last(&ob->u.sgl, item);
 		return ob;
 
 	case doubly:
-		doubly_add_last(&ob->u.dbl, item);
+		if (ob->backing == bk_intrusive)
+			intrusive_add_last(&ob->u.itr, item);
+		else
+			doubly_add_last(&ob->u.dbl, item);
 		return ob;
 
 	default:
@@ -1882,9 +5289,13 @@ peek_first(one_block *ob) {
 	switch (ob->isa) {
 
 	case singly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_first(&ob->u.itr);
 		return singly_peek_first(&ob->u.sgl);
 
 	case doubly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_first(&ob->u.itr);
 		return doubly_peek_first(&ob->u.dbl);
 
 	default:
@@ -1909,9 +5320,13 @@ peek_last(one_block *ob) {
 	switch (ob->isa) {
 
 	case singly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_last(&ob->u.itr);
 		return singly_peek_last(&ob->u.sgl);
 
 	case doubly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_last(&ob->u.itr);
 		return doubly_peek_last(&ob->u.dbl);
 
 	default:
@@ -1935,9 +5350,13 @@ get_first(one_block *ob) {
 	switch (ob->isa) {
 
 	case singly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_first(&ob->u.itr);
 		return singly_get_first(&ob->u.sgl);
 
 	case doubly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_first(&ob->u.itr);
 		return doubly_get_first(&ob->u.dbl);
 
 	default:
@@ -1961,9 +5380,13 @@ get_last(one_block *ob) {
 	switch (ob->isa) {
 
 	case singly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_last(&ob->u.itr);
 		return singly_get_last(&ob->u.sgl);
 
 	case doubly:
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_last(&ob->u.itr);
 		return doubly_get_last(&ob->u.dbl);
 
 	default:
@@ -1972,6 +5395,56 @@ get_last(one_block *ob) {
 		return NULL;
 	}
 }
+
+/*
+ * splice -- singly, doubly
+ *
+ * move the items of other onto the end of ob. ob takes other's pool
+ * since the nodes were carved from it.
+ *
+ * returns ob or NULL on error.
+ */
+
+one_block *
+splice(one_block *ob, one_block *other) {
+
+	if (ob == other) {
+		fprintf(stderr, "\nERROR txbone-splice: can't splice a list onto itself %s\n",
+			ob->tag);
+		return NULL;
+	}
+	if (ob->isa != other->isa) {
+		fprintf(stderr, "\nERROR txbone-splice: can't splice type %d %s onto type %d %s\n",
+			other->isa, other->tag, ob->isa, ob->tag);
+		return NULL;
+	}
+	if ((ob->backing == bk_intrusive || other->backing == bk_intrusive)
+		&& (ob->backing != other->backing || ob->u.itr.offset != other->u.itr.offset)) {
+		fprintf(stderr, "\nERROR txbone-splice: links don't match, can't splice onto %s\n",
+			ob->tag);
+		return NULL;
+	}
+	if (ob->backing == bk_intrusive) {
+		intrusive_splice(&ob->u.itr, &other->u.itr);
+		return ob;
+	}
+
+	switch (ob->isa) {
+
+	case singly:
+		singly_splice(&ob->u.sgl, &other->u.sgl);
+		return ob;
+
+	case doubly:
+		doubly_splice(&ob->u.dbl, &other->u.dbl);
+		return ob;
+
+	default:
+		fprintf(stderr, "\nERROR txbone-splice: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+}
 
 /*
  * functions common to all (most) structures, for information
@@ -1993,21 +5466,47 @@ count(one_block *ob) {
 	switch (ob->isa) {
 
 	case singly:
+		if (ob->backing == bk_intrusive)
+			return ob->u.itr.length;
 		return singly_count(&ob->u.sgl);
 
 	case doubly:
 	case queue:
 	case deque:
+		if (ob->backing == bk_ring)
+			return ob->u.rng.length;
+		if (ob->backing == bk_intrusive)
+			return ob->u.itr.length;
 		return doubly_count(&ob->u.dbl);
 
 	case alist:
 		return ob->u.acc.used;
 
-	case keyval:
-		return ob->u.kvl.nodes;
+	case spsc:
+	case mpmc:
+		return bq_count(ob);
+
+	case wsdeque:
+		return ws_count(&ob->u.wsd);
+
+	case keyval: {
+		kv_lock_shared(ob);
+		int n = ob->backing == bk_hash ? ob->u.hsh.entries
+			: ob->backing == bk_bplus ? ob->u.bpt.entries
+			: ob->u.kvl.nodes;
+		kv_unlock_shared(ob);
+		return n;
+	}
 
 	case pqueue:
-		return pq_count(ob);
+		switch (ob->backing) {
+		case bk_heap:
+			return ob->u.pqh.length;
+		case bk_dual_heap:
+			return ob->u.pqd.length;
+		default:
+			return pq_count(ob);
+		}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-count: unknown or unsupported type %d %s\n",
@@ -2031,21 +5530,47 @@ is_empty(one_block *ob) {
 
 	case singly:
 	case stack:
-		return ob->u.sgl.first == NULL;
+		if (ob->backing == bk_ring)
+			return ob->u.rng.length == 0;
+		if (ob->backing == bk_intrusive)
+			return ob->u.itr.length == 0;
+		return ob->u.sgl.length == 0;
 
 	case doubly:
 	case queue:
 	case deque:
-		return ob->u.dbl.first == NULL;
+		if (ob->backing == bk_ring)
+			return ob->u.rng.length == 0;
+		if (ob->backing == bk_intrusive)
+			return ob->u.itr.length == 0;
+		return ob->u.dbl.length == 0;
 
 	case alist:
 		return ob->u.acc.used == 0;
 
-	case keyval:
-		return ob->u.kvl.root == NULL;
+	case spsc:
+	case mpmc:
+		return bq_count(ob) == 0;
+
+	case wsdeque:
+		return ws_count(&ob->u.wsd) == 0;
+
+	case keyval: {
+		kv_lock_shared(ob);
+		bool empty = kv_empty(ob);
+		kv_unlock_shared(ob);
+		return empty;
+	}
 
 	case pqueue:
-		return ob->u.pqu.first == NULL;
+		switch (ob->backing) {
+		case bk_heap:
+			return ob->u.pqh.length == 0;
+		case bk_dual_heap:
+			return ob->u.pqd.length == 0;
+		default:
+			return ob->u.pqu.length == 0;
+		}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-empty: unknown or unsupported type %d %s\n",
@@ -2072,6 +5597,10 @@ depth(one_block *ob) {
 	switch (ob->isa) {
 
 	case stack:
+		if (ob->backing == bk_ring)
+			return ob->u.rng.length;
+		if (ob->backing == bk_intrusive)
+			return ob->u.itr.length;
 		return singly_count(&ob->u.sgl);
 
 	default:
@@ -2083,7 +5612,7 @@ depth(one_block *ob) {
 }
 
 /*
- * push -- stack
+ * push -- stack, wsdeque
  *
  * add an item to the top of the stack.
  *
@@ -2096,7 +5625,24 @@ push(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case stack:
-		singly_add_first(&ob->u.sgl, item);
+		if (ob->backing == bk_ring)
+			ring_push_back(&ob->u.rng, item);
+		else if (ob->backing == bk_intrusive)
+			intrusive_add_first(&ob->u.itr, item);
+		else
+			singly_add_first(&ob->u.sgl, item);
+		return ob;
+
+	case wsdeque:
+		if (!item) {
+			fprintf(stderr, "\nERROR txbone-push: can't push NULL on %s\n",
+				ob->tag);
+			return NULL;
+		}
+		if (!ws_push(&ob->u.wsd, item)) {
+			fprintf(stderr, "\nERROR txbone-push: could not grow %s\n", ob->tag);
+			return NULL;
+		}
 		return ob;
 
 	default:
@@ -2107,25 +5653,57 @@ push(one_block *ob, void *item) {
 	}
 }
 
-/**
- * pop -- stack
+/**
+ * pop -- stack, wsdeque
+ *
+ * remove an item from the top of the stack.
+ *
+ * returns the item.
+ */
+
+void *
+pop(one_block *ob) {
+
+	switch (ob->isa) {
+
+	case stack:
+		if (ob->backing == bk_ring)
+			return ring_pop_back(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_first(&ob->u.itr);
+		return singly_get_first(&ob->u.sgl);
+
+	case wsdeque:
+		return ws_pop(&ob->u.wsd);
+
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-pop: unknown or unsupported type %d %s, expected stack\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+}
+
+/*
+ * steal -- wsdeque
  *
- * remove an item from the top of the stack.
+ * remove and return the oldest item, from the end away from the
+ * owner. for any thread but the owner.
  *
- * returns the item.
+ * returns the item or NULL.
  */
 
 void *
-pop(one_block *ob) {
+steal(one_block *ob) {
 
 	switch (ob->isa) {
 
-	case stack:
-		return singly_get_first(&ob->u.sgl);
+	case wsdeque:
+		return ws_steal(&ob->u.wsd);
 
 	default:
 		fprintf(stderr,
-			"\nERROR txbone-pop: unknown or unsupported type %d %s, expected stack\n",
+			"\nERROR txbone-steal: unknown or unsupported type %d %s, expected wsdeque\n",
 			ob->isa, ob->tag);
 		return NULL;
 	}
@@ -2144,9 +5722,17 @@ peek(one_block *ob) {
 	switch (ob->isa) {
 
 	case stack:
+		if (ob->backing == bk_ring)
+			return ring_peek_back(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_first(&ob->u.itr);
 		return singly_peek_first(&ob->u.sgl);
 
 	case queue:
+		if (ob->backing == bk_ring)
+			return ring_peek_front(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_first(&ob->u.itr);
 		return doubly_peek_first(&ob->u.dbl);
 
 	default:
@@ -2164,9 +5750,9 @@ peek(one_block *ob) {
  */
 
 /*
- * enqueue -- queue
+ * enqueue -- queue, spsc, mpmc
  *
- * add an item to the queue.
+ * add an item to the queue. a bounded queue waits for room.
  *
  * returns the queue instance.
  */
@@ -2177,7 +5763,23 @@ enqueue(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case queue:
-		doubly_add_last(&ob->u.dbl, item);
+		if (ob->backing == bk_ring)
+			ring_push_back(&ob->u.rng, item);
+		else if (ob->backing == bk_intrusive)
+			intrusive_add_last(&ob->u.itr, item);
+		else
+			doubly_add_last(&ob->u.dbl, item);
+		return ob;
+
+	case spsc:
+	case mpmc:
+		if (!item) {
+			fprintf(stderr, "\nERROR txbone-enqueue: can't enqueue NULL on %s\n",
+				ob->tag);
+			return NULL;
+		}
+		while (!try_enqueue(ob, item))
+			sched_yield();
 		return ob;
 
 	default:
@@ -2189,9 +5791,10 @@ enqueue(one_block *ob, void *item) {
 }
 
 /*
- * dequeue -- queue
+ * dequeue -- queue, spsc, mpmc
  *
- * remove and return the oldest item from the queue.
+ * remove and return the oldest item from the queue. a bounded queue
+ * waits for one.
  *
  * returns the item.
  */
@@ -2202,8 +5805,20 @@ dequeue(one_block *ob) {
 	switch (ob->isa) {
 
 	case queue:
+		if (ob->backing == bk_ring)
+			return ring_pop_front(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_first(&ob->u.itr);
 		return doubly_get_first(&ob->u.dbl);
 
+	case spsc:
+	case mpmc: {
+		void *item;
+		while (!(item = try_dequeue(ob)))
+			sched_yield();
+		return item;
+	}
+
 	default:
 		fprintf(stderr,
 			"\nERROR txbone-dequeue: unknown or unsupported type %d %s, expected queue\n",
@@ -2211,6 +5826,117 @@ dequeue(one_block *ob) {
 		return NULL;
 	}
 }
+
+/*
+ * try_enqueue -- queue, spsc, mpmc
+ *
+ * add an item to the queue if there's room, without waiting.
+ *
+ * returns true if it was added.
+ */
+
+bool
+try_enqueue(one_block *ob, void *item) {
+	return enqueue_n(ob, &item, 1) == 1;
+}
+
+/*
+ * try_dequeue -- queue, spsc, mpmc
+ *
+ * remove and return the oldest item if there is one, without waiting.
+ *
+ * returns the item or NULL.
+ */
+
+void *
+try_dequeue(one_block *ob) {
+	void *item = NULL;
+	dequeue_n(ob, &item, 1);
+	return item;
+}
+
+/*
+ * enqueue_n -- queue, spsc, mpmc
+ *
+ * add as many of the n items as fit, without waiting.
+ *
+ * returns the number added or -1 on error.
+ */
+
+int
+enqueue_n(one_block *ob, void **items, int n) {
+	if (n < 0 || (n > 0 && !items)) {
+		fprintf(stderr, "\nERROR txbone-enqueue_n: invalid items %p/%d\n",
+			(void *)items, n);
+		return -1;
+	}
+
+	switch (ob->isa) {
+
+	case queue:
+		for (int i = 0; i < n; i++)
+			enqueue(ob, items[i]);
+		return n;
+
+	case spsc:
+	case mpmc:
+		/* NULL marks an empty slot in a bounded queue */
+		for (int i = 0; i < n; i++)
+			if (!items[i]) {
+				fprintf(stderr, "\nERROR txbone-enqueue_n: can't enqueue NULL on %s\n",
+					ob->tag);
+				return -1;
+			}
+		if (ob->isa == spsc)
+			return spsc_put_n(&ob->u.spq, items, n);
+		return mpmc_put_n(&ob->u.mpq, items, n);
+
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-enqueue_n: unknown or unsupported type %d %s, expected queue\n",
+			ob->isa, ob->tag);
+		return -1;
+	}
+}
+
+/*
+ * dequeue_n -- queue, spsc, mpmc
+ *
+ * remove up to n of the oldest items into items, without waiting.
+ *
+ * returns the number removed or -1 on error.
+ */
+
+int
+dequeue_n(one_block *ob, void **items, int n) {
+	if (n < 0 || (n > 0 && !items)) {
+		fprintf(stderr, "\nERROR txbone-dequeue_n: invalid items %p/%d\n",
+			(void *)items, n);
+		return -1;
+	}
+
+	switch (ob->isa) {
+
+	case queue: {
+		int i = 0;
+		while (i < n && !is_empty(ob))
+			items[i++] = dequeue(ob);
+		return i;
+	}
+
+	case spsc:
+		return spsc_take_n(&ob->u.spq, items, n);
+
+	case mpmc:
+		return mpmc_take_n(&ob->u.mpq, items, n);
+
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-dequeue_n: unknown or unsupported type %d %s, expected queue\n",
+			ob->isa, ob->tag);
+		return -1;
+	}
+}
 
 /*
  * a deque (f/l-ifo)is built on a doubly linked list, but use the
@@ -2239,7 +5965,12 @@ push_front(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case deque:
-		doubly_add_first(&ob->u.dbl, item);
+		if (ob->backing == bk_ring)
+			ring_push_front(&ob->u.rng, item);
+		else if (ob->backing == bk_intrusive)
+			intrusive_add_first(&ob->u.itr, item);
+		else
+			doubly_add_first(&ob->u.dbl, item);
 		return ob;
 
 	default:
@@ -2264,7 +5995,12 @@ push_back(one_block *ob, void *item) {
 	switch (ob->isa) {
 
 	case deque:
-		doubly_add_last(&ob->u.dbl, item);
+		if (ob->backing == bk_ring)
+			ring_push_back(&ob->u.rng, item);
+		else if (ob->backing == bk_intrusive)
+			intrusive_add_last(&ob->u.itr, item);
+		else
+			doubly_add_last(&ob->u.dbl, item);
 		return ob;
 
 	default:
@@ -2287,6 +6023,10 @@ pop_front(one_block *ob) {
 	switch (ob->isa) {
 
 	case deque:
+		if (ob->backing == bk_ring)
+			return ring_pop_front(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_first(&ob->u.itr);
 		return doubly_get_first(&ob->u.dbl);
 
 	default:
@@ -2309,6 +6049,10 @@ pop_back(one_block *ob) {
 	switch (ob->isa) {
 
 	case deque:
+		if (ob->backing == bk_ring)
+			return ring_pop_back(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_get_last(&ob->u.itr);
 		return doubly_get_last(&ob->u.dbl);
 
 	default:
@@ -2331,6 +6075,10 @@ peek_front(one_block *ob) {
 	switch (ob->isa) {
 
 	case deque:
+		if (ob->backing == bk_ring)
+			return ring_peek_front(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_first(&ob->u.itr);
 		return doubly_peek_first(&ob->u.dbl);
 
 	default:
@@ -2353,6 +6101,10 @@ peek_back(one_block *ob) {
 	switch (ob->isa) {
 
 	case deque:
+		if (ob->backing == bk_ring)
+			return ring_peek_back(&ob->u.rng);
+		if (ob->backing == bk_intrusive)
+			return intrusive_peek_last(&ob->u.itr);
 		return doubly_peek_last(&ob->u.dbl);
 
 	default:
@@ -2389,12 +6141,62 @@ high_index(one_block *self) {
 	return self->u.dyn.length;
 }
 
+/*
+ * grow the array so it holds at least n items. the new capacity is
+ * the power of two at or above n, reached in one realloc no matter
+ * how far n is past the current capacity. new slots are NULL.
+ *
+ * returns false if n can't be reached.
+ */
+
+static
+bool
+dynarray_reserve(one_dynarray *self, int n) {
+	if (n <= self->capacity)
+		return true;
+	if (n > (1 << 30)) {
+		fprintf(stderr,
+			"\nERROR txbone-reserve: capacity %d is too large\n", n);
+		return false;
+	}
+	int cap = n > 1 ? 1 << (u32_log2(n - 1) + 1) : 1;
+	void **array = tsrealloc(self->array, cap * sizeof(void *));
+	if (!array) {
+		fprintf(stderr,
+			"\nERROR txbone-reserve: could not grow to capacity %d\n", cap);
+		return false;
+	}
+	memset(array + self->capacity, 0, (cap - self->capacity) * sizeof(void *));
+	self->array = array;
+	self->capacity = cap;
+	return true;
+}
+
+/*
+ * shrink the array to just hold its high index. the capacity no
+ * longer has to be a power of two, the next growth will restore that.
+ */
+
+static
+void
+dynarray_shrink(one_dynarray *self) {
+	int cap = self->length + 1 > 0 ? self->length + 1 : 1;
+	if (cap >= self->capacity)
+		return;
+	ONE_POISON(self->array + cap, (self->capacity - cap) * sizeof(void *));
+	void **array = tsrealloc(self->array, cap * sizeof(void *));
+	if (!array)
+		return;
+	self->array = array;
+	self->capacity = cap;
+}
+
 /*
  * put_at -- dynarray
  *
  * store a value at a particular index in the array. if the array's
- * capacity is less than the index, double the capacity until the
- * index is valid.
+ * capacity is less than the index, grow it to the next power of two
+ * that holds the index.
  *
  * returns the array instance or NULL on error.
  */
@@ -2412,21 +6214,59 @@ put_at(one_block *self, void *item, int n) {
 			"\nERROR txbone-put_at: index may not be negative %d\n", n);
 		return NULL;
 	}
-	while (n >= self->u.dyn.capacity) {
-		void *old = self->u.dyn.array;
-		self->u.dyn.array = tsmalloc(2 * self->u.dyn.capacity * sizeof(void *));
-		memset(self->u.dyn.array, 0, 2 * self->u.dyn.capacity * sizeof(void *));
-		memcpy(self->u.dyn.array, old, self->u.dyn.capacity * sizeof(void *));
-		memset(old, 253, self->u.dyn.capacity * sizeof(void *));
-		tsfree(old);
-		self->u.dyn.capacity *= 2;
-	}
+	if (n >= self->u.dyn.capacity && !dynarray_reserve(&self->u.dyn, n + 1))
+		return NULL;
 	self->u.dyn.array[n] = item;
 	if (n > self->u.dyn.length)
 		self->u.dyn.length = n;
 	return self;
 }
 
+/*
+ * reserve -- dynarray
+ *
+ * make room for at least n items without further growth. the
+ * capacity is rounded up to a power of two. never shrinks.
+ *
+ * returns the array instance or NULL on error.
+ */
+
+one_block *
+reserve(one_block *self, int n) {
+	if (self->isa != dynarray) {
+		fprintf(stderr,
+			"\nERROR txbone-reserve: unknown or unsupported type %d %s, expected dynarray\n",
+			self->isa, self->tag);
+		return NULL;
+	}
+	if (n < 0) {
+		fprintf(stderr,
+			"\nERROR txbone-reserve: capacity may not be negative %d\n", n);
+		return NULL;
+	}
+	return dynarray_reserve(&self->u.dyn, n) ? self : NULL;
+}
+
+/*
+ * shrink_to_fit -- dynarray
+ *
+ * release any capacity past the high index.
+ *
+ * returns the array instance or NULL on error.
+ */
+
+one_block *
+shrink_to_fit(one_block *self) {
+	if (self->isa != dynarray) {
+		fprintf(stderr,
+			"\nERROR txbone-shrink_to_fit: unknown or unsupported type %d %s, expected dynarray\n",
+			self->isa, self->tag);
+		return NULL;
+	}
+	dynarray_shrink(&self->u.dyn);
+	return self;
+}
+
 /*
  * get_from -- dynarray
  *
@@ -2468,7 +6308,8 @@ get_from(one_block *self, int n) {
  *
  * add an item to the end of an alist.
  *
- * returns the instance.
+ * returns the instance, or NULL if the alist couldn't grow. the alist
+ * passed in is then unchanged.
  */
 
 one_block *
@@ -2480,6 +6321,25 @@ cons(one_block *ob, uintptr_t atom) {
 	return alist_cons(ob, atom);
 }
 
+/*
+ * stable_handle -- alist
+ *
+ * set or clear growth in place for the alist. see alist_grow.
+ *
+ * returns the instance.
+ */
+
+one_block *
+stable_handle(one_block *ob, bool stable) {
+	if (ob->isa != alist) {
+		fprintf(stderr, "\nERROR txbone-stable_handle: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+	ob->u.acc.stable = stable;
+	return ob;
+}
+
 /*
  * car -- alist
  *
@@ -2536,6 +6396,84 @@ append(one_block *left, one_block *right) {
 	return alist_append(left, right);
 }
 
+/*
+ * append_n -- dynarray, alist
+ *
+ * add n pointer sized items to the end of the structure: after the
+ * high index of a dynarray, or after the last item of an alist. the
+ * capacity is checked once and the items are copied in one go.
+ *
+ * as with cons, an alist may come back as a new handle. if it can't
+ * grow NULL comes back and the alist passed in is unchanged.
+ *
+ * returns the instance or NULL on error.
+ */
+
+one_block *
+append_n(one_block *ob, const void *items, int n) {
+	if (n < 0 || (n > 0 && !items)) {
+		fprintf(stderr, "\nERROR txbone-append_n: bad item array or count %d\n", n);
+		return NULL;
+	}
+
+	switch (ob->isa) {
+
+	case dynarray: {
+		one_dynarray *self = &ob->u.dyn;
+		if (n == 0)
+			return ob;
+		const void **from = (const void **)items;
+		bool own = from >= (const void **)self->array
+			&& from < (const void **)self->array + self->capacity;
+		ptrdiff_t at = own ? from - (const void **)self->array : 0;
+		if (!dynarray_reserve(self, self->length + 1 + n))
+			return NULL;
+		if (own)
+			items = self->array + at;
+		memcpy(self->array + self->length + 1, items, n * sizeof(void *));
+		self->length += n;
+		return ob;
+	}
+
+	case alist:
+		return alist_cons_n(ob, items, n);
+
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-append_n: unknown or unsupported type %d %s, expected dynarray or alist\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+}
+
+/*
+ * extend -- dynarray, alist
+ *
+ * append_n all the items of another dynarray or alist. the other
+ * structure is unchanged. for a dynarray that is every slot through
+ * its high index.
+ *
+ * returns the instance or NULL on error.
+ */
+
+one_block *
+extend(one_block *ob, one_block *other) {
+	switch (other->isa) {
+
+	case dynarray:
+		return append_n(ob, other->u.dyn.array, other->u.dyn.length + 1);
+
+	case alist:
+		return append_n(ob, other->u.acc.list, other->u.acc.used);
+
+	default:
+		fprintf(stderr,
+			"\nERROR txbone-extend: unknown or unsupported type %d %s, expected dynarray or alist\n",
+			other->isa, other->tag);
+		return NULL;
+	}
+}
+
 /*
  * slice -- alist
  *
@@ -2594,7 +6532,8 @@ nth(one_block *ob, int n) {
  *
  * priorities are signed longs. the queue is maintained in
  * order by priority, and then first in first out for items
- * of equal priority.
+ * of equal priority taken from the max end. the min end takes
+ * the newest of its equals, last in first out.
  */
 
 /*
@@ -2630,7 +6569,19 @@ add_with_min(one_block *ob, void *item) {
 
 one_block *
 add_with_priority(one_block *ob, long priority, void *item) {
-	pq_item *qi = pq_create_item(priority, item);
+	switch (ob->backing) {
+	case bk_heap:
+		pqh_add(&ob->u.pqh, priority, item);
+		return ob;
+	case bk_dual_heap:
+		pqd_add(&ob->u.pqd, priority, item);
+		return ob;
+	default:
+		break;
+	}
+
+	pq_item *qi = pq_create_item(ob, priority, item);
+	ob->u.pqu.length += 1;
 
 	/* empty is easy.  */
 	if (ob->u.pqu.first == NULL) {
@@ -2678,13 +6629,22 @@ add_with_priority(one_block *ob, long priority, void *item) {
 
 void *
 get_max(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap:
+		return ob->u.pqh.length ? pqh_remove_at(&ob->u.pqh, 0) : NULL;
+	case bk_dual_heap:
+		return pqd_take(&ob->u.pqd, PQD_MAX);
+	default:
+		break;
+	}
+
 	if (ob->u.pqu.first == NULL)
 		return NULL;
 	pq_item *qi = ob->u.pqu.last;
 	void *ret = qi->item;
 	ob->u.pqu.last = qi->previous;
-	memset(qi, 253, sizeof(*qi));
-	tfree(qi);
+	ob->u.pqu.length -= 1;
+	pool_give(&ob->u.pqu.pool, qi, sizeof(*qi));
 	if (ob->u.pqu.last == NULL)
 		ob->u.pqu.first = NULL;
 	else
@@ -2694,34 +6654,69 @@ get_max(one_block *ob) {
 
 void *
 peek_max(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap:
+		return ob->u.pqh.length ? ob->u.pqh.heap[0].item : NULL;
+	case bk_dual_heap: {
+		pq_slot *top = pqd_peek(&ob->u.pqd, PQD_MAX);
+		return top ? top->item : NULL;
+	}
+	default:
+		break;
+	}
+
 	return ob->u.pqu.last ? ob->u.pqu.last->item : NULL;
 }
 
 /*
  * get_ and peek_min -- pqueue
  *
- * return the oldest item at the lowest priority in the pqueue. peek
+ * return the newest item at the lowest priority in the pqueue. peek
  * leaves the item in place.
  */
 
 void *
 get_min(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap: {
+		int m = pqh_min_index(&ob->u.pqh);
+		return m < 0 ? NULL : pqh_remove_at(&ob->u.pqh, m);
+	}
+	case bk_dual_heap:
+		return pqd_take(&ob->u.pqd, PQD_MIN);
+	default:
+		break;
+	}
+
 	if (ob->u.pqu.first == NULL)
 		return NULL;
 	pq_item *qi = ob->u.pqu.first;
 	void *ret = qi->item;
 	ob->u.pqu.first = qi->next;
-	memset(qi, 253, sizeof(*qi));
-	tfree(qi);
-	if (ob->u.pqu.last == NULL)
-		ob->u.pqu.first = NULL;
+	ob->u.pqu.length -= 1;
+	pool_give(&ob->u.pqu.pool, qi, sizeof(*qi));
+	if (ob->u.pqu.first == NULL)
+		ob->u.pqu.last = NULL;
 	else
-		ob->u.pqu.last->next = NULL;
+		ob->u.pqu.first->previous = NULL;
 	return ret;
 }
 
 void *
 peek_min(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap: {
+		int m = pqh_min_index(&ob->u.pqh);
+		return m < 0 ? NULL : ob->u.pqh.heap[m].item;
+	}
+	case bk_dual_heap: {
+		pq_slot *bottom = pqd_peek(&ob->u.pqd, PQD_MIN);
+		return bottom ? bottom->item : NULL;
+	}
+	default:
+		break;
+	}
+
 	return ob->u.pqu.first ? ob->u.pqu.first->item : NULL;
 }
 
@@ -2733,6 +6728,17 @@ peek_min(one_block *ob) {
 
 long
 max_priority(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap:
+		return ob->u.pqh.length ? ob->u.pqh.heap[0].priority : 0;
+	case bk_dual_heap: {
+		pq_slot *top = pqd_peek(&ob->u.pqd, PQD_MAX);
+		return top ? top->priority : 0;
+	}
+	default:
+		break;
+	}
+
 	return ob->u.pqu.last ? ob->u.pqu.last->priority : 0;
 }
 
@@ -2744,6 +6750,19 @@ max_priority(one_block *ob) {
 
 long
 min_priority(one_block *ob) {
+	switch (ob->backing) {
+	case bk_heap: {
+		int m = pqh_min_index(&ob->u.pqh);
+		return m < 0 ? 0 : ob->u.pqh.heap[m].priority;
+	}
+	case bk_dual_heap: {
+		pq_slot *bottom = pqd_peek(&ob->u.pqd, PQD_MIN);
+		return bottom ? bottom->priority : 0;
+	}
+	default:
+		break;
+	}
+
 	return ob->u.pqu.first ? ob->u.pqu.first->priority : 0;
 }
 
@@ -2767,8 +6786,14 @@ insert(one_block *ob, void *key, void *value) {
 
 	switch (ob->isa) {
 
-	case keyval:
-		return btree_insert(&ob->u.kvl, key, value);
+	case keyval: {
+		kv_lock(ob);
+		bool ok = ob->backing == bk_hash ? hash_insert(&ob->u.hsh, key, value)
+			: ob->backing == bk_bplus ? bplus_insert(&ob->u.bpt, key, value)
+			: btree_insert(&ob->u.kvl, key, value);
+		kv_unlock(ob);
+		return ok;
+	}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-insert: unknown or unsupported type %d %s\n",
@@ -2777,13 +6802,92 @@ insert(one_block *ob, void *key, void *value) {
 	}
 }
 
+/*
+ * load_sorted -- keyval
+ *
+ * fill an empty store from keys already in order. the keys are all
+ * checked before anything is loaded.
+ *
+ * returns the store or NULL on error.
+ */
+
+one_block *
+load_sorted(one_block *ob, void **keys, void **values, int n) {
+
+	if (ob->isa != keyval) {
+		fprintf(stderr, "\nERROR txbone-load_sorted: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+	kv_lock(ob);
+	if (!kv_empty(ob) || n < 0) {
+		kv_unlock(ob);
+		fprintf(stderr, "\nERROR txbone-load_sorted: store must be empty, %d keys %s\n",
+			n, ob->tag);
+		return NULL;
+	}
+
+	one_key_comparator fn_cmp =
+		ob->backing == bk_hash ? ob->u.hsh.fn_cmp
+		: ob->backing == bk_bplus ? ob->u.bpt.fn_cmp
+		: ob->u.kvl.fn_cmp;
+	for (int i = 1; i < n; i++)
+		if (fn_cmp(keys[i - 1], keys[i]) >= 0) {
+			kv_unlock(ob);
+			fprintf(stderr,
+				"\nERROR txbone-load_sorted: key %d is out of order or repeated %s\n",
+				i, ob->tag);
+			return NULL;
+		}
+
+	switch (ob->backing) {
+	case bk_hash:
+		for (int i = 0; i < n; i++)
+			hash_insert(&ob->u.hsh, keys[i], values[i]);
+		break;
+	case bk_bplus:
+		bplus_load(&ob->u.bpt, keys, values, n);
+		break;
+	default:
+		btree_load(&ob->u.kvl, keys, values, n);
+	}
+	kv_unlock(ob);
+	return ob;
+}
+
+one_block *
+snapshot(one_block *ob) {
+
+	if (ob->isa != keyval || ob->backing != bk_bplus) {
+		fprintf(stderr,
+			"\nERROR txbone-snapshot: unknown or unsupported type %d backing %d %s\n",
+			ob->isa, ob->backing, ob->tag);
+		return NULL;
+	}
+
+	kv_lock(ob);
+	one_block *copy = tsmalloc(sizeof(*copy));
+	memcpy(copy, ob, sizeof(*copy));
+	bplus_snapshot(&ob->u.bpt, &copy->u.bpt);
+	if (ob->lock)
+		atomic_fetch_add(&ob->lock->users, 1);
+	kv_unlock(ob);
+	return copy;
+}
+
 void *
 get(one_block *ob, void *key) {
 
 	switch (ob->isa) {
 
-	case keyval:
-		return btree_get(&ob->u.kvl, key);
+	case keyval: {
+		kv_lock_shared(ob);
+		void *value = ob->backing == bk_hash ? hash_get(&ob->u.hsh, key)
+			: ob->backing == bk_bplus ? bplus_get(&ob->u.bpt, key)
+			: btree_get(&ob->u.kvl, key);
+		kv_unlock_shared(ob);
+		return value;
+	}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-get: unknown or unsupported type %d %s\n",
@@ -2797,8 +6901,14 @@ delete (one_block *ob, void *key) {
 
 	switch (ob->isa) {
 
-	case keyval:
-		return btree_delete(&ob->u.kvl, key);
+	case keyval: {
+		kv_lock(ob);
+		bool ok = ob->backing == bk_hash ? hash_delete(&ob->u.hsh, key)
+			: ob->backing == bk_bplus ? bplus_delete(&ob->u.bpt, key)
+			: btree_delete(&ob->u.kvl, key);
+		kv_unlock(ob);
+		return ok;
+	}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-delete: unknown or unsupported type %d %s\n",
@@ -2812,8 +6922,14 @@ update(one_block *ob, void *key, void *value) {
 
 	switch (ob->isa) {
 
-	case keyval:
-		return btree_update(&ob->u.kvl, key, value);
+	case keyval: {
+		kv_lock(ob);
+		bool ok = ob->backing == bk_hash ? hash_update(&ob->u.hsh, key, value)
+			: ob->backing == bk_bplus ? bplus_update(&ob->u.bpt, key, value)
+			: btree_update(&ob->u.kvl, key, value);
+		kv_unlock(ob);
+		return ok;
+	}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-update: unknown or unsupported type %d %s\n",
@@ -2833,8 +6949,14 @@ exists(one_block *ob, void *key) {
 
 	switch (ob->isa) {
 
-	case keyval:
-		return btree_exists(&ob->u.kvl, key);
+	case keyval: {
+		kv_lock_shared(ob);
+		bool found = ob->backing == bk_hash ? hash_find(&ob->u.hsh, key) >= 0
+			: ob->backing == bk_bplus ? bplus_exists(&ob->u.bpt, key)
+			: btree_exists(&ob->u.kvl, key);
+		kv_unlock_shared(ob);
+		return found;
+	}
 
 	default:
 		fprintf(stderr, "\nERROR txbone-exists: unknown or unsupported type %d %s\n",
@@ -2878,9 +7000,15 @@ keys(one_block *ob) {
 	switch (ob->isa) {
 
 	case keyval: {
+		kv_lock_shared(ob);
 		one_block *xs = make_one(alist);
-		if (ob->u.kvl.root)
+		if (ob->backing == bk_hash)
+			xs = hash_collector(&ob->u.hsh, true, xs);
+		else if (ob->backing == bk_bplus)
+			xs = bplus_collector_r(ob->u.bpt.root, true, xs);
+		else if (ob->u.kvl.root)
 			xs = btree_key_collector(&ob->u.kvl, ob->u.kvl.root, xs);
+		kv_unlock_shared(ob);
 		return xs;
 	}
 
@@ -2903,9 +7031,15 @@ values(one_block *ob) {
 	switch (ob->isa) {
 
 	case keyval: {
+		kv_lock_shared(ob);
 		one_block *xs = make_one(alist);
-		if (ob->u.kvl.root)
+		if (ob->backing == bk_hash)
+			xs = hash_collector(&ob->u.hsh, false, xs);
+		else if (ob->backing == bk_bplus)
+			xs = bplus_collector_r(ob->u.bpt.root, false, xs);
+		else if (ob->u.kvl.root)
 			xs = btree_value_collector(&ob->u.kvl, ob->u.kvl.root, xs);
+		kv_unlock_shared(ob);
 		return xs;
 	}
 	default:
@@ -2915,6 +7049,32 @@ values(one_block *ob) {
 	}
 }
 
+/*
+ * sorted_keys -- keyval
+ *
+ * return an alist of all the current keys in order, whatever the
+ * backing. the tree already has them in order.
+ */
+
+one_block *
+sorted_keys(one_block *ob) {
+
+	switch (ob->isa) {
+
+	case keyval: {
+		one_block *xs = keys(ob);
+		if (ob->backing == bk_hash)
+			hash_sort_keys(&ob->u.hsh, xs->u.acc.list, xs->u.acc.used);
+		return xs;
+	}
+
+	default:
+		fprintf(stderr, "\nERROR txbone-sorted_keys: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return NULL;
+	}
+}
+
 /*
  * in_, pre_, and post_order_keyed -- keyval
  *
@@ -2935,7 +7095,15 @@ in_order_keyed(one_block *ob, void *context, fn_traversal_cb fn) {
 	switch (ob->isa) {
 
 	case keyval:
-		return in_order_traversal(&ob->u.kvl, context, fn);
+		if (ob->backing != bk_hash) {
+			kv_lock_shared(ob);
+			int n = ob->backing == bk_bplus
+				? bplus_walk(&ob->u.bpt, NULL, NULL, true, context, fn)
+				: in_order_traversal(&ob->u.kvl, context, fn);
+			kv_unlock_shared(ob);
+			return n;
+		}
+		/* fall through, a hash table has no order */
 
 	default:
 		fprintf(stderr,
@@ -2951,7 +7119,13 @@ pre_order_keyed(one_block *ob, void *context, fn_traversal_cb fn) {
 	switch (ob->isa) {
 
 	case keyval:
-		return pre_order_traversal(&ob->u.kvl, context, fn);
+		if (ob->backing == bk_tree) {
+			kv_lock_shared(ob);
+			int n = pre_order_traversal(&ob->u.kvl, context, fn);
+			kv_unlock_shared(ob);
+			return n;
+		}
+		/* fall through, only a binary tree has a pre order */
 
 	default:
 		fprintf(stderr,
@@ -2967,7 +7141,13 @@ post_order_keyed(one_block *ob, void *context, fn_traversal_cb fn) {
 	switch (ob->isa) {
 
 	case keyval:
-		return post_order_traversal(&ob->u.kvl, context, fn);
+		if (ob->backing == bk_tree) {
+			kv_lock_shared(ob);
+			int n = post_order_traversal(&ob->u.kvl, context, fn);
+			kv_unlock_shared(ob);
+			return n;
+		}
+		/* fall through, only a binary tree has a post order */
 
 	default:
 		fprintf(stderr,
@@ -2977,4 +7157,517 @@ post_order_keyed(one_block *ob, void *context, fn_traversal_cb fn) {
 	}
 }
 
+/*
+ * cursors -- all
+ *
+ * a cursor holds a node pointer for the linked structures and the
+ * tree, and an index for everything else. after each move the
+ * current item is loaded into the cursor, or the cursor is marked
+ * finished.
+ */
+
+static
+void
+cursor_fetch(one_cursor *cur) {
+	one_block *ob = cur->ob;
+	cur->key = NULL;
+	cur->item = NULL;
+	cur->priority = 0;
+
+	switch (ob->isa) {
+
+	case singly:
+	case stack:
+		if (ob->backing == bk_ring) {
+			/* a ring stack's top is at the back */
+			one_ring *r = &ob->u.rng;
+			if (cur->index >= r->length)
+				break;
+			cur->item = r->slot[(r->head + r->length - 1 - cur->index) & (r->capacity - 1)];
+			return;
+		}
+		if (!cur->at)
+			break;
+		if (ob->backing == bk_intrusive)
+			cur->item = intrusive_item(&ob->u.itr, cur->at);
+		else
+			cur->item = ((sgl_item *)cur->at)->item;
+		return;
+
+	case doubly:
+	case queue:
+	case deque:
+		if (ob->backing == bk_ring) {
+			one_ring *r = &ob->u.rng;
+			if (cur->index >= r->length)
+				break;
+			cur->item = r->slot[(r->head + cur->index) & (r->capacity - 1)];
+			return;
+		}
+		if (!cur->at)
+			break;
+		if (ob->backing == bk_intrusive)
+			cur->item = intrusive_item(&ob->u.itr, cur->at);
+		else
+			cur->item = ((dbl_item *)cur->at)->item;
+		return;
+
+	case dynarray:
+		if (cur->index > ob->u.dyn.length)
+			break;
+		cur->item = ob->u.dyn.array[cur->index];
+		return;
+
+	case alist:
+		if (cur->index >= ob->u.acc.used)
+			break;
+		cur->item = (void *)ob->u.acc.list[cur->index];
+		return;
+
+	case keyval:
+		if (ob->backing == bk_hash) {
+			if (cur->index >= ob->u.hsh.capacity)
+				break;
+			cur->key = ob->u.hsh.table[cur->index].key;
+			cur->item = ob->u.hsh.table[cur->index].value;
+			return;
+		}
+		if (!cur->at)
+			break;
+		if (ob->backing == bk_bplus) {
+			cur->key = ((bp_leaf *)cur->at)->h.key[cur->index];
+			cur->item = ((bp_leaf *)cur->at)->value[cur->index];
+			return;
+		}
+		cur->key = ((one_node *)cur->at)->key;
+		cur->item = ((one_node *)cur->at)->value;
+		return;
+
+	case pqueue:
+		switch (ob->backing) {
+		case bk_heap:
+			if (cur->index >= ob->u.pqh.length)
+				break;
+			cur->priority = ob->u.pqh.heap[cur->index].priority;
+			cur->item = ob->u.pqh.heap[cur->index].item;
+			return;
+		case bk_dual_heap:
+			if (cur->index >= ob->u.pqd.length)
+				break;
+			cur->priority = ob->u.pqd.slot[cur->index].s.priority;
+			cur->item = ob->u.pqd.slot[cur->index].s.item;
+			return;
+		default:
+			if (!cur->at)
+				break;
+			cur->priority = ((pq_item *)cur->at)->priority;
+			cur->item = ((pq_item *)cur->at)->item;
+			return;
+		}
+		break;
+
+	default:
+		break;
+	}
+	cur->finished = true;
+}
+
+/*
+ * begin -- all
+ *
+ * position the cursor on the first item of the structure.
+ *
+ * returns the cursor or NULL on error.
+ */
+
+one_cursor *
+begin(one_block *ob, one_cursor *cur) {
+	memset(cur, 0, sizeof(*cur));
+	cur->ob = ob;
+
+	switch (ob->isa) {
+
+	case singly:
+	case stack:
+		if (ob->backing == bk_intrusive)
+			cur->at = ob->u.itr.first;
+		else if (ob->backing != bk_ring)
+			cur->at = ob->u.sgl.first;
+		break;
+
+	case doubly:
+	case queue:
+	case deque:
+		if (ob->backing == bk_intrusive)
+			cur->at = ob->u.itr.first;
+		else if (ob->backing != bk_ring)
+			cur->at = ob->u.dbl.first;
+		break;
+
+	case dynarray:
+	case alist:
+		break;
+
+	case keyval:
+		if (ob->backing == bk_hash)
+			cur->index = hash_next_used(&ob->u.hsh, 0);
+		else if (ob->backing == bk_bplus)
+			cur->at = bplus_down(&ob->u.bpt, NULL, true, cur);
+		else
+			cur->at = btree_live(btree_leftmost(ob->u.kvl.root));
+		break;
+
+	case pqueue:
+		if (ob->backing != bk_heap && ob->backing != bk_dual_heap)
+			cur->at = ob->u.pqu.first;
+		break;
+
+	default:
+		fprintf(stderr, "\nERROR txbone-begin: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		cur->finished = true;
+		return NULL;
+	}
+
+	cursor_fetch(cur);
+	return cur;
+}
+
+/*
+ * next -- all
+ *
+ * move the cursor to the next item. a finished cursor stays put.
+ *
+ * returns the cursor.
+ */
+
+one_cursor *
+next(one_cursor *cur) {
+	if (cur->finished)
+		return cur;
+	one_block *ob = cur->ob;
+
+	switch (ob->isa) {
+
+	case singly:
+	case stack:
+		if (ob->backing == bk_ring)
+			cur->index += 1;
+		else if (ob->backing == bk_intrusive)
+			cur->at = ((one_link *)cur->at)->next;
+		else
+			cur->at = ((sgl_item *)cur->at)->next;
+		break;
+
+	case doubly:
+	case queue:
+	case deque:
+		if (ob->backing == bk_ring)
+			cur->index += 1;
+		else if (ob->backing == bk_intrusive)
+			cur->at = ((one_link *)cur->at)->next;
+		else
+			cur->at = ((dbl_item *)cur->at)->next;
+		break;
+
+	case keyval:
+		if (ob->backing == bk_hash)
+			cur->index = hash_next_used(&ob->u.hsh, cur->index + 1);
+		else if (ob->backing == bk_bplus) {
+			cur->index += 1;
+			bp_leaf *l = cur->at;
+			if (cur->index == l->h.count) {
+				cur->at = bplus_step(&ob->u.bpt, cur, l);
+				cur->index = 0;
+			}
+		} else
+			cur->at = btree_live(btree_successor(cur->at));
+		break;
+
+	case pqueue:
+		if (ob->backing != bk_heap && ob->backing != bk_dual_heap)
+			cur->at = ((pq_item *)cur->at)->next;
+		else
+			cur->index += 1;
+		break;
+
+	default:
+		cur->index += 1;
+		break;
+	}
+
+	cursor_fetch(cur);
+	return cur;
+}
+
+/*
+ * done -- all
+ *
+ * predicate has the cursor walked past the last item?
+ */
+
+bool
+done(const one_cursor *cur) {
+	return cur->finished;
+}
+
+/*
+ * range -- keyval
+ *
+ * call the client for every key in [lo, hi] in ascending order. the
+ * callback returns false to stop early.
+ *
+ * returns the number of calls made or -1 on error.
+ */
+
+int
+range(one_block *ob, void *lo, void *hi, void *context, fn_traversal_cb fn) {
+
+	switch (ob->isa) {
+
+	case keyval:
+		if (ob->backing != bk_hash) {
+			kv_lock_shared(ob);
+			int n = ob->backing == bk_bplus
+				? bplus_walk(&ob->u.bpt, lo, hi, false, context, fn)
+				: btree_range(&ob->u.kvl, lo, hi, context, fn);
+			kv_unlock_shared(ob);
+			return n;
+		}
+		/* fall through, a hash table has no order */
+
+	default:
+		fprintf(stderr, "\nERROR txbone-range: unknown or unsupported type %d %s\n",
+			ob->isa, ob->tag);
+		return -1;
+	}
+}
+
+/*
+ * the ordered lookups below all need a tree or B+ tree backed keyval,
+ * and rank and select need the counts only the tree keeps.
+ */
+
+static
+bool
+ordered_keyval(one_block *ob, const char *what) {
+	if (ob->isa == keyval && ob->backing != bk_hash)
+		return true;
+	fprintf(stderr, "\nERROR txbone-%s: unknown or unsupported type %d %s\n",
+		what, ob->isa, ob->tag);
+	return false;
+}
+
+static
+bool
+counted_keyval(one_block *ob, const char *what) {
+	if (ob->isa == keyval && ob->backing == bk_tree)
+		return true;
+	fprintf(stderr, "\nERROR txbone-%s: unknown or unsupported type %d %s\n",
+		what, ob->isa, ob->tag);
+	return false;
+}
+
+/*
+ * a cursor set on a node of the tree. a B+ tree cursor also needs
+ * the path down to its leaf, see bplus_lower_bound.
+ */
+
+static
+one_cursor *
+cursor_at(one_block *ob, one_cursor *cur, void *at) {
+	memset(cur, 0, sizeof(*cur));
+	cur->ob = ob;
+	cur->at = at;
+	cursor_fetch(cur);
+	return cur;
+}
+
+/*
+ * lower_bound and upper_bound -- keyval
+ *
+ * position a cursor on the first key at or after, or strictly after,
+ * the key. the cursor then walks on in ascending order.
+ *
+ * the cursor is positioned under the shared lock on a concurrent
+ * keyval, but holds no lock once it returns.
+ *
+ * returns the cursor or NULL on error. an error leaves it done.
+ */
+
+one_cursor *
+lower_bound(one_block *ob, void *key, one_cursor *cur) {
+	if (!ordered_keyval(ob, "lower_bound")) {
+		memset(cur, 0, sizeof(*cur));
+		cur->ob = ob;
+		cur->finished = true;
+		return NULL;
+	}
+	kv_lock_shared(ob);
+	if (ob->backing == bk_bplus) {
+		memset(cur, 0, sizeof(*cur));
+		cur->ob = ob;
+		bplus_lower_bound(&ob->u.bpt, key, false, cur);
+		cursor_fetch(cur);
+	} else
+		cursor_at(ob, cur, btree_lower_bound(&ob->u.kvl, key, false));
+	kv_unlock_shared(ob);
+	return cur;
+}
+
+one_cursor *
+upper_bound(one_block *ob, void *key, one_cursor *cur) {
+	if (!ordered_keyval(ob, "upper_bound")) {
+		memset(cur, 0, sizeof(*cur));
+		cur->ob = ob;
+		cur->finished = true;
+		return NULL;
+	}
+	kv_lock_shared(ob);
+	if (ob->backing == bk_bplus) {
+		memset(cur, 0, sizeof(*cur));
+		cur->ob = ob;
+		bplus_lower_bound(&ob->u.bpt, key, true, cur);
+		cursor_fetch(cur);
+	} else
+		cursor_at(ob, cur, btree_lower_bound(&ob->u.kvl, key, true));
+	kv_unlock_shared(ob);
+	return cur;
+}
+
+/*
+ * floor_key, ceiling_key, first_key, last_key -- keyval
+ *
+ * the greatest key at or below the key, the least key at or above
+ * it, and the least and greatest keys held.
+ *
+ * returns the key, or NULL if there is none or on error.
+ */
+
+void *
+floor_key(one_block *ob, void *key) {
+	if (!ordered_keyval(ob, "floor_key"))
+		return NULL;
+	kv_lock_shared(ob);
+	void *found = NULL;
+	if (ob->backing == bk_bplus)
+		found = bplus_floor(&ob->u.bpt, key);
+	else {
+		one_node *n = btree_floor(&ob->u.kvl, key);
+		found = n ? n->key : NULL;
+	}
+	kv_unlock_shared(ob);
+	return found;
+}
+
+void *
+ceiling_key(one_block *ob, void *key) {
+	if (!ordered_keyval(ob, "ceiling_key"))
+		return NULL;
+	kv_lock_shared(ob);
+	void *found = NULL;
+	if (ob->backing == bk_bplus) {
+		one_cursor c = { 0 };
+		bplus_lower_bound(&ob->u.bpt, key, false, &c);
+		found = c.at ? ((bp_leaf *)c.at)->h.key[c.index] : NULL;
+	} else {
+		one_node *n = btree_lower_bound(&ob->u.kvl, key, false);
+		found = n ? n->key : NULL;
+	}
+	kv_unlock_shared(ob);
+	return found;
+}
+
+void *
+first_key(one_block *ob) {
+	if (!ordered_keyval(ob, "first_key"))
+		return NULL;
+	kv_lock_shared(ob);
+	void *found = NULL;
+	if (ob->backing == bk_bplus) {
+		bp_leaf *l = bplus_first_leaf(ob->u.bpt.root);
+		found = l ? l->h.key[0] : NULL;
+	} else {
+		one_node *n = btree_live(btree_leftmost(ob->u.kvl.root));
+		found = n ? n->key : NULL;
+	}
+	kv_unlock_shared(ob);
+	return found;
+}
+
+void *
+last_key(one_block *ob) {
+	if (!ordered_keyval(ob, "last_key"))
+		return NULL;
+	kv_lock_shared(ob);
+	void *found = NULL;
+	if (ob->backing == bk_bplus) {
+		bp_leaf *l = bplus_last_leaf(ob->u.bpt.root);
+		found = l ? l->h.key[l->h.count - 1] : NULL;
+	} else {
+		one_node *n = btree_live_back(btree_rightmost(ob->u.kvl.root));
+		found = n ? n->key : NULL;
+	}
+	kv_unlock_shared(ob);
+	return found;
+}
+
+/*
+ * tombstones and sweep -- keyval
+ *
+ * deleted nodes awaiting collection, and collecting them. a hash
+ * table or B+ tree doesn't leave any.
+ */
+
+int
+tombstones(one_block *ob) {
+	if (ob->isa == keyval && ob->backing != bk_tree)
+		return 0;
+	if (!ordered_keyval(ob, "tombstones"))
+		return -1;
+	kv_lock_shared(ob);
+	int n = ob->u.kvl.marked_deleted;
+	kv_unlock_shared(ob);
+	return n;
+}
+
+int
+sweep(one_block *ob, int budget) {
+	if (ob->isa == keyval && ob->backing != bk_tree)
+		return 0;
+	if (!ordered_keyval(ob, "sweep"))
+		return -1;
+	kv_lock(ob);
+	int n = btree_sweep(&ob->u.kvl, budget);
+	kv_unlock(ob);
+	return n;
+}
+
+/*
+ * rank and select_key -- keyval
+ *
+ * position in key order, from the counts kept in the nodes.
+ */
+
+int
+rank(one_block *ob, void *key) {
+	if (!counted_keyval(ob, "rank"))
+		return -1;
+	kv_lock_shared(ob);
+	int n = btree_rank(&ob->u.kvl, key);
+	kv_unlock_shared(ob);
+	return n;
+}
+
+void *
+select_key(one_block *ob, int i) {
+	if (!counted_keyval(ob, "select_key"))
+		return NULL;
+	kv_lock_shared(ob);
+	one_node *n = btree_select(&ob->u.kvl, i);
+	void *found = n ? n->key : NULL;
+	kv_unlock_shared(ob);
+	return found;
+}
+
 /* txbone.c ends here */
@@ -0,0 +1,133 @@
+/* benchalist.c -- timings for alist growth modes -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * compare the default alist growth, which copies the list into a new
+ * one_block each time capacity runs out, against stable_handle growth,
+ * which reallocates just the list storage in place.
+ *
+ * two shapes of work are timed. a flat loop of conses, and a lisp
+ * style recursion that walks a list with car and cdr, consing the
+ * result onto an accumulator that is threaded through the calls.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+static
+one_block *
+fresh(bool stable) {
+	return stable_handle(make_one(alist), stable);
+}
+
+/*
+ * cons n items in a loop. returns the sum of the list to check the
+ * modes against each other.
+ */
+
+static
+long
+flat_conses(bool stable, int n, double *elapsed) {
+	double start = mu_timer_real();
+	one_block *xs = fresh(stable);
+	for (int i = 0; i < n; i++)
+		xs = cons(xs, i);
+	*elapsed = mu_timer_real() - start;
+	long sum = 0;
+	for (int i = 0; i < count(xs); i++)
+		sum += nth(xs, i);
+	free_one(xs);
+	return sum;
+}
+
+/*
+ * build the list of squares of xs onto acc, one cons per level of
+ * recursion.
+ */
+
+static
+one_block *
+squares(one_block *xs, one_block *acc) {
+	if (count(xs) == 0) {
+		free_one(xs);
+		return acc;
+	}
+	uintptr_t x = car(xs);
+	one_block *rest = cdr(xs);
+	free_one(xs);
+	return squares(rest, cons(acc, x * x));
+}
+
+static
+long
+recursive_conses(bool stable, int n, int repeat, double *elapsed) {
+	long sum = 0;
+	double start = mu_timer_real();
+	for (int r = 0; r < repeat; r++) {
+		one_block *xs = fresh(stable);
+		for (int i = 0; i < n; i++)
+			xs = cons(xs, i);
+		one_block *ys = squares(xs, fresh(stable));
+		sum += nth(ys, n - 1);
+		free_one(ys);
+	}
+	*elapsed = mu_timer_real() - start;
+	return sum;
+}
+
+MU_TEST(test_flat) {
+	int sizes[] = { 10000, 100000, 1000000 };
+	printf("\n");
+	for (int i = 0; i < 3; i++) {
+		double copying, stable;
+		long a = flat_conses(false, sizes[i], &copying);
+		long b = flat_conses(true, sizes[i], &stable);
+		mu_should(a == b);
+		printf("flat      %8d  copying %9.4fs  stable %9.4fs  %7.1fx\n",
+			sizes[i], copying, stable, stable > 0.0 ? copying / stable : 0.0);
+	}
+}
+
+MU_TEST(test_recursive) {
+	int sizes[] = { 500, 1000, 2000 };
+	printf("\n");
+	for (int i = 0; i < 3; i++) {
+		double copying, stable;
+		long a = recursive_conses(false, sizes[i], 10, &copying);
+		long b = recursive_conses(true, sizes[i], 10, &stable);
+		mu_should(a == b);
+		printf("recursive %8d  copying %9.4fs  stable %9.4fs  %7.1fx\n",
+			sizes[i], copying, stable, stable > 0.0 ? copying / stable : 0.0);
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nalist growth timings\n");
+	MU_RUN_TEST(test_flat);
+	MU_RUN_TEST(test_recursive);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchalist.c ends here */
@@ -0,0 +1,116 @@
+/* benchalpha.c -- timings for keyval balance policies -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * sweep the scapegoat alpha of a keyval and report what it buys. a
+ * low alpha rebalances often and keeps the tree shallow, a high
+ * alpha inserts faster and lets the tree grow deeper.
+ *
+ * for each alpha the same random keys are inserted, then every key
+ * is looked up. reported are the insert and lookup times, the mean
+ * and maximum node depth, and the rebalances done.
+ *
+ * an alpha of 1.1 leaves almost no slack over a perfect tree and
+ * rebuilds the whole tree over and over, minutes at 10^6, so it is
+ * only run at 10^5.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/rand.h"
+#include "../inc/one.h"
+
+#define RAND_SEED 6803
+
+static
+void
+test_setup(void) {
+	set_random_generator(RAND_DEFAULT);
+	seed_random_generator(RAND_SEED);
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * total and maximum depth over the subtree, root at depth 1.
+ */
+
+static
+void
+depths(one_node *n, int depth, long *total, int *most) {
+	if (!n)
+		return;
+	*total += depth;
+	if (depth > *most)
+		*most = depth;
+	depths(n->left, depth + 1, total, most);
+	depths(n->right, depth + 1, total, most);
+}
+
+static
+bool
+time_alpha(double alpha, long *keys, int n) {
+	one_policy p = default_policy();
+	p.alpha = alpha;
+	one_block *kv = make_one_keyed_policy(keyval, integral, NULL, &p);
+
+	double start = mu_timer_real();
+	for (int i = 0; i < n; i++)
+		insert(kv, (void *)keys[i], (void *)keys[i]);
+	double ins = mu_timer_real() - start;
+
+	bool found = true;
+	start = mu_timer_real();
+	for (int i = 0; i < n; i++)
+		found = found && get(kv, (void *)keys[i]) == (void *)keys[i];
+	double look = mu_timer_real() - start;
+
+	long total = 0;
+	int most = 0;
+	depths(kv->u.kvl.root, 1, &total, &most);
+	one_tree *t = &kv->u.kvl;
+	printf("%5.2f %8d  insert %8.4fs  lookup %8.4fs  depth mean %5.2f max %3d  rebalances %d/%d %.4fs\n",
+		alpha, n, ins, look, (double)total / count(kv), most,
+		t->full_rebalances, t->partial_rebalances,
+		t->full_rebalance_time + t->partial_rebalance_time);
+	free_one(kv);
+	return found;
+}
+
+MU_TEST(test_alpha_sweep) {
+	double alphas[] = { 1.1, 1.25, 1.5, 2.0, 3.0 };
+	int sizes[] = { 100000, 1000000 };
+	for (int s = 0; s < 2; s++) {
+		int n = sizes[s];
+		long *keys = malloc(n * sizeof(long));
+		for (int i = 0; i < n; i++)
+			keys[i] = random_between(1, 1000000000);
+		printf("\n");
+		for (int a = 0; a < 5; a++)
+			if (alphas[a] > 1.1 || n <= 100000)
+				mu_should(time_alpha(alphas[a], keys, n));
+		free(keys);
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval alpha sweep\n");
+	MU_RUN_TEST(test_alpha_sweep);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchalpha.c ends here */
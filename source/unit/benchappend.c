@@ -0,0 +1,100 @@
+/* benchappend.c -- timings for appending to lists -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * append throughput on the singly linked list, which keeps its last
+ * item, against the doubly linked list that always has. each list is
+ * built by add_last at 10^5 and 10^6 items, used as a fifo by
+ * add_last and get_first, and then two lists of that size are joined
+ * by splice.
+ *
+ * before the singly list kept its last item every add_last walked
+ * the list. 10^5 appends took over eight seconds, and 10^6 would
+ * take a hundred times that.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+static
+one_block *
+appended(one_type isa, long n) {
+	one_block *ob = make_one(isa);
+	for (long i = 1; i <= n; i++)
+		add_last(ob, (void *)i);
+	return ob;
+}
+
+/*
+ * time one list type at one size. returns false if the lists don't
+ * hold what they should.
+ */
+
+static
+bool
+time_appends(const char *name, one_type isa, long n) {
+	double start = mu_timer_real();
+	one_block *ob = appended(isa, n);
+	double append = mu_timer_real() - start;
+	bool ok = count(ob) == n && (long)peek_last(ob) == n;
+
+	start = mu_timer_real();
+	long sum = 0;
+	for (long i = 1; i <= n; i++) {
+		add_last(ob, (void *)i);
+		sum += (long)get_first(ob);
+	}
+	double fifo = mu_timer_real() - start;
+	ok = ok && sum == n * (n + 1) / 2 && count(ob) == n;
+
+	one_block *other = appended(isa, n);
+	start = mu_timer_real();
+	splice(ob, other);
+	double join = mu_timer_real() - start;
+	ok = ok && count(ob) == 2 * n && is_empty(other);
+
+	printf("%-7s %8ld  append %8.4fs %7.1f M/s  fifo %8.4fs  splice %10.7fs\n",
+		name, n, append, n / append / 1e6, fifo, join);
+	free_one(other);
+	free_one(ob);
+	return ok;
+}
+
+MU_TEST(test_append_times) {
+	long sizes[] = { 100000, 1000000 };
+	printf("\n");
+	for (int i = 0; i < 2; i++) {
+		mu_should(time_appends("singly", singly, sizes[i]));
+		mu_should(time_appends("doubly", doubly, sizes[i]));
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nappend timings\n");
+	MU_RUN_TEST(test_append_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchappend.c ends here */
@@ -0,0 +1,100 @@
+/* benchbplus.c -- timings for the keyval backings -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * random lookup throughput on the scapegoat tree and the B+ tree
+ * backings of a keyval at 10^6 and 10^7 keys.
+ *
+ * the same random keys are inserted into each, then a million keys
+ * picked at random from them are looked up. the picks are made up
+ * front so the timing is only the lookups. at these sizes neither
+ * structure fits in cache, and the B+ tree's wide nodes should mean
+ * far fewer misses per lookup than the tree's one key per node.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/rand.h"
+#include "../inc/one.h"
+
+#define RAND_SEED 6803
+#define LOOKUPS 1000000
+
+static
+void
+test_setup(void) {
+	set_random_generator(RAND_DEFAULT);
+	seed_random_generator(RAND_SEED);
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * load and look up on one backing. returns the lookup time, or a
+ * negative time if a lookup missed.
+ */
+
+static
+double
+time_backing(const char *name, one_backing backing, long *keys, int n, int *picks) {
+	one_block *kv = make_one_keyed_backed(keyval, backing, integral, NULL, NULL);
+
+	double start = mu_timer_real();
+	for (int i = 0; i < n; i++)
+		insert(kv, (void *)keys[i], (void *)keys[i]);
+	double ins = mu_timer_real() - start;
+
+	bool found = true;
+	start = mu_timer_real();
+	for (int i = 0; i < LOOKUPS; i++)
+		found = get(kv, (void *)keys[picks[i]]) == (void *)keys[picks[i]] && found;
+	double look = mu_timer_real() - start;
+
+	printf("%-8s %9d  insert %8.4fs  lookup %8.4fs  %7.2f M/s\n",
+		name, n, ins, look, look > 0.0 ? LOOKUPS / look / 1e6 : 0.0);
+	free_one(kv);
+	return found ? look : -1.0;
+}
+
+MU_TEST(test_lookups) {
+	int sizes[] = { 1000000, 10000000 };
+	int *picks = malloc(LOOKUPS * sizeof(int));
+	for (int s = 0; s < 2; s++) {
+		int n = sizes[s];
+		long *keys = malloc(n * sizeof(long));
+		for (int i = 0; i < n; i++)
+			keys[i] = random_between(1, 2000000000);
+		for (int i = 0; i < LOOKUPS; i++)
+			picks[i] = random_between(0, n - 1);
+		printf("\n");
+		double tree = time_backing("tree", bk_tree, keys, n, picks);
+		double bplus = time_backing("bplus", bk_bplus, keys, n, picks);
+		mu_should(tree > 0.0 && bplus > 0.0);
+		if (tree > 0.0 && bplus > 0.0)
+			printf("%-8s %9d  bplus lookups %.2fx the tree\n", "", n, tree / bplus);
+		free(keys);
+	}
+	free(picks);
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval random lookups, scapegoat tree against B+ tree\n");
+	MU_RUN_TEST(test_lookups);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchbplus.c ends here */
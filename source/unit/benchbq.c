@@ -0,0 +1,164 @@
+/* benchbq.c -- timings for queues between threads -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * throughput of passing items from producer threads to consumer
+ * threads. the plain queue with every call behind one client mutex
+ * is timed against the bounded spsc and mpmc queues, which take no
+ * lock. the bounded queues are timed item at a time and in batches
+ * of 32 through enqueue_n and dequeue_n.
+ *
+ * each producer sends 10^6 items through a queue of 1024. the spsc
+ * only runs one to one, the others also run 2x2 and 4x4. a thread
+ * that finds the queue full or empty yields, so with fewer cores
+ * than threads this mostly times the scheduler.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+#define ITEMS 1000000
+#define CAPACITY 1024
+#define BATCH 32
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+typedef struct bq_arg bq_arg;
+struct bq_arg {
+	one_block *qu;
+	pthread_mutex_t *mutex;    /* NULL for a bounded queue */
+	int batch;
+	atomic_long *left;
+	long sum;
+};
+
+static
+void *
+producer(void *p) {
+	bq_arg *a = p;
+	void *items[BATCH];
+	long i = 1;
+	while (i <= ITEMS) {
+		int n = 0;
+		for (; n < a->batch && i + n <= ITEMS; n++)
+			items[n] = (void *)(i + n);
+		if (a->mutex)
+			pthread_mutex_lock(a->mutex);
+		int sent = enqueue_n(a->qu, items, n);
+		if (a->mutex)
+			pthread_mutex_unlock(a->mutex);
+		if (!sent)
+			sched_yield();
+		i += sent;
+	}
+	return NULL;
+}
+
+static
+void *
+consumer(void *p) {
+	bq_arg *a = p;
+	void *items[BATCH];
+	while (atomic_load_explicit(a->left, memory_order_relaxed) > 0) {
+		if (a->mutex)
+			pthread_mutex_lock(a->mutex);
+		int n = dequeue_n(a->qu, items, a->batch);
+		if (a->mutex)
+			pthread_mutex_unlock(a->mutex);
+		if (!n) {
+			sched_yield();
+			continue;
+		}
+		atomic_fetch_sub(a->left, n);
+		for (int i = 0; i < n; i++)
+			a->sum += (long)items[i];
+	}
+	return NULL;
+}
+
+/*
+ * time one queue with the threads given. returns false if the items
+ * don't all come through.
+ */
+
+static
+bool
+time_queue(const char *name, one_type isa, int batch, int threads) {
+	one_block *qu = isa == queue ? make_one(queue) : make_one_bounded(isa, CAPACITY);
+	pthread_mutex_t mutex;
+	pthread_mutex_init(&mutex, NULL);
+	atomic_long left;
+	atomic_init(&left, (long)threads * ITEMS);
+	bq_arg *args = calloc(2 * threads, sizeof(bq_arg));
+	pthread_t *tids = calloc(2 * threads, sizeof(pthread_t));
+
+	double start = mu_timer_real();
+	for (int t = 0; t < 2 * threads; t++) {
+		args[t].qu = qu;
+		args[t].mutex = isa == queue ? &mutex : NULL;
+		args[t].batch = batch;
+		args[t].left = &left;
+		pthread_create(&tids[t], NULL, t < threads ? producer : consumer, &args[t]);
+	}
+	long sum = 0;
+	for (int t = 0; t < 2 * threads; t++) {
+		pthread_join(tids[t], NULL);
+		sum += args[t].sum;
+	}
+	double elapsed = mu_timer_real() - start;
+
+	long items = (long)threads * ITEMS;
+	printf("%-7s %dx%d  batch %2d  %8.4fs  %7.2f M/s\n",
+		name, threads, threads, batch, elapsed, items / elapsed / 1e6);
+	bool ok = sum == threads * ((long)ITEMS * (ITEMS + 1) / 2) && is_empty(qu);
+	free(tids);
+	free(args);
+	pthread_mutex_destroy(&mutex);
+	free_one(qu);
+	return ok;
+}
+
+MU_TEST(test_throughput) {
+	printf("\n");
+	mu_should(time_queue("mutex", queue, 1, 1));
+	mu_should(time_queue("spsc", spsc, 1, 1));
+	mu_should(time_queue("spsc", spsc, BATCH, 1));
+	mu_should(time_queue("mpmc", mpmc, 1, 1));
+	mu_should(time_queue("mpmc", mpmc, BATCH, 1));
+	for (int threads = 2; threads <= 4; threads *= 2) {
+		mu_should(time_queue("mutex", queue, 1, threads));
+		mu_should(time_queue("mpmc", mpmc, 1, threads));
+		mu_should(time_queue("mpmc", mpmc, BATCH, threads));
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nqueue throughput between threads\n");
+	MU_RUN_TEST(test_throughput);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchbq.c ends here */
@@ -0,0 +1,116 @@
+/* benchintr.c -- timings for intrusive queues -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * a queue of records linked through a one_link in each record,
+ * against the usual queue holding pointers to the same records in
+ * pool allocated nodes. each is filled with 10^5 and 10^6 records,
+ * walked with a cursor summing a field of each record, and drained.
+ * then a few records are churned through it many times over.
+ *
+ * the linked queue pays for a node on every enqueue, so filling and
+ * churning are where the intrusive queue wins. walking and draining
+ * come out about even, since the records are bigger than the nodes
+ * and the intrusive queue strides through them.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+struct record {
+	long value;
+	one_link link;
+	char payload[40];
+};
+
+/*
+ * time one queue at one size. returns false if the queue doesn't
+ * hold what it should.
+ */
+
+static
+bool
+time_queue(const char *name, bool intrusive, struct record *recs, long n) {
+	one_block *q = intrusive
+		? make_one_intrusive(queue, offsetof(struct record, link))
+		: make_one(queue);
+
+	double start = mu_timer_real();
+	for (long i = 0; i < n; i++)
+		enqueue(q, &recs[i]);
+	double fill = mu_timer_real() - start;
+	bool ok = count(q) == n;
+
+	start = mu_timer_real();
+	long sum = 0;
+	one_cursor c;
+	for (begin(q, &c); !done(&c); next(&c))
+		sum += ((struct record *)c.item)->value;
+	double walk = mu_timer_real() - start;
+	ok = ok && sum == n * (n + 1) / 2;
+
+	start = mu_timer_real();
+	while (!is_empty(q))
+		dequeue(q);
+	double drain = mu_timer_real() - start;
+
+	start = mu_timer_real();
+	for (long i = 0; i < n; i++) {
+		enqueue(q, &recs[i & 7]);
+		if ((i & 7) == 7)
+			for (int j = 0; j < 8; j++)
+				dequeue(q);
+	}
+	double churn = mu_timer_real() - start;
+	ok = ok && is_empty(q);
+
+	printf("%-9s %8ld  fill %8.4fs  walk %8.4fs  drain %8.4fs  churn %8.4fs\n",
+		name, n, fill, walk, drain, churn);
+	free_one(q);
+	return ok;
+}
+
+MU_TEST(test_queue_times) {
+	long sizes[] = { 100000, 1000000 };
+	printf("\n");
+	for (int i = 0; i < 2; i++) {
+		long n = sizes[i];
+		struct record *recs = calloc(n, sizeof(*recs));
+		for (long j = 0; j < n; j++)
+			recs[j].value = j + 1;
+		mu_should(time_queue("linked", false, recs, n));
+		mu_should(time_queue("intrusive", true, recs, n));
+		free(recs);
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nintrusive queue timings\n");
+	MU_RUN_TEST(test_queue_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchintr.c ends here */
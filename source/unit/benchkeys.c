@@ -0,0 +1,112 @@
+/* benchkeys.c -- timings for keyval key comparisons -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * random lookup throughput by key type. integral keys are compared
+ * in line rather than through the comparator, and the scapegoat tree
+ * keeps the first bytes of a string key in each node so most steps
+ * of a search don't chase the key pointer into strcmp.
+ *
+ * random keys of each type are loaded into the tree and B+ tree
+ * backings, then a million keys picked at random from them are looked
+ * up. string keys are twelve random lower case letters. 10^4 keys
+ * stay in cache and show the cost of the comparisons, at 10^6 cache
+ * misses take over.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/rand.h"
+#include "../inc/one.h"
+
+#define RAND_SEED 6803
+#define KEYS 1000000
+#define LOOKUPS 1000000
+#define STRLEN 12
+
+static
+void
+test_setup(void) {
+	set_random_generator(RAND_DEFAULT);
+	seed_random_generator(RAND_SEED);
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * load and look up on one backing. returns false if a lookup missed.
+ */
+
+static
+bool
+time_lookups(const char *name, one_backing backing, one_key_type kt,
+	void **keys, int n, int *picks) {
+	one_block *kv = make_one_keyed_backed(keyval, backing, kt, NULL, NULL);
+	for (int i = 0; i < n; i++)
+		insert(kv, keys[i], keys[i]);
+
+	bool found = true;
+	double start = mu_timer_real();
+	for (int i = 0; i < LOOKUPS; i++)
+		found = get(kv, keys[picks[i]]) == keys[picks[i]] && found;
+	double look = mu_timer_real() - start;
+
+	printf("%-16s %9d  lookup %8.4fs  %7.2f M/s\n",
+		name, n, look, look > 0.0 ? LOOKUPS / look / 1e6 : 0.0);
+	free_one(kv);
+	return found;
+}
+
+MU_TEST(test_lookups) {
+	void **ints = malloc(KEYS * sizeof(void *));
+	void **strs = malloc(KEYS * sizeof(void *));
+	char *text = malloc(KEYS * (STRLEN + 1));
+	int *picks = malloc(LOOKUPS * sizeof(int));
+	for (int i = 0; i < KEYS; i++) {
+		ints[i] = (void *)(long)random_between(1, 2000000000);
+		char *s = text + i * (STRLEN + 1);
+		for (int j = 0; j < STRLEN; j++)
+			s[j] = 'a' + random_between(0, 25);
+		s[STRLEN] = '\0';
+		strs[i] = s;
+	}
+
+	int sizes[] = { 10000, KEYS };
+	for (int s = 0; s < 2; s++) {
+		int n = sizes[s];
+		for (int i = 0; i < LOOKUPS; i++)
+			picks[i] = random_between(0, n - 1);
+		printf("\n");
+		mu_should(time_lookups("tree integral", bk_tree, integral, ints, n, picks));
+		mu_should(time_lookups("bplus integral", bk_bplus, integral, ints, n, picks));
+		mu_should(time_lookups("tree string", bk_tree, string, strs, n, picks));
+		mu_should(time_lookups("bplus string", bk_bplus, string, strs, n, picks));
+	}
+
+	free(picks);
+	free(text);
+	free(strs);
+	free(ints);
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval random lookups by key type\n");
+	MU_RUN_TEST(test_lookups);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchkeys.c ends here */
@@ -0,0 +1,169 @@
+/* benchkvmt.c -- timings for a keyval shared by threads -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * read throughput of a keyval shared by threads. readers do random
+ * gets while one writer updates a random key every so often. each
+ * backing is timed two ways: made with make_one_concurrent, where
+ * the readers share a lock, and made plainly with every call behind
+ * one client mutex, which puts the readers in single file.
+ *
+ * the store holds 10^5 keys and each reader does 10^6 gets, with 1,
+ * 2, 4, and 8 readers. the shared lock can only pull ahead when
+ * there are cores for the readers to run on.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+#define KEYS 100000
+#define GETS 1000000
+#define WRITE_EVERY 20000
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+typedef struct reader_arg reader_arg;
+struct reader_arg {
+	one_block *kv;
+	pthread_mutex_t *mutex;    /* NULL for a concurrent store */
+	uint64_t seed;
+	long found;
+};
+
+static
+uint64_t
+next_random(uint64_t *x) {
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+	return *x;
+}
+
+static
+void *
+reader(void *p) {
+	reader_arg *a = p;
+	for (int i = 0; i < GETS; i++) {
+		void *key = (void *)(long)(next_random(&a->seed) % KEYS);
+		if (a->mutex)
+			pthread_mutex_lock(a->mutex);
+		a->found += get(a->kv, key) != NULL;
+		if (a->mutex)
+			pthread_mutex_unlock(a->mutex);
+	}
+	return NULL;
+}
+
+typedef struct writer_arg writer_arg;
+struct writer_arg {
+	one_block *kv;
+	pthread_mutex_t *mutex;
+	volatile bool stop;
+	long writes;
+};
+
+static
+void *
+writer(void *p) {
+	writer_arg *a = p;
+	uint64_t seed = 6803;
+	while (!a->stop) {
+		void *key = (void *)(long)(next_random(&seed) % KEYS);
+		if (a->mutex)
+			pthread_mutex_lock(a->mutex);
+		update(a->kv, key, (void *)(a->writes + 1));
+		if (a->mutex)
+			pthread_mutex_unlock(a->mutex);
+		a->writes += 1;
+		for (volatile int i = 0; i < WRITE_EVERY; i++)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * time `readers` threads against one store. returns the gets per
+ * second, or 0 if a get came back empty.
+ */
+
+static
+double
+time_readers(one_backing backing, bool concurrent, int readers) {
+	one_block *kv = concurrent
+		? make_one_concurrent(keyval, backing, integral, NULL, NULL)
+		: make_one_keyed_backed(keyval, backing, integral, NULL, NULL);
+	for (long k = 0; k < KEYS; k++)
+		insert(kv, (void *)k, (void *)(k + 1));
+
+	pthread_mutex_t mutex;
+	pthread_mutex_init(&mutex, NULL);
+	writer_arg w = { kv, concurrent ? NULL : &mutex, false, 0 };
+	reader_arg r[8];
+	pthread_t rt[8];
+	pthread_t wt;
+
+	double start = mu_timer_real();
+	pthread_create(&wt, NULL, writer, &w);
+	for (int i = 0; i < readers; i++) {
+		r[i] = (reader_arg) { kv, w.mutex, 6803 + i, 0 };
+		pthread_create(&rt[i], NULL, reader, &r[i]);
+	}
+	long found = 0;
+	for (int i = 0; i < readers; i++) {
+		pthread_join(rt[i], NULL);
+		found += r[i].found;
+	}
+	double elapsed = mu_timer_real() - start;
+	w.stop = true;
+	pthread_join(wt, NULL);
+
+	pthread_mutex_destroy(&mutex);
+	free_one(kv);
+	if (found != (long)readers * GETS)
+		return 0.0;
+	return readers * (double)GETS / elapsed;
+}
+
+MU_TEST(test_read_throughput) {
+	const char *names[] = { "tree", "hash", "bplus" };
+	one_backing backings[] = { bk_tree, bk_hash, bk_bplus };
+	printf("\n");
+	for (int b = 0; b < 3; b++)
+		for (int readers = 1; readers <= 8; readers *= 2) {
+			double shared = time_readers(backings[b], true, readers);
+			double mutex = time_readers(backings[b], false, readers);
+			mu_should(shared > 0.0 && mutex > 0.0);
+			printf("%-6s %d readers  shared lock %7.2f M/s  client mutex %7.2f M/s  %5.2fx\n",
+				names[b], readers, shared / 1e6, mutex / 1e6,
+				mutex > 0.0 ? shared / mutex : 0.0);
+		}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval read throughput with threads\n");
+	MU_RUN_TEST(test_read_throughput);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchkvmt.c ends here */
@@ -0,0 +1,94 @@
+/* benchload.c -- timings for loading a keyval -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * compare filling a keyval from sorted keys with load_sorted against
+ * inserting the same keys one at a time in order. the tree and B+
+ * tree backings are run at 10^4, 10^5, and 10^6 keys.
+ *
+ * ascending inserts are the scapegoat tree's worst case, the tree
+ * keeps growing down its right side and rebuilding subtrees. the
+ * rebalance counts are reported for the inserts, the sorted load
+ * never rebalances.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * time one backing at one size. returns false if the two stores
+ * don't hold the same keys.
+ */
+
+static
+bool
+time_load(const char *name, one_backing backing, void **keys, int n) {
+	double start = mu_timer_real();
+	one_block *loaded = make_one_keyed_backed(keyval, backing, integral, NULL, NULL);
+	load_sorted(loaded, keys, keys, n);
+	double bulk = mu_timer_real() - start;
+
+	start = mu_timer_real();
+	one_block *added = make_one_keyed_backed(keyval, backing, integral, NULL, NULL);
+	for (int i = 0; i < n; i++)
+		insert(added, keys[i], keys[i]);
+	double each = mu_timer_real() - start;
+
+	printf("%-8s %8d  load %9.4fs  inserts %9.4fs  %7.1fx",
+		name, n, bulk, each, bulk > 0.0 ? each / bulk : 0.0);
+	if (backing == bk_tree)
+		printf("  rebalances %d/%d", added->u.kvl.full_rebalances,
+			added->u.kvl.partial_rebalances);
+	printf("\n");
+
+	bool same = count(loaded) == n && count(added) == n;
+	for (int i = 0; i < n && same; i += 97)
+		same = get(loaded, keys[i]) == get(added, keys[i]);
+	free_one(added);
+	free_one(loaded);
+	return same;
+}
+
+MU_TEST(test_load_times) {
+	int sizes[] = { 10000, 100000, 1000000 };
+	printf("\n");
+	for (int s = 0; s < 3; s++) {
+		int n = sizes[s];
+		void **keys = malloc(n * sizeof(void *));
+		for (long i = 0; i < n; i++)
+			keys[i] = (void *)(i * 3);
+		mu_should(time_load("tree", bk_tree, keys, n));
+		mu_should(time_load("bplus", bk_bplus, keys, n));
+		free(keys);
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval sorted load timings\n");
+	MU_RUN_TEST(test_load_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchload.c ends here */
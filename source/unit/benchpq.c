@@ -0,0 +1,114 @@
+/* benchpq.c -- timings for building priority queues -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * compare loading a pqueue in bulk via make_one_prioritized against
+ * adding the same pairs one at a time with add_with_priority. each
+ * backing is run at 10^4, 10^5, and 10^6 pairs.
+ *
+ * repeated adds on the linked list backing are quadratic, so they
+ * are only timed at 10^4. the bulk load of the list is timed at every
+ * size.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/rand.h"
+#include "../inc/one.h"
+
+#define RAND_SEED 6803
+
+static
+void
+test_setup(void) {
+	set_random_generator(RAND_DEFAULT);
+	seed_random_generator(RAND_SEED);
+}
+
+static
+void
+test_teardown(void) {
+}
+
+static
+pq_pair *
+random_pairs(int n) {
+	pq_pair *pairs = malloc(n * sizeof(pq_pair));
+	for (long i = 0; i < n; i++) {
+		pairs[i].priority = random_between(0, 999999);
+		pairs[i].item = (void *)(i + 1);
+	}
+	return pairs;
+}
+
+/*
+ * time one backing at one size. returns false if the two queues
+ * don't drain the same.
+ */
+
+static
+bool
+time_build(const char *name, one_backing backing, int n, bool adds) {
+	pq_pair *pairs = random_pairs(n);
+
+	double start = mu_timer_real();
+	one_block *loaded = make_one_prioritized(pqueue, backing, pairs, n);
+	double bulk = mu_timer_real() - start;
+
+	one_block *added = NULL;
+	double each = 0.0;
+	if (adds) {
+		start = mu_timer_real();
+		added = make_one_backed(pqueue, backing);
+		for (int i = 0; i < n; i++)
+			add_with_priority(added, pairs[i].priority, pairs[i].item);
+		each = mu_timer_real() - start;
+	}
+
+	if (adds)
+		printf("%-10s %8d  bulk %9.4fs  adds %9.4fs  %7.1fx\n",
+			name, n, bulk, each, bulk > 0.0 ? each / bulk : 0.0);
+	else
+		printf("%-10s %8d  bulk %9.4fs  adds   (skipped)\n", name, n, bulk);
+
+	/* spot check that the bulk load is a proper queue */
+	bool same = count(loaded) == n;
+	if (added) {
+		for (int i = 0; i < 1000 && same; i++)
+			same = get_max(loaded) == get_max(added);
+		free_one(added);
+	}
+	free_one(loaded);
+	free(pairs);
+	return same;
+}
+
+MU_TEST(test_build_times) {
+	int sizes[] = { 10000, 100000, 1000000 };
+	printf("\n");
+	for (int i = 0; i < 3; i++) {
+		int n = sizes[i];
+		mu_should(time_build("heap", bk_heap, n, true));
+		mu_should(time_build("dual heap", bk_dual_heap, n, true));
+		mu_should(time_build("linked", bk_linked, n, n <= 10000));
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\npriority queue build timings\n");
+	MU_RUN_TEST(test_build_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchpq.c ends here */
@@ -0,0 +1,126 @@
+/* benchring.c -- timings for ring and linked list backings -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * compare throughput of the stack, queue, and deque on the ring
+ * buffer backing against the same types on the linked lists. each
+ * run pushes and pops the same pattern of items, a fill to some depth
+ * followed by steady traffic and a drain.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * one pass of traffic. returns the sum of the items taken out so the
+ * two backings can be checked against each other.
+ */
+
+static
+long
+traffic(one_block *ob, long depth, long ops) {
+	long sum = 0;
+	long i = 1;
+	switch (ob->isa) {
+	case stack:
+		for (; i <= depth; i++)
+			push(ob, (void *)i);
+		for (; i <= depth + ops; i++) {
+			push(ob, (void *)i);
+			sum += (long)pop(ob);
+		}
+		while (!is_empty(ob))
+			sum += (long)pop(ob);
+		break;
+	case queue:
+		for (; i <= depth; i++)
+			enqueue(ob, (void *)i);
+		for (; i <= depth + ops; i++) {
+			enqueue(ob, (void *)i);
+			sum += (long)dequeue(ob);
+		}
+		while (!is_empty(ob))
+			sum += (long)dequeue(ob);
+		break;
+	case deque:
+		for (; i <= depth; i++)
+			push_back(ob, (void *)i);
+		for (; i <= depth + ops; i++) {
+			if (i & 1) {
+				push_front(ob, (void *)i);
+				sum += (long)pop_back(ob);
+			} else {
+				push_back(ob, (void *)i);
+				sum += (long)pop_front(ob);
+			}
+		}
+		while (!is_empty(ob))
+			sum += (long)pop_front(ob);
+		break;
+	default:
+		break;
+	}
+	return sum;
+}
+
+static
+bool
+time_traffic(one_type isa, long depth, long ops) {
+	one_block *ring = make_one_backed(isa, bk_ring);
+	one_block *linked = make_one_backed(isa, bk_linked);
+
+	double start = mu_timer_real();
+	long rsum = traffic(ring, depth, ops);
+	double rtime = mu_timer_real() - start;
+
+	start = mu_timer_real();
+	long lsum = traffic(linked, depth, ops);
+	double ltime = mu_timer_real() - start;
+
+	printf("%-24s %9ld %9ld  ring %8.4fs  linked %8.4fs  %6.1fx\n",
+		ring->tag, depth, ops, rtime, ltime,
+		rtime > 0.0 ? ltime / rtime : 0.0);
+
+	free_one(ring);
+	free_one(linked);
+	return rsum == lsum;
+}
+
+MU_TEST(test_throughput) {
+	one_type types[] = { stack, queue, deque };
+	long depths[] = { 100, 100000, 1000000 };
+	printf("\n%-24s %9s %9s\n", "", "depth", "ops");
+	for (int t = 0; t < 3; t++)
+		for (int d = 0; d < 3; d++)
+			mu_should(time_traffic(types[t], depths[d], 10000000));
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nring buffer and linked list timings\n");
+	MU_RUN_TEST(test_throughput);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchring.c ends here */
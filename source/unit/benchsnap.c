@@ -0,0 +1,116 @@
+/* benchsnap.c -- timings for keyval snapshots -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * what a snapshot of a B+ tree keyval costs. taking one is constant
+ * time, the price is paid by the writer, who copies a path of nodes
+ * the first time it touches them after a snapshot.
+ *
+ * for 10^5 and 10^6 keys, time 10^5 updates with no snapshot held,
+ * then the same updates with a fresh snapshot taken every 100, 1000,
+ * and 10000 updates. a full copy, rebuilt from the sorted keys, is
+ * timed for comparison.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "minunit.h"
+#include "../inc/rand.h"
+#include "../inc/one.h"
+
+#define RAND_SEED 6803
+#define UPDATES 100000
+
+static
+void
+test_setup(void) {
+	set_random_generator(RAND_DEFAULT);
+	seed_random_generator(RAND_SEED);
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * run the updates, taking a snapshot every `every` of them, 0 for
+ * never. only the latest snapshot is held. returns the time taken.
+ */
+
+static
+double
+time_updates(one_block *kv, int n, int every) {
+	one_block *held = NULL;
+	double start = mu_timer_real();
+	for (int i = 0; i < UPDATES; i++) {
+		if (every && i % every == 0) {
+			if (held)
+				free_one(held);
+			held = snapshot(kv);
+		}
+		update(kv, (void *)(long)random_between(0, n - 1), (void *)(long)i);
+	}
+	double elapsed = mu_timer_real() - start;
+	if (held)
+		free_one(held);
+	return elapsed;
+}
+
+static
+bool
+time_size(int n) {
+	one_block *kv = make_one_keyed_backed(keyval, bk_bplus, integral, NULL, NULL);
+	void **keys = malloc(n * sizeof(void *));
+	for (long i = 0; i < n; i++)
+		keys[i] = (void *)i;
+	load_sorted(kv, keys, keys, n);
+
+	double start = mu_timer_real();
+	one_block *snap = snapshot(kv);
+	double take = mu_timer_real() - start;
+	free_one(snap);
+
+	start = mu_timer_real();
+	one_block *copy = make_one_keyed_backed(keyval, bk_bplus, integral, NULL, NULL);
+	load_sorted(copy, keys, keys, n);
+	double full = mu_timer_real() - start;
+	free_one(copy);
+
+	printf("%8d keys  snapshot %10.7fs  full copy %8.4fs\n", n, take, full);
+	double plain = time_updates(kv, n, 0);
+	printf("%8d keys  %d updates, no snapshots      %8.4fs\n", n, UPDATES, plain);
+	int everies[] = { 10000, 1000, 100 };
+	for (int i = 0; i < 3; i++)
+		printf("%8d keys  %d updates, snapshot per %5d %8.4fs\n",
+			n, UPDATES, everies[i], time_updates(kv, n, everies[i]));
+
+	bool same = count(kv) == n;
+	free_one(kv);
+	free(keys);
+	return same;
+}
+
+MU_TEST(test_snapshot_times) {
+	printf("\n");
+	mu_should(time_size(100000));
+	mu_should(time_size(1000000));
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nkeyval snapshot timings\n");
+	MU_RUN_TEST(test_snapshot_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchsnap.c ends here */
@@ -0,0 +1,176 @@
+/* benchws.c -- timings for a work stealing sum -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+/*
+ * sum an array of 2^23 longs fork-join style. each worker owns a
+ * wsdeque. a worker takes a range, and while it is bigger than the
+ * grain splits it, pushing the upper half for later and carrying on
+ * with the lower. when its own deque runs dry it steals from another
+ * worker's.
+ *
+ * the sum is timed with 1, 2, 4, and 8 workers against a plain loop.
+ * the workers can only pull ahead of the loop when there are cores
+ * for them to run on, on one core this times the overhead of
+ * splitting and stealing.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "minunit.h"
+#include "../inc/one.h"
+
+#define NUMBERS (1L << 23)
+#define GRAIN 4096
+#define MAX_WORKERS 8
+#define PASSES 5
+
+static long *numbers;
+
+static
+void
+test_setup(void) {
+	numbers = malloc(NUMBERS * sizeof(long));
+	for (long i = 0; i < NUMBERS; i++)
+		numbers[i] = i % 1000;
+}
+
+static
+void
+test_teardown(void) {
+	free(numbers);
+}
+
+/*
+ * a range travels as one pointer, the low end in the upper half and
+ * the high end in the lower. the high end is never zero, so neither
+ * is the pointer.
+ */
+
+static
+void *
+as_task(long lo, long hi) {
+	return (void *)(uintptr_t)((uint64_t)lo << 32 | (uint64_t)hi);
+}
+
+typedef struct worker_arg worker_arg;
+struct worker_arg {
+	one_block **deques;
+	int id;
+	int workers;
+	atomic_long *left;
+	uint64_t seed;
+	long sum;
+	long steals;
+};
+
+static
+void *
+worker(void *p) {
+	worker_arg *a = p;
+	one_block *own = a->deques[a->id];
+	while (atomic_load_explicit(a->left, memory_order_relaxed) > 0) {
+		void *task = pop(own);
+		if (!task && a->workers > 1) {
+			a->seed ^= a->seed << 13;
+			a->seed ^= a->seed >> 7;
+			a->seed ^= a->seed << 17;
+			int victim = a->seed % (a->workers - 1);
+			victim += victim >= a->id;
+			task = steal(a->deques[victim]);
+			a->steals += task != NULL;
+		}
+		if (!task) {
+			sched_yield();
+			continue;
+		}
+		long lo = (uint64_t)(uintptr_t)task >> 32;
+		long hi = (uint64_t)(uintptr_t)task & 0xffffffff;
+		while (hi - lo > GRAIN) {
+			long mid = lo + (hi - lo) / 2;
+			push(own, as_task(mid, hi));
+			hi = mid;
+		}
+		long sum = 0;
+		for (long i = lo; i < hi; i++)
+			sum += numbers[i];
+		a->sum += sum;
+		atomic_fetch_sub(a->left, hi - lo);
+	}
+	return NULL;
+}
+
+static
+long
+parallel_sum(int workers, long *steals) {
+	one_block *deques[MAX_WORKERS];
+	worker_arg args[MAX_WORKERS] = { 0 };
+	pthread_t threads[MAX_WORKERS];
+	atomic_long left;
+	atomic_init(&left, NUMBERS);
+	for (int w = 0; w < workers; w++) {
+		deques[w] = make_one(wsdeque);
+		args[w].deques = deques;
+		args[w].id = w;
+		args[w].workers = workers;
+		args[w].left = &left;
+		args[w].seed = 6803 + w;
+	}
+	push(deques[0], as_task(0, NUMBERS));
+	for (int w = 0; w < workers; w++)
+		pthread_create(&threads[w], NULL, worker, &args[w]);
+	long sum = 0;
+	for (int w = 0; w < workers; w++) {
+		pthread_join(threads[w], NULL);
+		sum += args[w].sum;
+		*steals += args[w].steals;
+		free_one(deques[w]);
+	}
+	return sum;
+}
+
+MU_TEST(test_sum_times) {
+	double start = mu_timer_real();
+	long want = 0;
+	for (int pass = 0; pass < PASSES; pass++) {
+		long sum = 0;
+		for (long i = 0; i < NUMBERS; i++)
+			sum += numbers[i];
+		want = sum;
+	}
+	double loop = (mu_timer_real() - start) / PASSES;
+	printf("\nloop          %8.4fs\n", loop);
+
+	for (int workers = 1; workers <= MAX_WORKERS; workers *= 2) {
+		long steals = 0;
+		bool ok = true;
+		start = mu_timer_real();
+		for (int pass = 0; pass < PASSES; pass++)
+			ok = ok && parallel_sum(workers, &steals) == want;
+		double elapsed = (mu_timer_real() - start) / PASSES;
+		mu_should(ok);
+		printf("%d workers     %8.4fs  %5.2fx  %6ld steals\n",
+			workers, elapsed, loop / elapsed, steals / PASSES);
+	}
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	printf("\n\nwork stealing sum timings\n");
+	MU_RUN_TEST(test_sum_times);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* benchws.c ends here */
@@ -158,6 +158,144 @@ MU_TEST(test_iterator) {
 	mu_shouldnt(xs);
 }
 
+/*
+ * bulk appends. append_n copies a whole array in, extend and append
+ * copy another list in. growth may hand back a new handle just as
+ * cons does.
+ */
+
+MU_TEST(test_append_n) {
+	uintptr_t batch[3000];
+	for (int i = 0; i < 3000; i++)
+		batch[i] = i + 1;
+
+	one_block *xs = make_one(alist);
+	xs = cons(xs, 99);
+	xs = append_n(xs, batch, 3000);
+	mu_should(xs);
+	mu_should(count(xs) == 3001);
+	mu_should(xs->u.acc.capacity >= 3001);
+	mu_should(nth(xs, 0) == 99);
+	bool same = true;
+	for (int i = 0; i < 3000; i++)
+		same = same && nth(xs, i + 1) == batch[i];
+	mu_should(same);
+
+	/* nothing to add is fine */
+	mu_should(append_n(xs, NULL, 0) == xs);
+	mu_shouldnt(append_n(xs, batch, -1));
+
+	/* the list can be appended to itself */
+	xs = extend(xs, xs);
+	mu_should(count(xs) == 6002);
+	mu_should(nth(xs, 3001) == 99);
+	mu_should(nth(xs, 6001) == 3000);
+	xs = free_one(xs);
+	mu_shouldnt(xs);
+}
+
+MU_TEST(test_extend) {
+	one_block *xs = make_one(alist);
+	one_block *ys = make_one(alist);
+	for (int i = 0; i < 10; i++) {
+		xs = cons(xs, i);
+		ys = cons(ys, 100 + i);
+	}
+
+	/* append doesn't add anything extra */
+	xs = append(xs, ys);
+	mu_should(count(xs) == 20);
+	mu_should(nth(xs, 10) == 100);
+	mu_should(nth(xs, 19) == 109);
+	mu_should(count(ys) == 10);
+
+	/* extend from a dynarray takes every slot through the high
+	 * index, empty or not */
+	one_block *da = make_one(dynarray);
+	put_at(da, (void *)7, 0);
+	put_at(da, (void *)9, 2);
+	xs = extend(xs, da);
+	mu_should(count(xs) == 23);
+	mu_should(nth(xs, 20) == 7);
+	mu_should(nth(xs, 21) == 0);
+	mu_should(nth(xs, 22) == 9);
+
+	/* and the other way */
+	da = extend(da, ys);
+	mu_should(high_index(da) == 12);
+	mu_should(get_from(da, 3) == (void *)100);
+	mu_should(get_from(da, 12) == (void *)109);
+
+	one_block *st = make_one(stack);
+	mu_shouldnt(extend(xs, st));
+	free_one(st);
+	free_one(da);
+	free_one(xs);
+	free_one(ys);
+}
+
+/*
+ * a stable list grows without changing its handle, and lists sliced
+ * from it inherit the mode.
+ */
+
+MU_TEST(test_stable_handle) {
+	one_block *xs = stable_handle(make_one(alist), true);
+	one_block *first = xs;
+	int cap = xs->u.acc.capacity;
+	for (int i = 0; i < cap * 5; i++)
+		xs = cons(xs, i);
+	mu_should(xs == first);
+	mu_should(xs->u.acc.capacity >= cap * 5);
+	mu_should(count(xs) == cap * 5);
+	mu_should(nth(xs, 0) == 0);
+	mu_should(nth(xs, cap * 5 - 1) == cap * 5 - 1);
+
+	/* an empty stable list is filled in place on append */
+	one_block *ys = stable_handle(make_one(alist), true);
+	one_block *zs = append(ys, xs);
+	mu_should(zs == ys);
+	mu_should(count(ys) == cap * 5);
+
+	one_block *ws = cdr(xs);
+	mu_should(ws->u.acc.stable);
+	mu_should(count(ws) == cap * 5 - 1);
+
+	/* switching back restores the copy on growth behavior */
+	stable_handle(ws, false);
+	int n = ws->u.acc.capacity - ws->u.acc.used + 1;
+	one_block *vs = append_n(ws, xs->u.acc.list, n);
+	mu_should(vs != ws);
+	mu_should(count(vs) == cap * 5 - 1 + n);
+
+	one_block *st = make_one(stack);
+	mu_shouldnt(stable_handle(st, true));
+	free_one(st);
+	free_one(vs);
+	free_one(ys);
+	free_one(xs);
+}
+
+/*
+ * when a list can't grow the append fails and the list passed in is
+ * left as it was, stable or not.
+ */
+
+MU_TEST(test_grow_failure) {
+	uintptr_t batch[4] = { 1, 2, 3, 4 };
+	for (int stable = 0; stable < 2; stable++) {
+		one_block *xs = stable_handle(make_one(alist), stable);
+		xs = append_n(xs, batch, 4);
+		int cap = xs->u.acc.capacity;
+		mu_shouldnt(append_n(xs, batch, 1 << 30));
+		mu_should(count(xs) == 4);
+		mu_should(xs->u.acc.capacity == cap);
+		xs = cons(xs, 5);
+		mu_should(xs && count(xs) == 5 && nth(xs, 4) == 5);
+		free_one(xs);
+	}
+}
+
 /*
  * a test suite is made up of tests.
  */
@@ -171,6 +309,10 @@ MU_TEST_SUITE(test_suite) {
 	MU_RUN_TEST(test_add_three);
 	MU_RUN_TEST(test_expansion);
 	MU_RUN_TEST(test_iterator);
+	MU_RUN_TEST(test_append_n);
+	MU_RUN_TEST(test_extend);
+	MU_RUN_TEST(test_stable_handle);
+	MU_RUN_TEST(test_grow_failure);
 }
 
 /*
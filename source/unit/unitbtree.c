@@ -599,6 +599,35 @@ MU_TEST(test_volume) {
 	free_one(t);
 }
 
+/**
+ * test_sorted_inserts
+ *
+ * keys inserted in order, up or down, keep running into the depth
+ * limit. rebuilding the scapegoat pulls the path back under it, so
+ * the newest key stays within alpha * log2(N) and many inserts don't
+ * rebuild anything. rebuilding the scapegoat's heavy child instead
+ * left the path too long, and nearly every insert rebuilt a subtree.
+ */
+
+MU_TEST(test_sorted_inserts) {
+	for (int down = 0; down < 2; down++) {
+		one_block *t = make_one_keyed(keyval, integral, NULL);
+		for (long i = 1; i <= 5000; i++)
+			insert(t, as_key(down ? 5001 - i : i), "sorted");
+		int deep = btree_height_for_key(&t->u.kvl, as_key(down ? 1 : 5000));
+		fprintf(stderr, "%s: %d partial %d full rebalances, %d deep\n",
+			down ? "descending" : "ascending",
+			t->u.kvl.partial_rebalances, t->u.kvl.full_rebalances, deep);
+		int log2n = 0;
+		while ((2 << log2n) <= 5000)
+			log2n += 1;
+		mu_should(count(t) == 5000);
+		mu_should(deep <= t->u.kvl.policy.alpha * log2n);
+		mu_should(t->u.kvl.partial_rebalances < 4000);
+		free_one(t);
+	}
+}
+
 /**
  * these are run before and after every test function above.
  */
@@ -632,6 +661,7 @@ MU_TEST_SUITE(test_suite) {
 
 	MU_RUN_TEST(test_simple_rebalance);
 	MU_RUN_TEST(test_rebalance_deleted_root);
+	MU_RUN_TEST(test_sorted_inserts);
 
 	MU_RUN_TEST(test_traversal_deletes);
 
@@ -2,6 +2,7 @@
 
 /* released to the public domain, troy brumley, may 2024 */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "minunit.h"
@@ -64,6 +65,94 @@ MU_TEST(test_da) {
 	free_one(da);
 }
 
+/*
+ * growth goes straight to the power of two that holds the index,
+ * reserve does the same ahead of time, and shrink_to_fit trims to the
+ * high index. contents survive all of them.
+ */
+
+MU_TEST(test_reserve_shrink) {
+	one_block *da = make_one(dynarray);
+	int cap = da->u.dyn.capacity;
+
+	/* one far put is one growth */
+	put_at(da, (void *)7L, 100000);
+	mu_should(da->u.dyn.capacity == 131072);
+	mu_should(high_index(da) == 100000);
+	mu_should(get_from(da, 100000) == (void *)7L);
+	mu_shouldnt(get_from(da, 99999));
+	mu_shouldnt(get_from(da, cap));
+
+	/* reserve never shrinks, and rounds up */
+	mu_should(reserve(da, 10) == da);
+	mu_should(da->u.dyn.capacity == 131072);
+	mu_should(reserve(da, 200000) == da);
+	mu_should(da->u.dyn.capacity == 262144);
+	mu_shouldnt(reserve(da, -1));
+
+	/* shrink to the high index */
+	for (long i = 0; i < 1000; i++)
+		put_at(da, (void *)(i + 1), (int)i);
+	mu_should(shrink_to_fit(da) == da);
+	mu_should(da->u.dyn.capacity == 100001);
+	bool same = get_from(da, 100000) == (void *)7L;
+	for (long i = 0; i < 1000; i++)
+		same = same && get_from(da, (int)i) == (void *)(i + 1);
+	mu_should(same);
+
+	/* and grow again, new slots are empty */
+	put_at(da, (void *)8L, 100001);
+	mu_should(da->u.dyn.capacity == 131072);
+	mu_should(get_from(da, 100001) == (void *)8L);
+	mu_should(get_from(da, 100000) == (void *)7L);
+	free_one(da);
+
+	/* an empty array keeps one slot */
+	da = make_one(dynarray);
+	shrink_to_fit(da);
+	mu_should(da->u.dyn.capacity == 1);
+	put_at(da, (void *)1L, 2);
+	mu_should(da->u.dyn.capacity == 4);
+	mu_should(get_from(da, 2) == (void *)1L);
+	mu_shouldnt(get_from(da, 1));
+	free_one(da);
+
+	da = make_one(stack);
+	mu_shouldnt(reserve(da, 10));
+	free_one(da);
+}
+
+/*
+ * append_n adds after the high index in one step.
+ */
+
+MU_TEST(test_append_n) {
+	one_block *da = make_one(dynarray);
+	void *batch[5000];
+	for (long i = 0; i < 5000; i++)
+		batch[i] = (void *)(i + 1);
+
+	mu_should(append_n(da, batch, 5000) == da);
+	mu_should(high_index(da) == 4999);
+	mu_should(da->u.dyn.capacity == 8192);
+	put_at(da, (void *)1L, 5001);
+	mu_should(append_n(da, batch, 10) == da);
+	mu_should(high_index(da) == 5011);
+	mu_shouldnt(get_from(da, 5000));
+	mu_should(get_from(da, 5002) == (void *)1L);
+	bool same = true;
+	for (int i = 0; i < 5000; i++)
+		same = same && get_from(da, i) == batch[i];
+	mu_should(same);
+
+	/* extend from itself, growing as it goes */
+	mu_should(extend(da, da) == da);
+	mu_should(high_index(da) == 10023);
+	mu_should(get_from(da, 5012) == (void *)1L);
+	mu_should(get_from(da, 10023) == (void *)10L);
+	free_one(da);
+}
+
 /*
  * master control:
  */
@@ -73,6 +162,8 @@ MU_TEST_SUITE(test_suite) {
 	MU_SUITE_CONFIGURE(test_setup, test_teardown);
 
 	MU_RUN_TEST(test_da);
+	MU_RUN_TEST(test_reserve_shrink);
+	MU_RUN_TEST(test_append_n);
 }
 
 int
@@ -2,8 +2,11 @@
 
 /* released to the public domain, troy brumley, may 2024 */
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "minunit.h"
 #include "../inc/alloc.h"
@@ -450,6 +453,1438 @@ MU_TEST(test_string_keys) {
 	free_one(kv);
 }
 
+/*
+ * keys that differ by more than an int can hold, and string keys
+ * that share their first eight bytes or sort on a byte above 127,
+ * must still order as the comparators say.
+ */
+
+static
+int
+str_order(const void *a, const void *b) {
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+MU_TEST(test_key_order) {
+	long wide[] = { 1L << 40, -(1L << 40), 0, 1, -1, 1L << 32, 3L << 31, -(3L << 31) };
+	int nw = sizeof(wide) / sizeof(wide[0]);
+	long sorted[] = { -(1L << 40), -(3L << 31), -1, 0, 1, 1L << 32, 3L << 31, 1L << 40 };
+	one_backing backings[] = { bk_tree, bk_hash, bk_bplus };
+	for (int b = 0; b < 3; b++) {
+		one_block *kv = make_one_keyed_backed(keyval, backings[b], integral, NULL, NULL);
+		for (int i = 0; i < nw; i++)
+			insert(kv, as_key(wide[i]), as_key(i));
+		one_block *ks = sorted_keys(kv);
+		int wrong = count(ks) != nw;
+		for (int i = 0; i < count(ks); i++)
+			wrong += nth(ks, i) != (uintptr_t)sorted[i];
+		for (int i = 0; i < nw; i++)
+			wrong += get(kv, as_key(wide[i])) != as_key(i);
+		mu_should(wrong == 0);
+		free_one(ks);
+		free_one(kv);
+	}
+
+	char *strs[] = {
+		"abcdefgh", "abcdefghi", "abcdefgha", "abcdefg", "abcdefgz", "",
+		"abcdefgh\xff", "abcdefg\xff", "\xff", "zzzzzzzzzzzz", "a", "abcdefghij",
+		"abcdefgg", "abcdefgi", "b"
+	};
+	int ns = sizeof(strs) / sizeof(strs[0]);
+	char *expect[sizeof(strs) / sizeof(strs[0])];
+	memcpy(expect, strs, sizeof(strs));
+	qsort(expect, ns, sizeof(char *), str_order);
+	for (int b = 0; b < 3; b += 2) {
+		one_block *kv = make_one_keyed_backed(keyval, backings[b], string, NULL, NULL);
+		for (int i = 0; i < ns; i++)
+			mu_should(insert(kv, strs[i], as_key(i)));
+		int wrong = 0;
+		int i = 0;
+		one_cursor c;
+		for (begin(kv, &c); !done(&c); next(&c), i++)
+			wrong += i >= ns || strcmp(c.key, expect[i]) != 0;
+		wrong += i != ns;
+		for (i = 0; i < ns; i++) {
+			/* a copy, so equal keys aren't just equal pointers */
+			char copy[16];
+			strcpy(copy, strs[i]);
+			wrong += get(kv, copy) != as_key(i);
+			wrong += insert(kv, copy, NULL);
+		}
+		mu_should(wrong == 0);
+		mu_should(strcmp(floor_key(kv, "abcdefgh\x01"), "abcdefgh") == 0);
+		mu_should(strcmp(ceiling_key(kv, "abcdefgh\x01"), "abcdefgha") == 0);
+		free_one(kv);
+	}
+}
+
+/*
+ * the hash table backing. the same api should behave the same as
+ * the tree, other than the order of keys and values.
+ */
+
+MU_TEST(test_hash_create) {
+	one_block *kv = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	mu_should(kv);
+	mu_should(kv->backing == bk_hash);
+	mu_should(is_empty(kv));
+	mu_should(count(kv) == 0);
+	mu_shouldnt(get(kv, as_key(1)));
+	mu_shouldnt(exists(kv, as_key(1)));
+	free_one(kv);
+
+	/* the default backing is the tree */
+	kv = make_one_keyed_backed(keyval, bk_default, integral, NULL, NULL);
+	mu_should(kv->backing == bk_tree);
+	free_one(kv);
+
+	/* and there is no heap backed keyval */
+	mu_shouldnt(make_one_keyed_backed(keyval, bk_heap, integral, NULL, NULL));
+}
+
+MU_TEST(test_hash_basics) {
+	one_block *kv = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	int i = 0;
+	while (int_keyed[i][0] != -1) {
+		mu_should(insert(kv, as_key(int_keyed[i][0]), &int_keyed[i][1]));
+		i += 1;
+	}
+	mu_should(count(kv) == 10);
+	mu_shouldnt(is_empty(kv));
+
+	/* no duplicate keys */
+	mu_shouldnt(insert(kv, as_key(3), &int_keyed[9][1]));
+	mu_should(count(kv) == 10);
+
+	/* key 0 is a key like any other */
+	mu_should(exists(kv, as_key(0)));
+	mu_should(*(int *)get(kv, as_key(0)) == 0);
+
+	/* update only works for existing keys */
+	mu_should(update(kv, as_key(4), &int_keyed[9][1]));
+	mu_should(*(int *)get(kv, as_key(4)) == 9);
+	mu_shouldnt(update(kv, as_key(101), &int_keyed[9][1]));
+
+	/* delete and delete again */
+	mu_should(delete (kv, as_key(8)));
+	mu_should(count(kv) == 9);
+	mu_shouldnt(exists(kv, as_key(8)));
+	mu_shouldnt(get(kv, as_key(8)));
+	mu_shouldnt(delete (kv, as_key(8)));
+	mu_should(get(kv, as_key(2)));
+	mu_should(get(kv, as_key(9)));
+
+	/* and reinsert */
+	mu_should(insert(kv, as_key(8), &int_keyed[8][1]));
+	mu_should(*(int *)get(kv, as_key(8)) == 8);
+
+	/* unlike the tree, a hash table can be purged */
+	mu_should(purge(kv) == 10);
+	mu_should(is_empty(kv));
+	mu_shouldnt(get(kv, as_key(2)));
+
+	/* there is no order to traverse */
+	mu_should(in_order_keyed(kv, NULL, NULL) == -1);
+	free_one(kv);
+}
+
+MU_TEST(test_hash_string_keys) {
+	one_block *kv = make_one_keyed_backed(keyval, bk_hash, string, NULL, NULL);
+	int i = 0;
+	while (str_keyed[i].key) {
+		insert(kv, str_keyed[i].key, &str_keyed[i].value);
+		i += 1;
+	}
+	mu_should(count(kv) == 6);
+
+	/* keys are compared by content, not by address */
+	char buffer[16];
+	strcpy(buffer, "charlie");
+	mu_should(*(int *)get(kv, buffer) == 17);
+	strcpy(buffer, "delta");
+	mu_should(delete (kv, buffer));
+	mu_shouldnt(exists(kv, "delta"));
+	mu_should(count(kv) == 5);
+
+	one_block *kl = sorted_keys(kv);
+	mu_should(count(kl) == 5);
+	mu_should(strcmp((char *)nth(kl, 0), "alpha") == 0);
+	mu_should(strcmp((char *)nth(kl, 2), "charlie") == 0);
+	mu_should(strcmp((char *)nth(kl, 4), "foxtrot") == 0);
+	free_one(kl);
+	free_one(kv);
+}
+
+/*
+ * a deliberately poor hash, every key lands in one of four buckets, so
+ * deletes have long probe runs to repair.
+ */
+
+typedef struct pair_key pair_key;
+struct pair_key {
+	int major;
+	int minor;
+};
+
+static
+int
+pair_cmp(const void *left, const void *right) {
+	const pair_key *l = left;
+	const pair_key *r = right;
+	if (l->major != r->major)
+		return l->major < r->major ? -1 : 1;
+	if (l->minor != r->minor)
+		return l->minor < r->minor ? -1 : 1;
+	return 0;
+}
+
+static
+uint64_t
+pair_hash(const void *key) {
+	const pair_key *k = key;
+	return (uint64_t)(k->major + k->minor) & 3;
+}
+
+MU_TEST(test_hash_custom_keys) {
+	/* custom keys need both functions for a hash */
+	mu_shouldnt(make_one_keyed_backed(keyval, bk_hash, custom, pair_cmp, NULL));
+	mu_shouldnt(make_one_keyed_backed(keyval, bk_hash, custom, NULL, pair_hash));
+
+	one_block *kv = make_one_keyed_backed(keyval, bk_hash, custom, pair_cmp,
+			pair_hash);
+	mu_should(kv);
+	pair_key pk[200];
+	for (int i = 0; i < 200; i++) {
+		pk[i].major = i / 10;
+		pk[i].minor = i % 10;
+		mu_should(insert(kv, &pk[i], as_key(i + 1)));
+	}
+	mu_should(count(kv) == 200);
+
+	/* delete every third key, the rest must still be reachable */
+	for (int i = 0; i < 200; i += 3)
+		mu_should(delete (kv, &pk[i]));
+	bool found = true;
+	for (int i = 0; i < 200; i++) {
+		pair_key probe = { i / 10, i % 10 };
+		if (i % 3 == 0)
+			found = found && !exists(kv, &probe);
+		else
+			found = found && get(kv, &probe) == as_key(i + 1);
+	}
+	mu_should(found);
+	mu_should(count(kv) == 133);
+
+	one_block *kl = sorted_keys(kv);
+	bool ordered = count(kl) == 133;
+	for (int i = 1; i < count(kl) && ordered; i++)
+		ordered = pair_cmp((void *)nth(kl, i - 1), (void *)nth(kl, i)) < 0;
+	mu_should(ordered);
+	free_one(kl);
+	free_one(kv);
+}
+
+/*
+ * random inserts, updates, and deletes against both backings. the
+ * results and the final contents should agree.
+ */
+
+MU_TEST(test_hash_matches_tree) {
+	one_block *tree = make_one_keyed(keyval, integral, NULL);
+	one_block *hash = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	int mismatches = 0;
+	for (int i = 0; i < 20000; i++) {
+		long k = random_between(1, 5000);
+		long v = random_between(1, 1000000);
+		switch (random_between(1, 4)) {
+		case 1:
+		case 2:
+			if (insert(tree, as_key(k), as_key(v)) != insert(hash, as_key(k), as_key(v)))
+				mismatches += 1;
+			break;
+		case 3:
+			if (exists(tree, as_key(k)) != exists(hash, as_key(k)))
+				mismatches += 1;
+			else if (exists(tree, as_key(k))
+				&& update(tree, as_key(k), as_key(v)) != update(hash, as_key(k), as_key(v)))
+				mismatches += 1;
+			break;
+		case 4:
+			/* the tree doesn't like deleting a missing key */
+			if (exists(tree, as_key(k)) != exists(hash, as_key(k)))
+				mismatches += 1;
+			else if (exists(tree, as_key(k))
+				&& delete (tree, as_key(k)) != delete (hash, as_key(k)))
+				mismatches += 1;
+			break;
+		}
+	}
+	mu_should(mismatches == 0);
+	mu_should(count(tree) == count(hash));
+
+	one_block *tk = keys(tree);
+	one_block *hk = sorted_keys(hash);
+	mu_should(count(tk) == count(hk));
+	for (int i = 0; i < count(tk) && mismatches == 0; i++) {
+		if (nth(tk, i) != nth(hk, i)
+			|| get(tree, (void *)nth(tk, i)) != get(hash, (void *)nth(hk, i)))
+			mismatches += 1;
+	}
+	mu_should(mismatches == 0);
+
+	/* keys and values come back in the same order */
+	one_block *uk = keys(hash);
+	one_block *uv = values(hash);
+	for (int i = 0; i < count(uk); i++)
+		if (get(hash, (void *)nth(uk, i)) != (void *)nth(uv, i))
+			mismatches += 1;
+	mu_should(mismatches == 0);
+
+	free_one(tk);
+	free_one(hk);
+	free_one(uk);
+	free_one(uv);
+	free_one(tree);
+	free_one(hash);
+}
+
+/*
+ * a cursor walks the tree in key order, skipping deleted keys, and
+ * matches keys and values. the same churn as above leaves deleted
+ * nodes and partially rebalanced subtrees behind.
+ */
+
+MU_TEST(test_cursor) {
+	one_block *tree = make_one_keyed(keyval, integral, NULL);
+	one_block *hash = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	one_cursor c;
+
+	mu_should(begin(tree, &c) == &c);
+	mu_should(done(&c));
+	mu_should(begin(hash, &c) == &c);
+	mu_should(done(&c));
+
+	for (int i = 0; i < 20000; i++) {
+		long k = random_between(1, 5000);
+		if (random_between(1, 4) < 4) {
+			insert(tree, as_key(k), as_key(k * 2));
+			insert(hash, as_key(k), as_key(k * 2));
+		} else if (exists(tree, as_key(k))) {
+			delete (tree, as_key(k));
+			delete (hash, as_key(k));
+		}
+	}
+	mu_should(tree->u.kvl.marked_deleted > 0);
+
+	one_block *tk = keys(tree);
+	int i = 0;
+	int mismatches = 0;
+	for (begin(tree, &c); !done(&c); next(&c)) {
+		if (i >= count(tk) || c.key != (void *)nth(tk, i)
+			|| c.item != (void *)((long)c.key * 2))
+			mismatches += 1;
+		i += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_should(i == count(tree));
+
+	/* a hash table walk sees every key once */
+	i = 0;
+	for (begin(hash, &c); !done(&c); next(&c)) {
+		if (get(tree, c.key) != c.item)
+			mismatches += 1;
+		i += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_should(i == count(hash));
+
+	/* a finished cursor stays finished */
+	mu_should(next(&c) == &c);
+	mu_should(done(&c));
+
+	free_one(tk);
+	free_one(tree);
+	free_one(hash);
+}
+
+/*
+ * ordered lookups checked against a plain array of which keys are
+ * live. keys are multiples of ten so there are gaps to land in.
+ */
+
+static
+bool
+range_cb(void *key, void *value, void *context, one_tree *self) {
+	long *acc = context;
+	acc[0] += 1;
+	acc[1] += (long)key;
+	return acc[2] == 0 || acc[0] < acc[2];
+}
+
+MU_TEST(test_range) {
+	one_block *kv = make_one_keyed(keyval, integral, NULL);
+	bool live[101] = { false };
+	one_cursor c;
+
+	mu_should(first_key(kv) == NULL);
+	mu_should(lower_bound(kv, as_key(5), &c) == &c);
+	mu_should(done(&c));
+
+	for (int i = 1; i <= 100; i++) {
+		long k = random_between(1, 100);
+		insert(kv, as_key(k * 10), as_key(k));
+		live[k] = true;
+	}
+	for (int i = 1; i <= 30; i++) {
+		long k = random_between(1, 100);
+		if (live[k]) {
+			delete (kv, as_key(k * 10));
+			live[k] = false;
+		}
+	}
+
+	int lo = 1;
+	while (!live[lo])
+		lo += 1;
+	int hi = 100;
+	while (!live[hi])
+		hi -= 1;
+	mu_should(first_key(kv) == as_key(lo * 10));
+	mu_should(last_key(kv) == as_key(hi * 10));
+
+	int mismatches = 0;
+	for (long q = 0; q <= 1015; q += 5) {
+		/* floor, ceiling, and the bounds the hard way */
+		long fl = 0, ce = 0, lb = 0, ub = 0;
+		for (long k = 100; k >= 1; k--)
+			if (live[k] && k * 10 <= q) {
+				fl = k * 10;
+				break;
+			}
+		for (long k = 1; k <= 100; k++)
+			if (live[k] && k * 10 >= q) {
+				ce = lb = k * 10;
+				break;
+			}
+		for (long k = 1; k <= 100; k++)
+			if (live[k] && k * 10 > q) {
+				ub = k * 10;
+				break;
+			}
+		if (floor_key(kv, as_key(q)) != as_key(fl)
+			|| ceiling_key(kv, as_key(q)) != as_key(ce))
+			mismatches += 1;
+		lower_bound(kv, as_key(q), &c);
+		if ((long)(done(&c) ? 0 : c.key) != lb)
+			mismatches += 1;
+		upper_bound(kv, as_key(q), &c);
+		if ((long)(done(&c) ? 0 : c.key) != ub)
+			mismatches += 1;
+		if (!done(&c) && c.item != as_key(ub / 10))
+			mismatches += 1;
+	}
+	mu_should(mismatches == 0);
+
+	/* a window, and stopping early */
+	long acc[3] = { 0, 0, 0 };
+	long n = 0, sum = 0;
+	for (long k = 25; k <= 75; k++)
+		if (live[k]) {
+			n += 1;
+			sum += k * 10;
+		}
+	mu_should(range(kv, as_key(245), as_key(750), acc, range_cb) == n);
+	mu_should(acc[0] == n && acc[1] == sum);
+	acc[0] = acc[1] = 0;
+	acc[2] = 3;
+	mu_should(range(kv, as_key(0), as_key(2000), acc, range_cb) == 3);
+	mu_should(range(kv, as_key(2000), as_key(3000), acc, range_cb) == 0);
+
+	/* a scan from a lower bound */
+	n = 0;
+	for (lower_bound(kv, as_key(500), &c); !done(&c); next(&c))
+		n += 1;
+	long expect = 0;
+	for (long k = 50; k <= 100; k++)
+		expect += live[k];
+	mu_should(n == expect);
+
+	one_block *hash = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	mu_should(range(hash, as_key(0), as_key(10), acc, range_cb) == -1);
+	mu_shouldnt(lower_bound(hash, as_key(0), &c));
+	mu_should(done(&c));
+	mu_shouldnt(first_key(hash));
+	free_one(hash);
+	free_one(kv);
+}
+
+/*
+ * check the shape of a B+ tree with integral keys, returning the
+ * number of problems. keys under a node must sit in [lo, hi), every
+ * node but the root must be at least half full, and every leaf must
+ * be at the same depth.
+ */
+
+static
+int
+bad_bplus(bp_node *n, long lo, long hi, int depth, int *leaf_depth, bool root) {
+	int bad = 0;
+	if (!root && n->count < (ONE_BPLUS_KEYS - 1) / 2)
+		bad += 1;
+	for (int i = 0; i < n->count; i++) {
+		long k = (long)n->key[i];
+		if (k < lo || k >= hi || (i > 0 && k <= (long)n->key[i - 1]))
+			bad += 1;
+	}
+	if (n->leaf) {
+		if (*leaf_depth == 0)
+			*leaf_depth = depth;
+		return bad + (depth != *leaf_depth);
+	}
+	bp_inner *in = (bp_inner *)n;
+	for (int i = 0; i <= n->count; i++)
+		bad += bad_bplus(in->child[i],
+				i == 0 ? lo : (long)n->key[i - 1],
+				i == n->count ? hi : (long)n->key[i],
+				depth + 1, leaf_depth, false);
+	return bad;
+}
+
+/*
+ * the B+ tree backing should agree with the scapegoat tree under the
+ * same churn. deletes are heavy enough that nodes borrow and merge.
+ */
+
+MU_TEST(test_bplus_matches_tree) {
+	one_block *tree = make_one_keyed(keyval, integral, NULL);
+	one_block *bpt = make_one_keyed_backed(keyval, bk_bplus, integral, NULL, NULL);
+	mu_should(bpt && bpt->backing == bk_bplus);
+	mu_should(is_empty(bpt));
+	mu_shouldnt(delete (bpt, as_key(1)));
+	mu_shouldnt(get(bpt, as_key(1)));
+
+	int mismatches = 0;
+	int bad = 0;
+	int leaf_depth;
+	for (int i = 0; i < 60000; i++) {
+		long k = random_between(1, 5000);
+		long v = random_between(1, 1000000);
+		/* grow for a while, then shrink most of the way down */
+		int grow = i < 30000 ? 3 : 1;
+		if (random_between(0, grow) > 0) {
+			if (insert(tree, as_key(k), as_key(v)) != insert(bpt, as_key(k), as_key(v)))
+				mismatches += 1;
+		} else if (exists(tree, as_key(k)) != exists(bpt, as_key(k)))
+			mismatches += 1;
+		else if (exists(tree, as_key(k))) {
+			if (random_between(1, 4) == 1) {
+				if (!update(bpt, as_key(k), as_key(v)) || !update(tree, as_key(k), as_key(v)))
+					mismatches += 1;
+			} else if (delete (tree, as_key(k)) != delete (bpt, as_key(k)))
+				mismatches += 1;
+		}
+		if (i % 5000 == 0 && bpt->u.bpt.root) {
+			leaf_depth = 0;
+			bad += bad_bplus(bpt->u.bpt.root, 0, 5001, 1, &leaf_depth, true);
+			bad += leaf_depth != bpt->u.bpt.height;
+		}
+	}
+	mu_should(mismatches == 0);
+	mu_should(bad == 0);
+	mu_should(count(tree) == count(bpt));
+	mu_should(bpt->u.bpt.height > 1);
+
+	/* keys, values, and a cursor all walk in key order */
+	one_block *tk = keys(tree);
+	one_block *bk = keys(bpt);
+	one_block *bv = values(bpt);
+	mu_should(count(tk) == count(bk));
+	one_cursor c;
+	int i = 0;
+	for (begin(bpt, &c); !done(&c); next(&c)) {
+		if (i >= count(tk) || c.key != (void *)nth(tk, i) || c.key != (void *)nth(bk, i)
+			|| c.item != (void *)nth(bv, i) || c.item != get(tree, c.key))
+			mismatches += 1;
+		i += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_should(i == count(tree));
+
+	/* the ordered lookups */
+	for (long q = 0; q <= 5002; q += 7) {
+		one_cursor t;
+		if (floor_key(tree, as_key(q)) != floor_key(bpt, as_key(q))
+			|| ceiling_key(tree, as_key(q)) != ceiling_key(bpt, as_key(q)))
+			mismatches += 1;
+		lower_bound(tree, as_key(q), &t);
+		lower_bound(bpt, as_key(q), &c);
+		if (done(&t) != done(&c) || t.key != c.key || t.item != c.item)
+			mismatches += 1;
+		upper_bound(tree, as_key(q), &t);
+		upper_bound(bpt, as_key(q), &c);
+		if (done(&t) != done(&c) || t.key != c.key || t.item != c.item)
+			mismatches += 1;
+		long ta[3] = { 0, 0, 0 };
+		long ba[3] = { 0, 0, 0 };
+		if (range(tree, as_key(q), as_key(q + 250), ta, range_cb)
+			!= range(bpt, as_key(q), as_key(q + 250), ba, range_cb)
+			|| ta[1] != ba[1])
+			mismatches += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_should(first_key(tree) == first_key(bpt));
+	mu_should(last_key(tree) == last_key(bpt));
+
+	/* only in order, no counts, and no tombstones */
+	long acc[3] = { 0, 0, 5 };
+	mu_should(in_order_keyed(bpt, acc, range_cb) == 5);
+	mu_should(pre_order_keyed(bpt, acc, range_cb) == -1);
+	mu_should(rank(bpt, as_key(5)) == -1);
+	mu_should(tombstones(bpt) == 0);
+	mu_should(sweep(bpt, 0) == 0);
+
+	/* empty it one key at a time, then purge a refill */
+	for (i = 0; i < count(bk); i++)
+		if (!delete (bpt, (void *)nth(bk, i)))
+			mismatches += 1;
+	mu_should(mismatches == 0);
+	mu_should(is_empty(bpt));
+	mu_should(count(bpt) == 0);
+	mu_should(bpt->u.bpt.height == 0);
+	mu_should(first_key(bpt) == NULL);
+	for (i = 0; i < 1000; i++)
+		insert(bpt, as_key(i), as_key(i));
+	mu_should(purge(bpt) == 1000);
+	mu_should(is_empty(bpt));
+	mu_should(insert(bpt, as_key(5), as_key(6)));
+	mu_should(get(bpt, as_key(5)) == as_key(6));
+
+	free_one(tk);
+	free_one(bk);
+	free_one(bv);
+	free_one(tree);
+	free_one(bpt);
+}
+
+/*
+ * a B+ tree cursor steps from leaf to leaf along the path it came
+ * down. walk on from bounds that land at the end of a leaf, in the
+ * middle of one, and past the last key, and compare with the tree.
+ */
+
+MU_TEST(test_bplus_cursor_steps) {
+	one_block *tree = make_one_keyed(keyval, integral, NULL);
+	one_block *bpt = make_one_keyed_backed(keyval, bk_bplus, integral, NULL, NULL);
+	for (int i = 0; i < 20000; i++) {
+		long k = random_between(1, 40000);
+		insert(tree, as_key(k), as_key(k * 3));
+		insert(bpt, as_key(k), as_key(k * 3));
+	}
+	mu_should(bpt->u.bpt.height > 2);
+
+	int mismatches = 0;
+	for (long q = 0; q <= 40002; q += 97) {
+		one_cursor t;
+		one_cursor c;
+		lower_bound(tree, as_key(q), &t);
+		lower_bound(bpt, as_key(q), &c);
+		for (int n = 0; n < 200; n++) {
+			if (done(&t) != done(&c) || t.key != c.key || t.item != c.item)
+				mismatches += 1;
+			if (done(&t))
+				break;
+			next(&t);
+			next(&c);
+		}
+		upper_bound(tree, as_key(q), &t);
+		upper_bound(bpt, as_key(q), &c);
+		for (int n = 0; n < 40; n++) {
+			if (done(&t) != done(&c) || t.key != c.key)
+				mismatches += 1;
+			if (done(&t))
+				break;
+			next(&t);
+			next(&c);
+		}
+	}
+	mu_should(mismatches == 0);
+
+	/* a finished cursor stays finished */
+	one_cursor c;
+	lower_bound(bpt, last_key(bpt), &c);
+	mu_should(!done(&c) && c.key == last_key(bpt));
+	next(&c);
+	mu_should(done(&c));
+	next(&c);
+	mu_should(done(&c));
+	upper_bound(bpt, last_key(bpt), &c);
+	mu_should(done(&c));
+
+	free_one(tree);
+	free_one(bpt);
+}
+
+/*
+ * string keys go through the comparator like any other.
+ */
+
+MU_TEST(test_bplus_string_keys) {
+	one_block *kv = make_one_keyed_backed(keyval, bk_bplus, string, NULL, NULL);
+	char buf[400][8];
+	for (int i = 0; i < 400; i++) {
+		snprintf(buf[i], sizeof(buf[i]), "k%04d", (i * 7919) % 400);
+		mu_should(insert(kv, buf[i], as_key(i)));
+	}
+	mu_shouldnt(insert(kv, "k0001", NULL));
+	mu_should(count(kv) == 400);
+	mu_should(strcmp(first_key(kv), "k0000") == 0);
+	mu_should(strcmp(last_key(kv), "k0399") == 0);
+	mu_should(strcmp(floor_key(kv, "k0123x"), "k0123") == 0);
+	for (int i = 0; i < 400; i += 2)
+		mu_should(delete (kv, buf[i]));
+	int n = 0;
+	bool ordered = true;
+	char *prior = "";
+	one_cursor c;
+	for (begin(kv, &c); !done(&c); next(&c)) {
+		ordered = ordered && strcmp(prior, c.key) < 0;
+		prior = c.key;
+		n += 1;
+	}
+	mu_should(ordered);
+	mu_should(n == 200);
+	free_one(kv);
+}
+
+/*
+ * check the subtree counts of every node, returning the number of
+ * nodes that are off. deleted nodes are tallied along the way.
+ */
+
+static
+int
+bad_sizes(one_node *n, int *deleted) {
+	if (!n)
+		return 0;
+	int bad = bad_sizes(n->left, deleted) + bad_sizes(n->right, deleted);
+	int ls = n->left ? n->left->size : 0, rs = n->right ? n->right->size : 0;
+	int ll = n->left ? n->left->live : 0, rl = n->right ? n->right->live : 0;
+	*deleted += n->deleted;
+	if (n->size != 1 + ls + rs || n->live != !n->deleted + ll + rl)
+		bad += 1;
+	return bad;
+}
+
+MU_TEST(test_rank_select) {
+	one_block *kv = make_one_keyed(keyval, integral, NULL);
+	mu_should(rank(kv, as_key(5)) == 0);
+	mu_shouldnt(select_key(kv, 0));
+
+	for (int i = 0; i < 20000; i++) {
+		long k = random_between(1, 5000);
+		if (random_between(1, 3) < 3)
+			insert(kv, as_key(k), as_key(k));
+		else if (exists(kv, as_key(k)))
+			delete (kv, as_key(k));
+	}
+	int deleted = 0;
+	mu_should(bad_sizes(kv->u.kvl.root, &deleted) == 0);
+	mu_should(deleted == kv->u.kvl.marked_deleted);
+	mu_should(kv->u.kvl.root->live == count(kv));
+
+	one_block *ks = keys(kv);
+	int mismatches = 0;
+	for (int i = 0; i < count(ks); i++) {
+		if (select_key(kv, i) != (void *)nth(ks, i)
+			|| rank(kv, (void *)nth(ks, i)) != i)
+			mismatches += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_shouldnt(select_key(kv, count(ks)));
+	mu_shouldnt(select_key(kv, -1));
+
+	/* a key that isn't held ranks where it would go */
+	mu_should(rank(kv, as_key(0)) == 0);
+	mu_should(rank(kv, as_key(6000)) == count(kv));
+	long k = 1;
+	while (exists(kv, as_key(k)))
+		k += 1;
+	mu_should(rank(kv, as_key(k)) == rank(kv, ceiling_key(kv, as_key(k))));
+
+	one_block *hash = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	mu_should(rank(hash, as_key(0)) == -1);
+	free_one(hash);
+	free_one(ks);
+	free_one(kv);
+}
+
+/*
+ * a full rebalance rebuilds the tree in place. it takes no new
+ * memory, drops the deleted nodes, and leaves a tree of minimal
+ * height.
+ */
+
+static
+int
+floor_log2(int n) {
+	int r = 0;
+	while (n >>= 1)
+		r += 1;
+	return r;
+}
+
+static
+int
+tree_height(one_node *n) {
+	if (!n)
+		return 0;
+	int l = tree_height(n->left), r = tree_height(n->right);
+	return 1 + (l > r ? l : r);
+}
+
+MU_TEST(test_rebalance_in_place) {
+	one_block *kv = make_one_keyed(keyval, integral, NULL);
+	for (long k = 1; k <= 4000; k++)
+		insert(kv, as_key(k), as_key(k));
+	one_tree *t = &kv->u.kvl;
+	mu_should(t->full_rebalances + t->partial_rebalances > 0);
+	mu_should(t->full_rebalance_time + t->partial_rebalance_time >= 0.0);
+
+	/* delete interior keys until a full rebalance happens, with no
+	 * sweeping to get there first */
+	t->policy.sweep_budget = 0;
+	int full = t->full_rebalances;
+	int slabs = t->pool.slab_count;
+	long k = 1;
+	while (t->full_rebalances == full && k <= 4000) {
+		if (exists(kv, as_key(k)))
+			delete (kv, as_key(k));
+		k += 3;
+	}
+	mu_should(t->full_rebalances == full + 1);
+	mu_should(t->pool.slab_count == slabs);
+	mu_should(t->marked_deleted == 0);
+
+	int deleted = 0;
+	mu_should(bad_sizes(t->root, &deleted) == 0);
+	mu_should(deleted == 0);
+	mu_should(t->root->size == count(kv));
+	mu_should(tree_height(t->root) == floor_log2(count(kv)) + 1);
+
+	/* and everything is still there in order */
+	one_cursor c;
+	long prior = 0;
+	int n = 0;
+	for (begin(kv, &c); !done(&c); next(&c)) {
+		if ((long)c.key <= prior || c.item != c.key)
+			break;
+		prior = (long)c.key;
+		n += 1;
+	}
+	mu_should(n == count(kv));
+	free_one(kv);
+}
+
+/*
+ * a sorted load builds the same store as inserts would, already
+ * balanced and with no rebalancing along the way. the result must
+ * then take inserts and deletes as usual.
+ */
+
+MU_TEST(test_load_sorted) {
+	int sizes[] = { 0, 1, 2, 16, 17, 272, 1000, 5000 };
+	one_backing backings[] = { bk_tree, bk_hash, bk_bplus };
+	void **ks = malloc(5000 * sizeof(void *));
+	void **vs = malloc(5000 * sizeof(void *));
+	for (int i = 0; i < 5000; i++) {
+		ks[i] = as_key(i * 2);
+		vs[i] = as_key(i * 3);
+	}
+
+	for (int b = 0; b < 3; b++) {
+		for (int s = 0; s < 8; s++) {
+			int n = sizes[s];
+			one_block *kv = make_one_keyed_backed(keyval, backings[b], integral, NULL, NULL);
+			mu_should(load_sorted(kv, ks, vs, n) == kv);
+			mu_should(count(kv) == n);
+			int wrong = 0;
+			for (int i = 0; i < n; i++)
+				wrong += get(kv, ks[i]) != vs[i];
+			one_block *sk = sorted_keys(kv);
+			for (int i = 0; i < n; i++)
+				wrong += nth(sk, i) != (uintptr_t)ks[i];
+			free_one(sk);
+			mu_should(wrong == 0);
+
+			if (backings[b] == bk_tree) {
+				int deleted = 0;
+				mu_should(bad_sizes(kv->u.kvl.root, &deleted) == 0);
+				mu_should(tree_height(kv->u.kvl.root) == (n ? floor_log2(n) + 1 : 0));
+			}
+			if (backings[b] == bk_bplus && n) {
+				int leaf_depth = 0;
+				mu_should(bad_bplus(kv->u.bpt.root, 0, 10000, 1, &leaf_depth, true) == 0);
+				mu_should(leaf_depth == kv->u.bpt.height);
+			}
+
+			/* the odd keys fit in between, then the evens go */
+			for (int i = 0; i < n; i++)
+				wrong += !insert(kv, as_key(i * 2 + 1), NULL);
+			for (int i = 0; i < n; i++)
+				wrong += !delete (kv, ks[i]);
+			mu_should(wrong == 0);
+			mu_should(count(kv) == n);
+			mu_should(n == 0 || backings[b] == bk_hash || first_key(kv) == as_key(1));
+			if (backings[b] == bk_bplus && n) {
+				int leaf_depth = 0;
+				mu_should(bad_bplus(kv->u.bpt.root, 0, 10000, 1, &leaf_depth, true) == 0);
+			}
+			free_one(kv);
+		}
+	}
+
+	/* a balanced build needs no rebalancing */
+	one_block *kv = make_one_keyed(keyval, integral, NULL);
+	load_sorted(kv, ks, vs, 5000);
+	mu_should(kv->u.kvl.full_rebalances == 0 && kv->u.kvl.partial_rebalances == 0);
+
+	/* only into an empty store, and only sorted unique keys */
+	mu_shouldnt(load_sorted(kv, ks, vs, 10));
+	mu_should(count(kv) == 5000);
+	free_one(kv);
+	void *held = ks[7];
+	ks[7] = ks[6];
+	for (int b = 0; b < 3; b++) {
+		kv = make_one_keyed_backed(keyval, backings[b], integral, NULL, NULL);
+		mu_shouldnt(load_sorted(kv, ks, vs, 100));
+		mu_should(is_empty(kv));
+		ks[7] = ks[5];
+		mu_shouldnt(load_sorted(kv, ks, vs, 100));
+		mu_should(is_empty(kv));
+		ks[7] = ks[6];
+		free_one(kv);
+	}
+	ks[7] = held;
+
+	/* string keys use their comparator */
+	char *words[] = { "apple", "banana", "cherry", "date", "elderberry" };
+	kv = make_one_keyed_backed(keyval, bk_bplus, string, NULL, NULL);
+	mu_should(load_sorted(kv, (void **)words, (void **)words, 5));
+	mu_should(strcmp(floor_key(kv, "coconut"), "cherry") == 0);
+	free_one(kv);
+	kv = make_one_keyed(keyval, string, NULL);
+	mu_should(load_sorted(kv, (void **)words, (void **)words, 5));
+	mu_should(get(kv, "date") == words[3]);
+	free_one(kv);
+
+	free(ks);
+	free(vs);
+}
+
+/*
+ * does a store hold exactly the pairs in want? want[k] is the value
+ * for key k, or 0 if k isn't held. counts the differences, including
+ * keys out of order on a walk.
+ */
+
+static
+int
+snapshot_differs(one_block *kv, long *want, int n) {
+	int wrong = 0;
+	int held = 0;
+	for (int k = 1; k < n; k++) {
+		if (want[k])
+			held += 1;
+		if (exists(kv, as_key(k)) != (want[k] != 0))
+			wrong += 1;
+		else if (want[k] && get(kv, as_key(k)) != as_key(want[k]))
+			wrong += 1;
+	}
+	wrong += count(kv) != held;
+	one_block *sk = sorted_keys(kv);
+	for (int i = 1; i < held; i++)
+		wrong += nth(sk, i - 1) >= nth(sk, i);
+	free_one(sk);
+	return wrong;
+}
+
+/*
+ * with no other versions left every node should be unshared.
+ */
+
+static
+int
+shared_nodes(bp_node *n) {
+	int shared = n->refs != 1;
+	if (!n->leaf)
+		for (int i = 0; i <= n->count; i++)
+			shared += shared_nodes(((bp_inner *)n)->child[i]);
+	return shared;
+}
+
+/*
+ * snapshots of a B+ tree keep what they saw while the live store
+ * churns, and each can be changed without disturbing the others.
+ * they are freed in a jumbled order, and the allocator reports
+ * anything left behind at teardown.
+ */
+
+MU_TEST(test_snapshots) {
+	enum { KEYS = 3000, SNAPS = 8 };
+	one_block *kv = make_one_keyed_backed(keyval, bk_bplus, integral, NULL, NULL);
+	long *live = calloc(KEYS, sizeof(long));
+	long *saw[SNAPS];
+	one_block *snap[SNAPS];
+
+	/* an empty snapshot, by way of clone */
+	one_block *empty = clone(kv);
+	mu_should(empty && is_empty(empty));
+
+	for (int s = 0; s < SNAPS; s++) {
+		for (int i = 0; i < 4000; i++) {
+			long k = random_between(1, KEYS - 1);
+			long v = random_between(1, 1000000);
+			if (random_between(0, s < SNAPS / 2 ? 3 : 1) > 0) {
+				if (insert(kv, as_key(k), as_key(v)) != (live[k] == 0))
+					mu_should(false);
+				if (!live[k])
+					live[k] = v;
+			} else if (random_between(1, 3) == 1) {
+				if (update(kv, as_key(k), as_key(v)) != (live[k] != 0))
+					mu_should(false);
+				if (live[k])
+					live[k] = v;
+			} else {
+				if (delete (kv, as_key(k)) != (live[k] != 0))
+					mu_should(false);
+				live[k] = 0;
+			}
+		}
+		snap[s] = snapshot(kv);
+		saw[s] = malloc(KEYS * sizeof(long));
+		memcpy(saw[s], live, KEYS * sizeof(long));
+	}
+
+	/* the live store has moved on, none of the snapshots have */
+	int wrong = snapshot_differs(kv, live, KEYS);
+	for (int s = 0; s < SNAPS; s++)
+		wrong += snapshot_differs(snap[s], saw[s], KEYS);
+	mu_should(wrong == 0);
+	mu_should(is_empty(empty));
+
+	/* a snapshot can be changed, and snapshot in turn */
+	one_block *again = snapshot(snap[3]);
+	long *kept = malloc(KEYS * sizeof(long));
+	memcpy(kept, saw[3], KEYS * sizeof(long));
+	for (int k = 1; k < KEYS; k += 2) {
+		if (saw[3][k]) {
+			delete (snap[3], as_key(k));
+			saw[3][k] = 0;
+		} else {
+			insert(snap[3], as_key(k), as_key(k));
+			saw[3][k] = k;
+		}
+	}
+	purge(snap[5]);
+	memset(saw[5], 0, KEYS * sizeof(long));
+	wrong = snapshot_differs(snap[3], saw[3], KEYS);
+	wrong += snapshot_differs(again, kept, KEYS);
+	wrong += snapshot_differs(snap[5], saw[5], KEYS);
+	wrong += snapshot_differs(kv, live, KEYS);
+	for (int s = 0; s < SNAPS; s++) {
+		int leaf_depth = 0;
+		if (snap[s]->u.bpt.root)
+			wrong += bad_bplus(snap[s]->u.bpt.root, 0, KEYS, 1, &leaf_depth, true);
+	}
+	mu_should(wrong == 0);
+
+	/* cursors and range walks see their own version */
+	one_cursor cur;
+	long last = 0;
+	int walked = 0;
+	for (begin(again, &cur); !done(&cur); next(&cur)) {
+		if ((long)cur.key <= last || kept[(long)cur.key] != (long)cur.item)
+			wrong += 1;
+		last = (long)cur.key;
+		walked += 1;
+	}
+	mu_should(wrong == 0 && walked == count(again));
+
+	/* the other versions go in no particular order, the live store
+	 * ends up owning all of its nodes again */
+	int order[SNAPS] = { 4, 0, 7, 2, 6, 1, 5, 3 };
+	for (int s = 0; s < SNAPS; s++) {
+		free_one(snap[order[s]]);
+		mu_should(snapshot_differs(kv, live, KEYS) == 0);
+		free(saw[order[s]]);
+	}
+	mu_should(snapshot_differs(again, kept, KEYS) == 0);
+	free_one(again);
+	free_one(empty);
+	mu_should(kv->u.bpt.root && shared_nodes(kv->u.bpt.root) == 0);
+	free(kept);
+
+	/* the live store can go first too */
+	one_block *left = snapshot(kv);
+	free_one(kv);
+	mu_should(snapshot_differs(left, live, KEYS) == 0);
+	free_one(left);
+	free(live);
+
+	/* only a B+ tree can be snapshot */
+	one_block *tree = make_one_keyed(keyval, integral, NULL);
+	mu_shouldnt(snapshot(tree));
+	free_one(tree);
+}
+
+/*
+ * a concurrent store under writers and readers at once. each writer
+ * owns the keys congruent to its number and churns them, always
+ * storing a value that names its key. readers check that whatever
+ * they find belongs to the key they asked for, and that range walks
+ * come back in order. afterward the store must hold exactly what
+ * the writers say they left in it.
+ *
+ * the library's random generator isn't shared between threads, each
+ * thread has its own xorshift.
+ */
+
+#define MT_KEYS 4096
+#define MT_WRITERS 2
+#define MT_READERS 4
+
+typedef struct mt_arg mt_arg;
+struct mt_arg {
+	one_block *kv;
+	int id;
+	uint64_t seed;
+	int ops;
+	atomic_int *stop;
+	bool held[MT_KEYS];        /* writers, which of their keys are in */
+	long wrong;                /* readers, what didn't add up */
+	long reads;
+};
+
+static
+uint64_t
+mt_random(uint64_t *x) {
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+	return *x;
+}
+
+static
+void *
+mt_writer(void *p) {
+	mt_arg *a = p;
+	for (int i = 0; i < a->ops; i++) {
+		long k = mt_random(&a->seed) % (MT_KEYS / MT_WRITERS) * MT_WRITERS + a->id;
+		void *v = as_key(k * 1000 + i % 1000);
+		switch (mt_random(&a->seed) % 4) {
+		case 0:
+		case 1:
+			if (insert(a->kv, as_key(k), v) == a->held[k])
+				a->wrong += 1;
+			a->held[k] = true;
+			break;
+		case 2:
+			if (update(a->kv, as_key(k), v) != a->held[k])
+				a->wrong += 1;
+			break;
+		default:
+			/* deleting a missing key is noisy */
+			if (a->held[k] && !delete (a->kv, as_key(k)))
+				a->wrong += 1;
+			a->held[k] = false;
+		}
+	}
+	return NULL;
+}
+
+static
+bool
+mt_check_walk(void *key, void *value, void *context, one_tree *self) {
+	long *last = context;
+	if ((long)key <= last[0] || (long)value / 1000 != (long)key)
+		last[1] += 1;
+	last[0] = (long)key;
+	return true;
+}
+
+static
+void *
+mt_reader(void *p) {
+	mt_arg *a = p;
+	bool ordered = a->kv->backing != bk_hash;
+	while (!atomic_load(a->stop)) {
+		long k = mt_random(&a->seed) % MT_KEYS;
+		long v = (long)get(a->kv, as_key(k));
+		if (v && v / 1000 != k)
+			a->wrong += 1;
+		exists(a->kv, as_key(k));
+		if (ordered && mt_random(&a->seed) % 64 == 0) {
+			long last[2] = { -1, 0 };
+			range(a->kv, as_key(k), as_key(k + 200), last, mt_check_walk);
+			a->wrong += last[1];
+			void *f = floor_key(a->kv, as_key(k));
+			if (f && (long)f > k)
+				a->wrong += 1;
+		}
+		/* only positioning is locked, so look no further */
+		for (int strict = 0; ordered && strict < 2; strict++) {
+			one_cursor cur;
+			if (strict)
+				upper_bound(a->kv, as_key(k), &cur);
+			else
+				lower_bound(a->kv, as_key(k), &cur);
+			if (!done(&cur) && ((long)cur.key < k + strict
+					|| (long)cur.item / 1000 != (long)cur.key))
+				a->wrong += 1;
+		}
+		a->reads += 1;
+	}
+	return NULL;
+}
+
+MU_TEST(test_concurrent) {
+	one_backing backings[] = { bk_tree, bk_hash, bk_bplus };
+	for (int b = 0; b < 3; b++) {
+		one_block *kv = make_one_concurrent(keyval, backings[b], integral, NULL, NULL);
+		mu_should(kv && kv->lock);
+		atomic_int stop;
+		atomic_init(&stop, 0);
+		mt_arg *args = calloc(MT_WRITERS + MT_READERS, sizeof(mt_arg));
+		pthread_t threads[MT_WRITERS + MT_READERS];
+		for (int t = 0; t < MT_WRITERS + MT_READERS; t++) {
+			args[t].kv = kv;
+			args[t].id = t;
+			args[t].seed = 6803 + t;
+			args[t].ops = 100000;
+			args[t].stop = &stop;
+			pthread_create(&threads[t], NULL,
+				t < MT_WRITERS ? mt_writer : mt_reader, &args[t]);
+		}
+		for (int t = 0; t < MT_WRITERS; t++)
+			pthread_join(threads[t], NULL);
+		atomic_store(&stop, 1);
+		for (int t = MT_WRITERS; t < MT_WRITERS + MT_READERS; t++)
+			pthread_join(threads[t], NULL);
+
+		long wrong = 0;
+		long reads = 0;
+		int held = 0;
+		for (int t = 0; t < MT_WRITERS + MT_READERS; t++) {
+			wrong += args[t].wrong;
+			reads += args[t].reads;
+		}
+		for (long k = 0; k < MT_KEYS; k++) {
+			bool want = args[k % MT_WRITERS].held[k];
+			held += want;
+			if (exists(kv, as_key(k)) != want)
+				wrong += 1;
+		}
+		mu_should(wrong == 0);
+		mu_should(reads > 0);
+		mu_should(count(kv) == held);
+		free(args);
+		free_one(kv);
+	}
+
+	/* a snapshot shares the lock of its store */
+	one_block *kv = make_one_concurrent(keyval, bk_bplus, integral, NULL, NULL);
+	for (long k = 0; k < 100; k++)
+		insert(kv, as_key(k), as_key(k));
+	one_block *snap = snapshot(kv);
+	mu_should(snap->lock == kv->lock && atomic_load(&kv->lock->users) == 2);
+	free_one(kv);
+	mu_should(count(snap) == 100);
+	free_one(snap);
+
+	mu_shouldnt(make_one_concurrent(pqueue, bk_default, integral, NULL, NULL));
+}
+
+/*
+ * keys and values only need the shared lock, so they can run while
+ * another reader is in the store. the reader waits in its callback
+ * for the collectors to finish, giving up after a few seconds if
+ * they don't.
+ */
+
+static
+bool
+mt_hold_walk(void *key, void *value, void *context, one_tree *self) {
+	atomic_int *state = context;
+	atomic_store(state, 1);
+	time_t give_up = time(NULL) + 5;
+	while (atomic_load(state) != 2 && time(NULL) < give_up)
+		sched_yield();
+	return false;
+}
+
+static
+void *
+mt_holder(void *p) {
+	mt_arg *a = p;
+	range(a->kv, as_key(0), as_key(MT_KEYS), a->stop, mt_hold_walk);
+	a->wrong = atomic_load(a->stop) != 2;
+	return NULL;
+}
+
+MU_TEST(test_concurrent_collect) {
+	one_block *kv = make_one_concurrent(keyval, bk_bplus, integral, NULL, NULL);
+	for (long k = 0; k < 100; k++)
+		insert(kv, as_key(k), as_key(k));
+	atomic_int state;
+	atomic_init(&state, 0);
+	mt_arg arg = { .kv = kv, .stop = &state };
+	pthread_t holder;
+	pthread_create(&holder, NULL, mt_holder, &arg);
+	while (atomic_load(&state) == 0)
+		sched_yield();
+	one_block *ks = keys(kv);
+	one_block *vs = values(kv);
+	atomic_store(&state, 2);
+	pthread_join(holder, NULL);
+	mu_should(arg.wrong == 0);
+	mu_should(count(ks) == 100 && count(vs) == 100);
+	free_one(ks);
+	free_one(vs);
+	free_one(kv);
+}
+
+/*
+ * deleted nodes collected by explicit sweeps, and by the sweeps that
+ * ride along with inserts and deletes.
+ */
+
+MU_TEST(test_tombstones) {
+	one_block *kv = make_one_keyed(keyval, integral, NULL);
+	one_tree *t = &kv->u.kvl;
+	t->policy.sweep_budget = 0;
+	for (long k = 1; k <= 1000; k++)
+		insert(kv, as_key(k), as_key(k));
+	mu_should(tombstones(kv) == 0);
+
+	/* few enough to stay under the full rebalance trigger */
+	int full = t->full_rebalances;
+	int marked = 0;
+	for (long k = 2; k <= 1000 && marked < 50; k += 7)
+		if (delete (kv, as_key(k)) && t->marked_deleted > marked)
+			marked += 1;
+	mu_should(tombstones(kv) == marked);
+	mu_should(t->full_rebalances == full);
+
+	int swept = sweep(kv, 100);
+	mu_should(swept >= 0 && swept <= marked);
+	mu_should(tombstones(kv) == marked - swept);
+	mu_should(sweep(kv, 0) == marked - swept);
+	mu_should(tombstones(kv) == 0);
+	mu_should(sweep(kv, 10) == 0);
+
+	int deleted = 0;
+	mu_should(bad_sizes(t->root, &deleted) == 0);
+	mu_should(deleted == 0);
+	mu_should(t->root->size == count(kv));
+	one_block *ks = keys(kv);
+	int mismatches = 0;
+	for (int i = 0; i < count(ks); i++)
+		if (get(kv, (void *)nth(ks, i)) != (void *)nth(ks, i)
+			|| (i && nth(ks, i - 1) >= nth(ks, i)))
+			mismatches += 1;
+	mu_should(mismatches == 0);
+	free_one(ks);
+	free_one(kv);
+
+	/* left to the mutations, the tombstones stay few */
+	kv = make_one_keyed(keyval, integral, NULL);
+	t = &kv->u.kvl;
+	int most = 0;
+	for (int i = 0; i < 50000; i++) {
+		long k = random_between(1, 5000);
+		if (random_between(1, 2) == 1)
+			insert(kv, as_key(k), as_key(k));
+		else if (exists(kv, as_key(k)))
+			delete (kv, as_key(k));
+		if (tombstones(kv) > most)
+			most = tombstones(kv);
+	}
+	printf("\nmost tombstones %d, full rebalances %d, partial %d\n",
+		most, t->full_rebalances, t->partial_rebalances);
+	deleted = 0;
+	mu_should(bad_sizes(t->root, &deleted) == 0);
+	mu_should(deleted == tombstones(kv));
+	mu_should(most * 10 < count(kv));
+
+	one_block *hash = make_one_keyed_backed(keyval, bk_hash, integral, NULL, NULL);
+	mu_should(tombstones(hash) == 0);
+	mu_should(sweep(hash, 5) == 0);
+	free_one(hash);
+	free_one(kv);
+}
+
+/*
+ * each tree balances by its own policy.
+ */
+
+MU_TEST(test_policy) {
+	one_policy p = default_policy();
+	mu_should(p.alpha == ONE_REBALANCE_ALPHA);
+	mu_should(p.delete_percent == ONE_REBALANCE_DELETE_PERCENT);
+	mu_should(p.minimum == ONE_REBALANCE_MINIMUM);
+	mu_should(p.sweep_budget == ONE_TOMBSTONE_SWEEP);
+	mu_should(p.rebalance_allowed);
+
+	one_block *kv = make_one_keyed_policy(keyval, integral, NULL, NULL);
+	mu_should(kv->u.kvl.policy.alpha == p.alpha);
+	free_one(kv);
+
+	p.alpha = 1.0;
+	mu_shouldnt(make_one_keyed_policy(keyval, integral, NULL, &p));
+
+	/* no rebalancing, ascending keys make a vine */
+	p = default_policy();
+	p.rebalance_allowed = false;
+	kv = make_one_keyed_policy(keyval, integral, NULL, &p);
+	for (long k = 1; k <= 200; k++)
+		insert(kv, as_key(k), as_key(k));
+	mu_should(kv->u.kvl.full_rebalances + kv->u.kvl.partial_rebalances == 0);
+	mu_should(tree_height(kv->u.kvl.root) == 200);
+	free_one(kv);
+
+	/* a tight alpha gives a tree no taller than a loose one */
+	p = default_policy();
+	p.alpha = 1.1;
+	one_block *tight = make_one_keyed_policy(keyval, integral, NULL, &p);
+	p.alpha = 3.0;
+	one_block *loose = make_one_keyed_policy(keyval, integral, NULL, &p);
+	for (int i = 0; i < 5000; i++) {
+		long k = random_between(1, 100000);
+		insert(tight, as_key(k), as_key(k));
+		insert(loose, as_key(k), as_key(k));
+	}
+	mu_should(count(tight) == count(loose));
+	mu_should(tree_height(tight->u.kvl.root) <= tree_height(loose->u.kvl.root));
+	mu_should(tight->u.kvl.partial_rebalances + tight->u.kvl.full_rebalances
+		>= loose->u.kvl.partial_rebalances + loose->u.kvl.full_rebalances);
+	free_one(tight);
+	free_one(loose);
+
+	/* deletes never force a full rebalance at 100 percent */
+	p = default_policy();
+	p.delete_percent = 100;
+	p.sweep_budget = 0;
+	kv = make_one_keyed_policy(keyval, integral, NULL, &p);
+	for (long k = 1; k <= 1000; k++)
+		insert(kv, as_key(k), as_key(k));
+	int full = kv->u.kvl.full_rebalances;
+	for (long k = 1; k <= 1000; k += 2)
+		delete (kv, as_key(k));
+	mu_should(kv->u.kvl.full_rebalances == full);
+	mu_should(tombstones(kv) > 0);
+	free_one(kv);
+}
+
 MU_TEST_SUITE(test_suite) {
 
 	MU_SUITE_CONFIGURE(test_setup, test_teardown);
@@ -459,9 +1894,28 @@ MU_TEST_SUITE(test_suite) {
 	MU_RUN_TEST(test_update);
 	MU_RUN_TEST(test_delete);
 	MU_RUN_TEST(test_string_keys);
+	MU_RUN_TEST(test_key_order);
 	MU_RUN_TEST(test_volume_ascending);
 	MU_RUN_TEST(test_volume_descending);
 	MU_RUN_TEST(test_volume_random);
+	MU_RUN_TEST(test_hash_create);
+	MU_RUN_TEST(test_hash_basics);
+	MU_RUN_TEST(test_hash_string_keys);
+	MU_RUN_TEST(test_hash_custom_keys);
+	MU_RUN_TEST(test_hash_matches_tree);
+	MU_RUN_TEST(test_cursor);
+	MU_RUN_TEST(test_range);
+	MU_RUN_TEST(test_bplus_matches_tree);
+	MU_RUN_TEST(test_bplus_cursor_steps);
+	MU_RUN_TEST(test_bplus_string_keys);
+	MU_RUN_TEST(test_rank_select);
+	MU_RUN_TEST(test_rebalance_in_place);
+	MU_RUN_TEST(test_load_sorted);
+	MU_RUN_TEST(test_snapshots);
+	MU_RUN_TEST(test_concurrent);
+	MU_RUN_TEST(test_concurrent_collect);
+	MU_RUN_TEST(test_tombstones);
+	MU_RUN_TEST(test_policy);
 }
 
 int
@@ -2,6 +2,7 @@
 
 /* released to the public domain, troy brumley, may 2024 */
 
+#include <stddef.h>
 #include <string.h>
 #include "minunit.h"
 #include "../inc/alloc.h"
@@ -591,6 +592,479 @@ MU_TEST(test_dynarray) {
  * hook up the tests
  */
 
+/*
+ * list items come out of a pool owned by the list. churn should
+ * recycle the same nodes, and purge should give back every slab.
+ */
+
+MU_TEST(test_pool_reuse) {
+	one_block *ob = make_one(deque);
+	mu_should(ob->u.dbl.pool.slab_count == 0);
+
+	/* never more than a few items queued at once */
+	for (long i = 1; i <= 10000; i++) {
+		push_back(ob, (void *)i);
+		if (i % 4 == 0)
+			while (!is_empty(ob))
+				pop_front(ob);
+	}
+	mu_should(ob->u.dbl.pool.slab_count == 1);
+
+	/* a node freed in the middle is reused before a new slab */
+	for (long i = 1; i <= ONE_POOL_FIRST_SLAB; i++)
+		push_back(ob, (void *)i);
+	mu_should(ob->u.dbl.pool.slab_count == 1);
+	mu_should(pop_front(ob) == (void *)1);
+	push_front(ob, (void *)1);
+	mu_should(ob->u.dbl.pool.slab_count == 1);
+	push_back(ob, (void *)99);
+	mu_should(ob->u.dbl.pool.slab_count == 2);
+
+	mu_should(purge(ob) == ONE_POOL_FIRST_SLAB + 1);
+	mu_should(ob->u.dbl.pool.slab_count == 0);
+	mu_should(ob->u.dbl.pool.slabs == NULL);
+	mu_should(is_empty(ob));
+
+	/* and it still works after a purge */
+	push_back(ob, "one");
+	mu_should(equal_string(pop_front(ob), "one"));
+	free_one(ob);
+}
+
+MU_TEST(test_pool_growth) {
+	one_block *ob = make_one(stack);
+	int n = 0;
+	int slab = ONE_POOL_FIRST_SLAB;
+	int slabs = 0;
+	while (n < 20000) {
+		n += slab;
+		slabs += 1;
+		if (slab < ONE_POOL_MAX_SLAB)
+			slab *= 2;
+	}
+	for (long i = 1; i <= n; i++)
+		push(ob, (void *)i);
+	mu_should(ob->u.sgl.pool.slab_count == slabs);
+	mu_should(pop(ob) == (void *)(long)n);
+	mu_should(pop(ob) == (void *)(long)(n - 1));
+
+	/* pops and pushes don't need any more */
+	push(ob, (void *)1);
+	push(ob, (void *)2);
+	mu_should(ob->u.sgl.pool.slab_count == slabs);
+	mu_should(depth(ob) == n);
+	free_one(ob);
+
+	/* the tree and pqueue use pools too */
+	ob = make_one_keyed(keyval, integral, NULL);
+	for (long i = 1; i <= 1000; i++)
+		insert(ob, (void *)i, (void *)i);
+	mu_should(ob->u.kvl.pool.slab_count > 0);
+	free_one(ob);
+	ob = make_one(pqueue);
+	for (long i = 1; i <= 1000; i++)
+		add_with_priority(ob, i % 17, (void *)i);
+	mu_should(ob->u.pqu.pool.slab_count > 0);
+	mu_should(purge(ob) == 1000);
+	mu_should(ob->u.pqu.pool.slab_count == 0);
+	free_one(ob);
+}
+
+/*
+ * a deque on a ring buffer should behave exactly as one on a doubly
+ * linked list. run the same mix of operations against both.
+ */
+
+MU_TEST(test_deque_ring) {
+	one_block *ring = make_one_backed(deque, bk_ring);
+	one_block *linked = make_one(deque);
+	mu_should(ring);
+	mu_should(ring->backing == bk_ring);
+	mu_should(linked->backing == bk_linked);
+	mu_shouldnt(pop_front(ring));
+	mu_shouldnt(pop_back(ring));
+	mu_shouldnt(peek_front(ring));
+	mu_shouldnt(peek_back(ring));
+
+	int mismatches = 0;
+	unsigned long x = 6803;
+	for (long i = 1; i <= 20000; i++) {
+		x = x * 6364136223846793005UL + 1442695040888963407UL;
+		switch ((x >> 33) % 6) {
+		case 0:
+		case 1:
+			push_front(ring, (void *)i);
+			push_front(linked, (void *)i);
+			break;
+		case 2:
+		case 3:
+			push_back(ring, (void *)i);
+			push_back(linked, (void *)i);
+			break;
+		case 4:
+			if (pop_front(ring) != pop_front(linked))
+				mismatches += 1;
+			break;
+		case 5:
+			if (pop_back(ring) != pop_back(linked))
+				mismatches += 1;
+			break;
+		}
+		if (peek_front(ring) != peek_front(linked)
+			|| peek_back(ring) != peek_back(linked))
+			mismatches += 1;
+	}
+	mu_should(mismatches == 0);
+	mu_should(count(ring) == count(linked));
+	mu_should(ring->u.rng.capacity >= count(ring));
+	while (!is_empty(linked))
+		if (pop_front(ring) != pop_front(linked))
+			mismatches += 1;
+	mu_should(mismatches == 0);
+	mu_should(is_empty(ring));
+
+	free_one(ring);
+	free_one(linked);
+}
+
+/*
+ * cursors over the linear structures. walk into a small array so the
+ * order can be checked.
+ */
+
+static
+int
+walk(one_block *ob, long *seen, int max) {
+	one_cursor c;
+	int n = 0;
+	for (begin(ob, &c); !done(&c) && n < max; next(&c))
+		seen[n++] = (long)c.item;
+	return n;
+}
+
+MU_TEST(test_cursors) {
+	long seen[10];
+	one_backing backing[] = { bk_linked, bk_ring };
+
+	one_block *ob = make_one(singly);
+	mu_should(walk(ob, seen, 10) == 0);
+	for (long i = 1; i <= 3; i++)
+		add_last(ob, (void *)i);
+	mu_should(walk(ob, seen, 10) == 3);
+	mu_should(seen[0] == 1 && seen[2] == 3);
+	free_one(ob);
+
+	ob = make_one(doubly);
+	for (long i = 1; i <= 3; i++)
+		add_first(ob, (void *)i);
+	mu_should(walk(ob, seen, 10) == 3);
+	mu_should(seen[0] == 3 && seen[2] == 1);
+	free_one(ob);
+
+	for (int b = 0; b < 2; b++) {
+		ob = make_one_backed(stack, backing[b]);
+		for (long i = 1; i <= 4; i++)
+			push(ob, (void *)i);
+		mu_should(walk(ob, seen, 10) == 4);
+		mu_should(seen[0] == 4 && seen[3] == 1);
+		free_one(ob);
+
+		ob = make_one_backed(queue, backing[b]);
+		for (long i = 1; i <= 4; i++)
+			enqueue(ob, (void *)i);
+		dequeue(ob);
+		mu_should(walk(ob, seen, 10) == 3);
+		mu_should(seen[0] == 2 && seen[2] == 4);
+		free_one(ob);
+
+		ob = make_one_backed(deque, backing[b]);
+		push_back(ob, (void *)2);
+		push_front(ob, (void *)1);
+		push_back(ob, (void *)3);
+		mu_should(walk(ob, seen, 10) == 3);
+		mu_should(seen[0] == 1 && seen[1] == 2 && seen[2] == 3);
+		free_one(ob);
+	}
+
+	ob = make_one(dynarray);
+	put_at(ob, (void *)5, 0);
+	put_at(ob, (void *)7, 2);
+	mu_should(walk(ob, seen, 10) == 3);
+	mu_should(seen[0] == 5 && seen[1] == 0 && seen[2] == 7);
+	free_one(ob);
+
+	ob = make_one(alist);
+	mu_should(walk(ob, seen, 10) == 0);
+	for (long i = 1; i <= 3; i++)
+		ob = cons(ob, i);
+	mu_should(walk(ob, seen, 10) == 3);
+	mu_should(seen[0] == 1 && seen[2] == 3);
+	free_one(ob);
+
+	/* a linked pqueue is in priority order, a heap isn't */
+	one_backing pq[] = { bk_linked, bk_heap, bk_dual_heap };
+	for (int b = 0; b < 3; b++) {
+		ob = make_one_backed(pqueue, pq[b]);
+		add_with_priority(ob, 20, (void *)2);
+		add_with_priority(ob, 10, (void *)1);
+		add_with_priority(ob, 30, (void *)3);
+		one_cursor c;
+		long sum = 0;
+		int n = 0;
+		for (begin(ob, &c); !done(&c); next(&c)) {
+			sum += c.priority;
+			n += c.priority == (long)c.item * 10;
+		}
+		mu_should(sum == 60 && n == 3);
+		if (pq[b] == bk_linked) {
+			begin(ob, &c);
+			mu_should(c.priority == 10);
+		}
+		free_one(ob);
+	}
+
+	/* a finished cursor stays finished */
+	ob = make_one(queue);
+	one_cursor c;
+	mu_should(begin(ob, &c) == &c);
+	mu_should(done(&c));
+	mu_should(done(next(&c)));
+	free_one(ob);
+}
+
+/*
+ * the lists keep their lengths as they go. mix adds and removes at
+ * both ends and check count or depth against what's been done and
+ * against a walk of the list.
+ */
+
+static
+int
+walked(one_block *ob) {
+	int n = 0;
+	one_cursor c;
+	for (begin(ob, &c); !done(&c); next(&c))
+		n += 1;
+	return n;
+}
+
+MU_TEST(test_counts_in_step) {
+	one_type types[] = { singly, doubly, stack, queue, deque };
+	for (int t = 0; t < 5; t++) {
+		one_block *ob = make_one(types[t]);
+		int held = 0;
+		int wrong = 0;
+		unsigned x = 6803;
+		for (int i = 0; i < 5000; i++) {
+			x = x * 1103515245 + 12345;
+			bool add = (x >> 16) % 3 != 0 || held == 0;
+			bool front = (x >> 20) & 1;
+			switch (types[t]) {
+			case singly:
+			case doubly:
+				if (add)
+					front ? add_first(ob, "x") : add_last(ob, "x");
+				else
+					front ? get_first(ob) : get_last(ob);
+				break;
+			case stack:
+				add ? (void)push(ob, "x") : (void)pop(ob);
+				break;
+			case queue:
+				add ? (void)enqueue(ob, "x") : (void)dequeue(ob);
+				break;
+			default:
+				if (add)
+					front ? push_front(ob, "x") : push_back(ob, "x");
+				else
+					front ? pop_front(ob) : pop_back(ob);
+			}
+			held += add ? 1 : -1;
+			int n = types[t] == stack ? depth(ob) : count(ob);
+			wrong += n != held || is_empty(ob) != (held == 0);
+			if (i % 500 == 0)
+				wrong += walked(ob) != held;
+		}
+		mu_should(wrong == 0);
+		mu_should(purge(ob) == held);
+		mu_should(is_empty(ob) && walked(ob) == 0);
+		if (types[t] == stack)
+			mu_should(depth(ob) == 0);
+		else
+			mu_should(count(ob) == 0);
+		free_one(ob);
+	}
+}
+
+/*
+ * splicing hands over both the items and the nodes they live in.
+ * the allocation tracker at teardown catches a slab freed twice or
+ * not at all.
+ */
+
+static
+bool
+in_order(one_block *ob, const char *want) {
+	one_cursor c;
+	for (begin(ob, &c); !done(&c); next(&c), want++)
+		if (!*want || *(char *)c.item != *want)
+			return false;
+	return *want == 0;
+}
+
+MU_TEST(test_splice) {
+	static char *letters[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+	one_type types[] = { singly, doubly };
+	for (int t = 0; t < 2; t++) {
+		one_block *xs = make_one(types[t]);
+		one_block *ys = make_one(types[t]);
+		for (int i = 0; i < 4; i++) {
+			add_last(xs, letters[i]);
+			add_last(ys, letters[i + 4]);
+		}
+		mu_should(equal_string(peek_last(xs), "d"));
+		mu_should(splice(xs, ys) == xs);
+		mu_should(count(xs) == 8 && is_empty(ys));
+		mu_should(in_order(xs, "abcdefgh"));
+		mu_should(equal_string(peek_last(xs), "h"));
+		mu_should(equal_string(get_last(xs), "h"));
+		mu_should(equal_string(peek_last(xs), "g"));
+
+		/* the emptied list still works, and has nodes of its own */
+		add_last(ys, "z");
+		add_first(ys, "y");
+		mu_should(in_order(ys, "yz"));
+		free_one(ys);
+		add_last(xs, "i");
+		mu_should(in_order(xs, "abcdefgi"));
+
+		/* splicing to or from an empty list */
+		one_block *empty = make_one(types[t]);
+		splice(xs, empty);
+		mu_should(in_order(xs, "abcdefgi") && count(xs) == 8);
+		splice(empty, xs);
+		mu_should(in_order(empty, "abcdefgi") && is_empty(xs));
+		mu_should(equal_string(peek_last(empty), "i"));
+		while (!is_empty(empty))
+			get_first(empty);
+		mu_should(peek_last(empty) == NULL);
+		add_last(empty, "j");
+		mu_should(equal_string(peek_first(empty), "j"));
+		free_one(empty);
+		free_one(xs);
+	}
+
+	one_block *xs = make_one(singly);
+	one_block *ys = make_one(doubly);
+	mu_shouldnt(splice(xs, ys));
+	mu_shouldnt(splice(xs, xs));
+	free_one(xs);
+	free_one(ys);
+}
+
+/*
+ * intrusive lists link the client's own records. the same record
+ * can be on two lists at once through two links, and what comes back
+ * is the record itself.
+ */
+
+struct job {
+	char name;
+	one_link by_arrival;
+	int priority;
+	one_link by_urgency;
+};
+
+MU_TEST(test_intrusive) {
+	struct job jobs[6];
+	for (int i = 0; i < 6; i++) {
+		jobs[i].name = 'a' + i;
+		jobs[i].priority = i % 3;
+	}
+
+	/* a queue and a stack over the same records */
+	one_block *q = make_one_intrusive(queue, offsetof(struct job, by_arrival));
+	one_block *s = make_one_intrusive(stack, offsetof(struct job, by_urgency));
+	mu_should(q && s);
+	mu_should(is_empty(q) && depth(s) == 0);
+	for (int i = 0; i < 6; i++) {
+		enqueue(q, &jobs[i]);
+		push(s, &jobs[i]);
+	}
+	mu_should(count(q) == 6 && depth(s) == 6);
+	mu_should(in_order(q, "abcdef"));
+	mu_should(in_order(s, "fedcba"));
+	mu_should(peek(q) == &jobs[0] && peek(s) == &jobs[5]);
+	mu_should(dequeue(q) == &jobs[0]);
+	mu_should(pop(s) == &jobs[5]);
+	mu_should(jobs[0].by_arrival.next == NULL);
+
+	/* the records left the other list alone */
+	mu_should(in_order(q, "bcdef"));
+	mu_should(in_order(s, "edcba"));
+
+	/* a record's link goes back on after it comes off */
+	enqueue(q, &jobs[0]);
+	mu_should(in_order(q, "bcdefa"));
+	mu_should(purge(q) == 6 && is_empty(q));
+	mu_should(jobs[3].by_arrival.next == NULL && jobs[3].by_arrival.previous == NULL);
+	free_one(q);
+	free_one(s);
+
+	/* both ends of a deque */
+	one_block *d = make_one_intrusive(deque, offsetof(struct job, by_arrival));
+	push_back(d, &jobs[2]);
+	push_front(d, &jobs[1]);
+	push_back(d, &jobs[3]);
+	push_front(d, &jobs[0]);
+	mu_should(in_order(d, "abcd"));
+	mu_should(peek_front(d) == &jobs[0] && peek_back(d) == &jobs[3]);
+	mu_should(pop_back(d) == &jobs[3]);
+	mu_should(pop_front(d) == &jobs[0]);
+	mu_should(pop_back(d) == &jobs[2]);
+	mu_should(pop_back(d) == &jobs[1]);
+	mu_should(pop_front(d) == NULL && pop_back(d) == NULL);
+	mu_should(peek_front(d) == NULL && is_empty(d));
+	free_one(d);
+
+	/* the lists, and splicing them */
+	one_type types[] = { singly, doubly };
+	for (int t = 0; t < 2; t++) {
+		one_block *xs = make_one_intrusive(types[t], offsetof(struct job, by_arrival));
+		one_block *ys = make_one_intrusive(types[t], offsetof(struct job, by_arrival));
+		add_last(xs, &jobs[1]);
+		add_first(xs, &jobs[0]);
+		add_last(xs, &jobs[2]);
+		for (int i = 3; i < 6; i++)
+			add_last(ys, &jobs[i]);
+		mu_should(peek_first(xs) == &jobs[0] && peek_last(xs) == &jobs[2]);
+		mu_should(splice(xs, ys) == xs);
+		mu_should(count(xs) == 6 && is_empty(ys));
+		mu_should(in_order(xs, "abcdef"));
+		mu_should(get_last(xs) == &jobs[5]);
+		mu_should(get_first(xs) == &jobs[0]);
+		mu_should(in_order(xs, "bcde"));
+		add_first(ys, &jobs[5]);
+		mu_should(in_order(ys, "f") && peek_last(ys) == &jobs[5]);
+
+		/* links at another offset can't be mixed in */
+		one_block *zs = make_one_intrusive(types[t], offsetof(struct job, by_urgency));
+		mu_shouldnt(splice(xs, zs));
+		one_block *ls = make_one(types[t]);
+		mu_shouldnt(splice(xs, ls));
+		mu_shouldnt(splice(ls, xs));
+		free_one(ls);
+		free_one(zs);
+		free_one(ys);
+		free_one(xs);
+	}
+
+	/* there is no intrusive pqueue or keyval */
+	mu_shouldnt(make_one_intrusive(pqueue, 0));
+	mu_shouldnt(make_one_intrusive(keyval, 0));
+	mu_shouldnt(make_one_backed(queue, bk_intrusive));
+}
+
 MU_TEST_SUITE(test_suite) {
 
 	MU_SUITE_CONFIGURE(test_setup, test_teardown);
@@ -620,6 +1094,7 @@ MU_TEST_SUITE(test_suite) {
 	MU_RUN_TEST(test_queue);
 
 	MU_RUN_TEST(test_deque);
+	MU_RUN_TEST(test_deque_ring);
 
 	MU_RUN_TEST(test_stack);
 
@@ -630,6 +1105,19 @@ MU_TEST_SUITE(test_suite) {
 
 	MU_RUN_TEST(test_trailing_links);
 
+	/* node pools under the lists */
+
+	MU_RUN_TEST(test_pool_reuse);
+	MU_RUN_TEST(test_pool_growth);
+
+	/* walking any structure */
+
+	MU_RUN_TEST(test_cursors);
+
+	MU_RUN_TEST(test_counts_in_step);
+	MU_RUN_TEST(test_splice);
+	MU_RUN_TEST(test_intrusive);
+
 	return;
 }
 
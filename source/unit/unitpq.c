@@ -4,6 +4,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "minunit.h"
 #include "../inc/misc.h"
 #include "../inc/rand.h"
@@ -140,6 +141,431 @@ MU_TEST(test_random_volume) {
 	free_one(pq);
 }
 
+/*
+ * the heap backing must hand items back in the same order as the
+ * linked list backing. load both with the same data, with plenty of
+ * duplicate priorities, and compare as they drain.
+ */
+
+static
+void
+load_both(one_block *pq, one_block *ph, int n, long spread) {
+	for (long i = 1; i <= n; i++) {
+		long p = random_between(0, spread);
+		add_with_priority(pq, p, (void *)i);
+		add_with_priority(ph, p, (void *)i);
+	}
+}
+
+MU_TEST(test_heap_create) {
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	mu_should(ph);
+	mu_should(ph->backing == bk_heap);
+	mu_should(is_empty(ph));
+	mu_should(count(ph) == 0);
+	mu_shouldnt(peek_max(ph));
+	mu_shouldnt(peek_min(ph));
+	mu_shouldnt(get_max(ph));
+	mu_shouldnt(get_min(ph));
+	free_one(ph);
+
+	one_block *pq = make_one_backed(pqueue, bk_default);
+	mu_should(pq);
+	mu_should(pq->backing == bk_linked);
+	free_one(pq);
+
+	/* no heap backing for other types */
+	mu_shouldnt(make_one_backed(queue, bk_heap));
+}
+
+MU_TEST(test_heap_peek_high_low) {
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	add_with_priority(ph, 100, "100");
+	add_with_priority(ph, 99, "99");
+	add_with_priority(ph, 101, "101");
+	mu_should(count(ph) == 3);
+	mu_should(max_priority(ph) == 101);
+	mu_should(equal_string((char *)peek_max(ph), "101"));
+	mu_should(min_priority(ph) == 99);
+	mu_should(equal_string((char *)peek_min(ph), "99"));
+	mu_should(count(ph) == 3);
+	mu_should(equal_string((char *)get_min(ph), "99"));
+	mu_should(equal_string((char *)get_max(ph), "101"));
+	mu_should(equal_string((char *)get_max(ph), "100"));
+	mu_should(is_empty(ph));
+	free_one(ph);
+}
+
+MU_TEST(test_heap_fifo) {
+	one_block *pq = make_one(pqueue);
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	char *items[] = { "a", "b", "c", "d", "e", "f" };
+	for (int i = 0; i < 6; i++) {
+		add_with_priority(pq, i < 3 ? 5 : 1, items[i]);
+		add_with_priority(ph, i < 3 ? 5 : 1, items[i]);
+	}
+	/* oldest first from the max, newest first from the min */
+	mu_should(equal_string((char *)get_max(pq), "a"));
+	mu_should(equal_string((char *)get_max(ph), "a"));
+	mu_should(equal_string((char *)get_min(pq), "f"));
+	mu_should(equal_string((char *)get_min(ph), "f"));
+	mu_should(equal_string((char *)get_max(pq), "b"));
+	mu_should(equal_string((char *)get_max(ph), "b"));
+	mu_should(equal_string((char *)get_min(pq), "e"));
+	mu_should(equal_string((char *)get_min(ph), "e"));
+	mu_should(purge(pq) == 2);
+	mu_should(purge(ph) == 2);
+	mu_should(is_empty(pq) && is_empty(ph));
+	free_one(pq);
+	free_one(ph);
+}
+
+MU_TEST(test_heap_matches_list_max) {
+	one_block *pq = make_one(pqueue);
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	load_both(pq, ph, 5000, 99);
+	mu_should(count(pq) == count(ph));
+	int mismatch = 0;
+	while (!is_empty(pq)) {
+		if (max_priority(pq) != max_priority(ph))
+			mismatch += 1;
+		if (get_max(pq) != get_max(ph))
+			mismatch += 1;
+	}
+	mu_should(mismatch == 0);
+	mu_should(is_empty(ph));
+	free_one(pq);
+	free_one(ph);
+}
+
+MU_TEST(test_heap_matches_list_min) {
+	one_block *pq = make_one(pqueue);
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	load_both(pq, ph, 2000, 49);
+	int mismatch = 0;
+	while (!is_empty(pq)) {
+		if (min_priority(pq) != min_priority(ph))
+			mismatch += 1;
+		if (peek_min(pq) != peek_min(ph))
+			mismatch += 1;
+		if (get_min(pq) != get_min(ph))
+			mismatch += 1;
+	}
+	mu_should(mismatch == 0);
+	mu_should(is_empty(ph));
+	free_one(pq);
+	free_one(ph);
+}
+
+MU_TEST(test_heap_matches_list_mixed) {
+	one_block *pq = make_one(pqueue);
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	int mismatch = 0;
+	for (int round = 0; round < 50; round++) {
+		load_both(pq, ph, 100, 19);
+		add_with_max(pq, "max");
+		add_with_max(ph, "max");
+		add_with_min(pq, "min");
+		add_with_min(ph, "min");
+		for (int i = 0; i < 40; i++) {
+			if (get_max(pq) != get_max(ph))
+				mismatch += 1;
+			if (get_min(pq) != get_min(ph))
+				mismatch += 1;
+		}
+		if (count(pq) != count(ph))
+			mismatch += 1;
+	}
+	mu_should(mismatch == 0);
+	mu_should(count(ph) == 50 * 22);
+	free_one(pq);
+	free_one(ph);
+}
+
+/*
+ * the dual heap has the same api and ordering, but is cheap at both
+ * ends.
+ */
+
+MU_TEST(test_dual_create) {
+	one_block *pd = make_one_backed(pqueue, bk_dual_heap);
+	mu_should(pd);
+	mu_should(pd->backing == bk_dual_heap);
+	mu_should(is_empty(pd));
+	mu_should(count(pd) == 0);
+	mu_shouldnt(peek_max(pd));
+	mu_shouldnt(peek_min(pd));
+	mu_shouldnt(get_max(pd));
+	mu_shouldnt(get_min(pd));
+	mu_should(max_priority(pd) == 0 && min_priority(pd) == 0);
+	add_with_priority(pd, 100, "100");
+	add_with_priority(pd, 99, "99");
+	add_with_priority(pd, 101, "101");
+	mu_should(count(pd) == 3);
+	mu_should(max_priority(pd) == 101);
+	mu_should(min_priority(pd) == 99);
+	mu_should(equal_string((char *)get_min(pd), "99"));
+	mu_should(equal_string((char *)get_max(pd), "101"));
+	mu_should(equal_string((char *)peek_min(pd), "100"));
+	mu_should(equal_string((char *)peek_max(pd), "100"));
+	mu_should(purge(pd) == 1);
+	mu_should(is_empty(pd));
+	free_one(pd);
+}
+
+MU_TEST(test_dual_matches_list) {
+	one_block *pq = make_one(pqueue);
+	one_block *pd = make_one_backed(pqueue, bk_dual_heap);
+	load_both(pq, pd, 3000, 99);
+	int mismatch = 0;
+	bool from_top = true;
+	while (!is_empty(pq)) {
+		if (max_priority(pq) != max_priority(pd) ||
+			min_priority(pq) != min_priority(pd))
+			mismatch += 1;
+		if (peek_max(pq) != peek_max(pd) || peek_min(pq) != peek_min(pd))
+			mismatch += 1;
+		/* runs of takes from one end, then the other */
+		if (random_between(0, 9) == 0)
+			from_top = !from_top;
+		if (from_top ? get_max(pq) != get_max(pd) : get_min(pq) != get_min(pd))
+			mismatch += 1;
+	}
+	mu_should(mismatch == 0);
+	mu_should(is_empty(pd));
+	free_one(pq);
+	free_one(pd);
+}
+
+MU_TEST(test_dual_matches_list_mixed) {
+	one_block *pq = make_one(pqueue);
+	one_block *pd = make_one_backed(pqueue, bk_dual_heap);
+	int mismatch = 0;
+	for (int round = 0; round < 50; round++) {
+		load_both(pq, pd, 100, 19);
+		add_with_max(pq, "max");
+		add_with_max(pd, "max");
+		add_with_min(pq, "min");
+		add_with_min(pd, "min");
+		for (int i = 0; i < 40; i++) {
+			if (get_max(pq) != get_max(pd))
+				mismatch += 1;
+			if (get_min(pq) != get_min(pd))
+				mismatch += 1;
+		}
+		if (count(pq) != count(pd))
+			mismatch += 1;
+	}
+	mu_should(mismatch == 0);
+	mu_should(count(pd) == 50 * 22);
+	free_one(pq);
+	free_one(pd);
+}
+
+MU_TEST(test_dual_volume) {
+	one_block *pd = make_one_backed(pqueue, bk_dual_heap);
+	for (long i = 1; i <= 100000; i++)
+		add_with_priority(pd, random_between(0, 999999), (void *)i);
+	mu_should(count(pd) == 100000);
+	long hi = max_priority(pd);
+	long lo = min_priority(pd);
+	bool ordered = true;
+	while (!is_empty(pd)) {
+		long p = max_priority(pd);
+		if (p > hi)
+			ordered = false;
+		hi = p;
+		get_max(pd);
+		if (is_empty(pd))
+			break;
+		p = min_priority(pd);
+		if (p < lo)
+			ordered = false;
+		lo = p;
+		get_min(pd);
+	}
+	mu_should(ordered);
+	mu_should(count(pd) == 0);
+	free_one(pd);
+}
+
+/*
+ * the linked list has always taken get_max from its last item and
+ * get_min from its first. equal priorities are added ahead of each
+ * other, so the max end gives the oldest of its equals and the min
+ * end the newest. check every backing against a plain array model of
+ * that, mixing adds and takes from both ends.
+ */
+
+typedef struct model_item model_item;
+struct model_item {
+	long priority;
+	long seq;
+};
+
+static
+int
+model_pick(model_item *m, int n, bool max) {
+	int at = 0;
+	for (int i = 1; i < n; i++) {
+		if (max ? m[i].priority > m[at].priority ||
+			(m[i].priority == m[at].priority && m[i].seq < m[at].seq)
+			: m[i].priority < m[at].priority ||
+			(m[i].priority == m[at].priority && m[i].seq > m[at].seq))
+			at = i;
+	}
+	return at;
+}
+
+static
+int
+model_mismatches(one_backing backing, int ops, long spread) {
+	model_item *m = malloc(ops * sizeof(model_item));
+	one_block *pq = make_one_backed(pqueue, backing);
+	int n = 0;
+	int mismatch = 0;
+	for (long seq = 1; seq <= ops; seq++) {
+		if (n == 0 || random_between(0, 2)) {
+			m[n].priority = random_between(0, spread);
+			m[n].seq = seq;
+			add_with_priority(pq, m[n].priority, (void *)seq);
+			n += 1;
+			continue;
+		}
+		bool max = random_between(0, 1);
+		int at = model_pick(m, n, max);
+		if ((max ? peek_max(pq) : peek_min(pq)) != (void *)m[at].seq)
+			mismatch += 1;
+		if ((max ? get_max(pq) : get_min(pq)) != (void *)m[at].seq)
+			mismatch += 1;
+		n -= 1;
+		m[at] = m[n];
+	}
+	if (count(pq) != n)
+		mismatch += 1;
+	free(m);
+	free_one(pq);
+	return mismatch;
+}
+
+MU_TEST(test_matches_list_model) {
+	mu_should(model_mismatches(bk_linked, 4000, 9) == 0);
+	mu_should(model_mismatches(bk_heap, 4000, 9) == 0);
+	mu_should(model_mismatches(bk_dual_heap, 4000, 9) == 0);
+
+	/* a single priority is a stack from the min and a queue from the max */
+	one_block *pq = make_one(pqueue);
+	one_block *ph = make_one_backed(pqueue, bk_heap);
+	one_block *pd = make_one_backed(pqueue, bk_dual_heap);
+	char *items[] = { "a", "b", "c", "d" };
+	for (int i = 0; i < 4; i++) {
+		add_with_priority(pq, 7, items[i]);
+		add_with_priority(ph, 7, items[i]);
+		add_with_priority(pd, 7, items[i]);
+	}
+	mu_should(equal_string(get_min(pq), "d"));
+	mu_should(equal_string(get_min(ph), "d"));
+	mu_should(equal_string(get_min(pd), "d"));
+	mu_should(equal_string(get_max(pq), "a"));
+	mu_should(equal_string(get_max(ph), "a"));
+	mu_should(equal_string(get_max(pd), "a"));
+	mu_should(equal_string(peek_min(pq), "c"));
+	mu_should(equal_string(peek_min(ph), "c"));
+	mu_should(equal_string(peek_min(pd), "c"));
+	free_one(pq);
+	free_one(ph);
+	free_one(pd);
+}
+
+/*
+ * a bulk load must give the same queue as adding the pairs one at a
+ * time, for every backing.
+ */
+
+static
+int
+bulk_mismatches(one_backing backing, int n, long spread) {
+	pq_pair *pairs = malloc(n * sizeof(pq_pair));
+	one_block *added = make_one_backed(pqueue, backing);
+	for (long i = 0; i < n; i++) {
+		pairs[i].priority = random_between(0, spread);
+		pairs[i].item = (void *)(i + 1);
+		add_with_priority(added, pairs[i].priority, pairs[i].item);
+	}
+	one_block *loaded = make_one_prioritized(pqueue, backing, pairs, n);
+	free(pairs);
+	int mismatch = count(added) == count(loaded) ? 0 : 1;
+	while (!is_empty(added)) {
+		if (random_between(0, 1)) {
+			if (get_max(added) != get_max(loaded))
+				mismatch += 1;
+		} else {
+			if (get_min(added) != get_min(loaded))
+				mismatch += 1;
+		}
+	}
+	if (!is_empty(loaded))
+		mismatch += 1;
+	free_one(added);
+	free_one(loaded);
+	return mismatch;
+}
+
+MU_TEST(test_bulk_load) {
+	mu_should(bulk_mismatches(bk_linked, 1000, 49) == 0);
+	mu_should(bulk_mismatches(bk_heap, 1000, 49) == 0);
+	mu_should(bulk_mismatches(bk_dual_heap, 1000, 49) == 0);
+	mu_should(bulk_mismatches(bk_heap, 10, 2) == 0);
+	mu_should(bulk_mismatches(bk_dual_heap, 1, 2) == 0);
+
+	/* empty loads are allowed, bad ones are not */
+	one_block *pq = make_one_prioritized(pqueue, bk_heap, NULL, 0);
+	mu_should(pq && is_empty(pq));
+	free_one(pq);
+	mu_shouldnt(make_one_prioritized(queue, bk_default, NULL, 0));
+	mu_shouldnt(make_one_prioritized(pqueue, bk_heap, NULL, 10));
+
+	/* and a loaded queue keeps working */
+	pq_pair three[] = { { 5, "a" }, { 1, "b" }, { 5, "c" } };
+	pq = make_one_prioritized(pqueue, bk_dual_heap, three, 3);
+	add_with_priority(pq, 5, "d");
+	mu_should(equal_string(get_max(pq), "a"));
+	mu_should(equal_string(get_max(pq), "c"));
+	mu_should(equal_string(get_max(pq), "d"));
+	mu_should(equal_string(get_max(pq), "b"));
+	mu_should(is_empty(pq));
+	free_one(pq);
+}
+
+/*
+ * the linked list keeps its length as items come and go, including
+ * through a bulk load and a purge.
+ */
+
+MU_TEST(test_count_in_step) {
+	pq_pair pairs[] = { { 3, "a" }, { 1, "b" }, { 3, "c" }, { 7, "d" } };
+	one_block *pq = make_one_prioritized(pqueue, bk_linked, pairs, 4);
+	mu_should(count(pq) == 4);
+	int held = 4;
+	int wrong = 0;
+	for (int i = 0; i < 3000; i++) {
+		if (i % 3 != 2 || held == 0) {
+			add_with_priority(pq, (i * 7919) % 101, "x");
+			held += 1;
+		} else {
+			i % 2 ? get_max(pq) : get_min(pq);
+			held -= 1;
+		}
+		wrong += count(pq) != held || is_empty(pq) != (held == 0);
+	}
+	mu_should(wrong == 0);
+	mu_should(purge(pq) == held);
+	mu_should(count(pq) == 0 && is_empty(pq));
+	add_with_priority(pq, 1, "y");
+	mu_should(count(pq) == 1);
+	free_one(pq);
+}
+
 MU_TEST_SUITE(test_suite) {
 
 	MU_SUITE_CONFIGURE(test_setup, test_teardown);
@@ -152,6 +578,25 @@ MU_TEST_SUITE(test_suite) {
 	MU_RUN_TEST(test_read_loop);
 	MU_RUN_TEST(test_random_volume);
 	MU_RUN_TEST(test_peek_high_low);
+
+	printf("\n\nheap backed priority queue\n\n");
+	MU_RUN_TEST(test_heap_create);
+	MU_RUN_TEST(test_heap_peek_high_low);
+	MU_RUN_TEST(test_heap_fifo);
+	MU_RUN_TEST(test_heap_matches_list_max);
+	MU_RUN_TEST(test_heap_matches_list_min);
+	MU_RUN_TEST(test_heap_matches_list_mixed);
+
+	printf("\n\ndual heap backed priority queue\n\n");
+	MU_RUN_TEST(test_dual_create);
+	MU_RUN_TEST(test_dual_matches_list);
+	MU_RUN_TEST(test_dual_matches_list_mixed);
+	MU_RUN_TEST(test_dual_volume);
+	MU_RUN_TEST(test_matches_list_model);
+
+	printf("\n\nbulk loaded priority queue\n\n");
+	MU_RUN_TEST(test_bulk_load);
+	MU_RUN_TEST(test_count_in_step);
 }
 
 int
@@ -2,6 +2,9 @@
 
 /* released to the public domain, troy brumley, may 2024 */
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "minunit.h"
@@ -58,11 +61,260 @@ MU_TEST(test_qu) {
 
 }
 
+/*
+ * the same on a ring buffer, then enough traffic to wrap around the
+ * ring and force it to grow while wrapped.
+ */
+
+MU_TEST(test_qu_ring) {
+	one_block *qu = make_one_backed(queue, bk_ring);
+	mu_should(qu);
+	mu_should(is_empty(qu));
+	enqueue(qu, "one");
+	enqueue(qu, "two");
+	mu_should(count(qu) == 2);
+	enqueue(qu, "three");
+	mu_should(equal_string("one", dequeue(qu)));
+	mu_should(equal_string("two", peek(qu)));
+	mu_should(count(qu) == 2);
+	mu_should(equal_string("two", dequeue(qu)));
+	mu_should(equal_string("three", dequeue(qu)));
+	mu_should(is_empty(qu));
+	mu_shouldnt(dequeue(qu));
+	mu_shouldnt(peek(qu));
+
+	/* head is part way round, fill past capacity */
+	long next_in = 1;
+	long next_out = 1;
+	bool in_order = true;
+	for (int round = 0; round < 10; round++) {
+		for (int i = 0; i < ONE_RING_DEFAULT_CAPACITY * (round + 1); i++)
+			enqueue(qu, (void *)next_in++);
+		for (int i = 0; i < ONE_RING_DEFAULT_CAPACITY * round + 3; i++)
+			in_order = in_order && dequeue(qu) == (void *)next_out++;
+	}
+	mu_should(in_order);
+	mu_should(count(qu) == next_in - next_out);
+	while (!is_empty(qu))
+		in_order = in_order && dequeue(qu) == (void *)next_out++;
+	mu_should(in_order);
+	mu_should(next_in == next_out);
+
+	enqueue(qu, "one");
+	enqueue(qu, "two");
+	mu_should(purge(qu) == 2);
+	mu_should(is_empty(qu));
+	free_one(qu);
+
+	/* a queue can't be made on a heap */
+	mu_shouldnt(make_one_backed(queue, bk_heap));
+}
+
+/*
+ * the bounded queues from a single thread. they fill up, and the
+ * try and _n functions say so instead of waiting.
+ */
+
+MU_TEST(test_qu_bounded) {
+	one_type types[] = { spsc, mpmc };
+	for (int t = 0; t < 2; t++) {
+		one_block *qu = make_one(types[t]);
+		mu_should(qu);
+		mu_should(is_empty(qu));
+		enqueue(qu, "one");
+		enqueue(qu, "two");
+		mu_should(count(qu) == 2);
+		mu_should(equal_string("one", dequeue(qu)));
+		mu_should(equal_string("two", try_dequeue(qu)));
+		mu_shouldnt(try_dequeue(qu));
+		free_one(qu);
+
+		/* five rounds up to eight */
+		qu = make_one_bounded(types[t], 5);
+		long next_in = 1;
+		long next_out = 1;
+		while (try_enqueue(qu, (void *)next_in))
+			next_in += 1;
+		mu_should(next_in == 9 && count(qu) == 8);
+
+		/* round and round, in batches that don't always fit */
+		bool in_order = true;
+		void *batch[5];
+		for (int round = 0; round < 100; round++) {
+			int got = dequeue_n(qu, batch, 1 + round % 5);
+			mu_should(got == 1 + round % 5);
+			for (int i = 0; i < got; i++)
+				in_order = in_order && batch[i] == (void *)next_out++;
+			for (int i = 0; i < 5; i++)
+				batch[i] = (void *)(next_in + i);
+			next_in += enqueue_n(qu, batch, 5);
+			in_order = in_order && count(qu) == 8;
+		}
+		mu_should(in_order);
+		mu_should(dequeue_n(qu, batch, 5) == 5);
+		mu_should(batch[4] == (void *)(next_out + 4));
+		mu_should(dequeue_n(qu, batch, 5) == 3);
+		mu_should(dequeue_n(qu, batch, 5) == 0);
+		mu_should(is_empty(qu));
+
+		enqueue(qu, "one");
+		enqueue(qu, "two");
+		mu_should(purge(qu) == 2);
+		mu_should(is_empty(qu));
+		enqueue(qu, "three");
+		mu_should(equal_string("three", dequeue(qu)));
+
+		/* NULL is what empty looks like, and there is no peek */
+		mu_shouldnt(enqueue(qu, NULL));
+		batch[0] = "one";
+		batch[1] = NULL;
+		mu_should(enqueue_n(qu, batch, 2) == -1);
+		mu_should(is_empty(qu));
+		mu_shouldnt(peek(qu));
+		free_one(qu);
+	}
+
+	/* the plain queue takes the same calls, and is never full */
+	one_block *qu = make_one(queue);
+	void *batch[3] = { "one", "two", "three" };
+	mu_should(try_enqueue(qu, "zero"));
+	mu_should(enqueue_n(qu, batch, 3) == 3);
+	mu_should(dequeue_n(qu, batch, 3) == 3);
+	mu_should(equal_string("zero", batch[0]) && equal_string("two", batch[2]));
+	mu_should(equal_string("three", try_dequeue(qu)));
+	mu_should(dequeue_n(qu, batch, 3) == 0);
+
+	/* and holds NULL like any other item */
+	batch[0] = "one";
+	batch[1] = NULL;
+	mu_should(enqueue_n(qu, batch, 2) == 2);
+	mu_should(try_enqueue(qu, NULL));
+	mu_should(count(qu) == 3);
+	mu_should(equal_string("one", dequeue(qu)));
+	mu_shouldnt(dequeue(qu));
+	mu_shouldnt(dequeue(qu));
+	mu_should(is_empty(qu));
+	free_one(qu);
+
+	mu_shouldnt(make_one_bounded(queue, 16));
+	mu_shouldnt(make_one_bounded(mpmc, 0));
+}
+
+/*
+ * producers send their id and a count that goes up, packed in one
+ * value. however the queue interleaves producers, each one's values
+ * must reach any one consumer in order, and every value must arrive
+ * exactly once.
+ */
+
+#define QT_ITEMS 200000
+#define QT_THREADS 4
+
+typedef struct qt_arg qt_arg;
+struct qt_arg {
+	one_block *qu;
+	long id;
+	int producers;
+	atomic_long *left;
+	long sum;
+	long wrong;
+};
+
+static
+void *
+qt_producer(void *p) {
+	qt_arg *a = p;
+	void *batch[8];
+	long i = 1;
+	while (i <= QT_ITEMS) {
+		if (i % 3) {
+			enqueue(a->qu, (void *)(i * QT_THREADS + a->id));
+			i += 1;
+			continue;
+		}
+		int n = 0;
+		for (; n < 8 && i + n <= QT_ITEMS; n++)
+			batch[n] = (void *)((i + n) * QT_THREADS + a->id);
+		int sent = enqueue_n(a->qu, batch, n);
+		if (!sent)
+			sched_yield();
+		i += sent;
+	}
+	return NULL;
+}
+
+static
+void *
+qt_consumer(void *p) {
+	qt_arg *a = p;
+	long last[QT_THREADS] = { 0 };
+	void *batch[8];
+	while (atomic_load(a->left) > 0) {
+		int n = dequeue_n(a->qu, batch, 1 + a->id % 8);
+		if (!n) {
+			sched_yield();
+			continue;
+		}
+		atomic_fetch_sub(a->left, n);
+		for (int i = 0; i < n; i++) {
+			long v = (long)batch[i];
+			long from = v % QT_THREADS;
+			if (from >= a->producers || v / QT_THREADS <= last[from])
+				a->wrong += 1;
+			last[from] = v / QT_THREADS;
+			a->sum += v;
+		}
+	}
+	return NULL;
+}
+
+static
+bool
+qt_run(one_block *qu, int producers, int consumers) {
+	atomic_long left;
+	atomic_init(&left, (long)producers * QT_ITEMS);
+	qt_arg args[2 * QT_THREADS] = { 0 };
+	pthread_t threads[2 * QT_THREADS];
+	for (int t = 0; t < producers + consumers; t++) {
+		args[t].qu = qu;
+		args[t].id = t < producers ? t : t - producers;
+		args[t].producers = producers;
+		args[t].left = &left;
+		pthread_create(&threads[t], NULL,
+			t < producers ? qt_producer : qt_consumer, &args[t]);
+	}
+	long sum = 0;
+	long wrong = 0;
+	for (int t = 0; t < producers + consumers; t++) {
+		pthread_join(threads[t], NULL);
+		sum += args[t].sum;
+		wrong += args[t].wrong;
+	}
+	long want = 0;
+	for (long p = 0; p < producers; p++)
+		want += QT_THREADS * ((long)QT_ITEMS * (QT_ITEMS + 1) / 2) + p * QT_ITEMS;
+	return wrong == 0 && sum == want && is_empty(qu);
+}
+
+MU_TEST(test_qu_threads) {
+	one_block *qu = make_one_bounded(spsc, 64);
+	mu_should(qt_run(qu, 1, 1));
+	free_one(qu);
+	qu = make_one_bounded(mpmc, 64);
+	mu_should(qt_run(qu, 1, 1));
+	mu_should(qt_run(qu, QT_THREADS, QT_THREADS));
+	mu_should(qt_run(qu, QT_THREADS, 1));
+	free_one(qu);
+}
+
 MU_TEST_SUITE(test_suite) {
 
 	MU_SUITE_CONFIGURE(test_setup, test_teardown);
 
 	MU_RUN_TEST(test_qu);
+	MU_RUN_TEST(test_qu_ring);
+	MU_RUN_TEST(test_qu_bounded);
+	MU_RUN_TEST(test_qu_threads);
 }
 
 int
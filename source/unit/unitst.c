@@ -60,11 +60,36 @@ MU_TEST(test) {
 	st = NULL;
 }
 
+MU_TEST(test_ring) {
+	one_block *st = make_one_backed(stack, bk_ring);
+	mu_should(st);
+	mu_should(is_empty(st));
+	mu_shouldnt(pop(st));
+	mu_shouldnt(peek(st));
+
+	/* enough to grow a few times */
+	for (long i = 1; i <= 1000; i++)
+		push(st, (void *)i);
+	mu_should(depth(st) == 1000);
+	mu_should(peek(st) == (void *)1000);
+	bool in_order = true;
+	for (long i = 1000; i > 500; i--)
+		in_order = in_order && pop(st) == (void *)i;
+	mu_should(in_order);
+	mu_should(depth(st) == 500);
+
+	push(st, "a");
+	mu_should(purge(st) == 501);
+	mu_should(is_empty(st));
+	free_one(st);
+}
+
 MU_TEST_SUITE(test_suite) {
 
 	MU_SUITE_CONFIGURE(tesetup, teteardown);
 
 	MU_RUN_TEST(test);
+	MU_RUN_TEST(test_ring);
 }
 
 int
@@ -0,0 +1,306 @@
+/* unitws.c -- tests for the work stealing deque -- troy brumley */
+
+/* released to the public domain, troy brumley, may 2024 */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "minunit.h"
+#include "../inc/alloc.h"
+#include "../inc/one.h"
+
+/*
+ * minunit setup and teardown.
+ */
+
+static
+void
+test_setup(void) {
+}
+
+static
+void
+test_teardown(void) {
+}
+
+/*
+ * from one thread the owner sees a stack and a thief sees a queue,
+ * over the same items.
+ */
+
+MU_TEST(test_ws) {
+	one_block *ws = make_one(wsdeque);
+	mu_should(ws);
+	mu_should(is_empty(ws));
+	mu_shouldnt(pop(ws));
+	mu_shouldnt(steal(ws));
+	for (long i = 1; i <= 6; i++)
+		push(ws, (void *)i);
+	mu_should(count(ws) == 6);
+	mu_should(pop(ws) == (void *)6);
+	mu_should(steal(ws) == (void *)1);
+	mu_should(steal(ws) == (void *)2);
+	mu_should(pop(ws) == (void *)5);
+	mu_should(pop(ws) == (void *)4);
+	mu_should(steal(ws) == (void *)3);
+	mu_shouldnt(pop(ws));
+	mu_shouldnt(steal(ws));
+	mu_should(is_empty(ws));
+
+	/* grow several times with the items part way round */
+	long next_in = 1;
+	long next_out = 1;
+	bool in_order = true;
+	for (int round = 0; round < 6; round++) {
+		for (int i = 0; i < ONE_WSDEQUE_DEFAULT_CAPACITY << round; i++)
+			push(ws, (void *)next_in++);
+		for (int i = 0; i < ONE_WSDEQUE_DEFAULT_CAPACITY / 2; i++)
+			in_order = in_order && steal(ws) == (void *)next_out++;
+	}
+	mu_should(in_order);
+	mu_should(count(ws) == next_in - next_out);
+	mu_should(pop(ws) == (void *)(next_in - 1));
+	mu_should(steal(ws) == (void *)next_out);
+
+	mu_should(purge(ws) == next_in - next_out - 2);
+	mu_should(is_empty(ws));
+	push(ws, "one");
+	mu_should(pop(ws) && is_empty(ws));
+
+	mu_shouldnt(push(ws, NULL));
+	mu_shouldnt(peek(ws));
+	free_one(ws);
+
+	one_block *st = make_one(stack);
+	mu_shouldnt(steal(st));
+	free_one(st);
+}
+
+/*
+ * the owner pushes and pops while thieves steal. every item must be
+ * taken exactly once, by someone. the owner works in bursts so that
+ * the deque often runs down to its last item and the owner and the
+ * thieves have to settle who gets it.
+ */
+
+#define WS_ITEMS 1000000
+#define WS_THIEVES 4
+
+typedef struct ws_arg ws_arg;
+struct ws_arg {
+	one_block *ws;
+	atomic_uchar *taken;
+	atomic_int *done;
+	long count;
+};
+
+static
+void
+ws_take(ws_arg *a, void *item) {
+	atomic_fetch_add(&a->taken[(long)item], 1);
+	a->count += 1;
+}
+
+static
+void *
+ws_thief(void *p) {
+	ws_arg *a = p;
+	while (!atomic_load(a->done) || !is_empty(a->ws)) {
+		void *item = steal(a->ws);
+		if (item)
+			ws_take(a, item);
+		else
+			sched_yield();
+	}
+	return NULL;
+}
+
+MU_TEST(test_ws_threads) {
+	one_block *ws = make_one(wsdeque);
+	atomic_uchar *taken = calloc(WS_ITEMS + 1, sizeof(atomic_uchar));
+	atomic_int done;
+	atomic_init(&done, 0);
+	ws_arg args[WS_THIEVES + 1] = { 0 };
+	pthread_t threads[WS_THIEVES];
+	for (int t = 0; t <= WS_THIEVES; t++) {
+		args[t].ws = ws;
+		args[t].taken = taken;
+		args[t].done = &done;
+	}
+	for (int t = 1; t <= WS_THIEVES; t++)
+		pthread_create(&threads[t - 1], NULL, ws_thief, &args[t]);
+
+	/* the owner, bursts of up to a thousand and a few pops each */
+	long next = 1;
+	int burst = 1;
+	while (next <= WS_ITEMS) {
+		for (int i = 0; i < burst && next <= WS_ITEMS; i++)
+			push(ws, (void *)next++);
+		for (int i = 0; i < 3; i++) {
+			void *item = pop(ws);
+			if (item)
+				ws_take(&args[0], item);
+		}
+		burst = burst * 7 % 1009;
+	}
+	void *item;
+	while ((item = pop(ws)))
+		ws_take(&args[0], item);
+	atomic_store(&done, 1);
+	for (int t = 0; t < WS_THIEVES; t++)
+		pthread_join(threads[t], NULL);
+
+	long total = 0;
+	long stolen = 0;
+	for (int t = 0; t <= WS_THIEVES; t++) {
+		total += args[t].count;
+		if (t)
+			stolen += args[t].count;
+	}
+	long wrong = 0;
+	for (long i = 1; i <= WS_ITEMS; i++)
+		wrong += atomic_load(&taken[i]) != 1;
+	mu_should(wrong == 0);
+	mu_should(total == WS_ITEMS);
+	mu_should(is_empty(ws));
+	printf("\n%ld of %d items stolen\n", stolen, WS_ITEMS);
+	free(taken);
+	free_one(ws);
+}
+
+/*
+ * a pool of workers, one deque each. every owner pushes runs well
+ * past the default capacity, so the deques grow on their owners'
+ * threads at the same time, while the thieves steal from all of
+ * them. txballoc is tracing throughout.
+ */
+
+#define WS_OWNERS 4
+#define WS_OWNER_ITEMS 200000
+
+typedef struct ws_pool ws_pool;
+struct ws_pool {
+	one_block *ws[WS_OWNERS];
+	atomic_uchar *taken;
+	atomic_int owners;          /* still pushing */
+	atomic_long count;
+};
+
+typedef struct ws_worker ws_worker;
+struct ws_worker {
+	ws_pool *pool;
+	int id;
+};
+
+static
+void *
+ws_owner(void *p) {
+	ws_worker *w = p;
+	ws_pool *pool = w->pool;
+	one_block *ws = pool->ws[w->id];
+	long next = 0;
+	int burst = 1000;
+	while (next < WS_OWNER_ITEMS) {
+		for (int i = 0; i < burst && next < WS_OWNER_ITEMS; i++) {
+			long item = (long)w->id * WS_OWNER_ITEMS + ++next;
+			push(ws, (void *)item);
+		}
+		for (int i = 0; i < 5; i++) {
+			void *item = pop(ws);
+			if (item) {
+				atomic_fetch_add(&pool->taken[(long)item], 1);
+				atomic_fetch_add(&pool->count, 1);
+			}
+		}
+		burst = burst * 7 % 5003 + 1;
+	}
+	void *item;
+	while ((item = pop(ws))) {
+		atomic_fetch_add(&pool->taken[(long)item], 1);
+		atomic_fetch_add(&pool->count, 1);
+	}
+	atomic_fetch_sub(&pool->owners, 1);
+	return NULL;
+}
+
+static
+void *
+ws_pool_thief(void *p) {
+	ws_worker *w = p;
+	ws_pool *pool = w->pool;
+	for (int v = w->id;; v = (v + 1) % WS_OWNERS) {
+		void *item = steal(pool->ws[v]);
+		if (item) {
+			atomic_fetch_add(&pool->taken[(long)item], 1);
+			atomic_fetch_add(&pool->count, 1);
+			continue;
+		}
+		if (atomic_load(&pool->owners) > 0) {
+			sched_yield();
+			continue;
+		}
+		bool left = false;
+		for (int o = 0; o < WS_OWNERS; o++)
+			left = left || !is_empty(pool->ws[o]);
+		if (!left)
+			return NULL;
+	}
+}
+
+MU_TEST(test_ws_pool_growth) {
+	tsinitialize(1000, txballoc_f_errors, stderr);
+	ws_pool *pool = calloc(1, sizeof(ws_pool));
+	pool->taken = calloc(WS_OWNERS * WS_OWNER_ITEMS + 1, sizeof(atomic_uchar));
+	atomic_init(&pool->owners, WS_OWNERS);
+	atomic_init(&pool->count, 0);
+	for (int o = 0; o < WS_OWNERS; o++)
+		pool->ws[o] = make_one(wsdeque);
+
+	ws_worker workers[2 * WS_OWNERS];
+	pthread_t threads[2 * WS_OWNERS];
+	for (int t = 0; t < 2 * WS_OWNERS; t++) {
+		workers[t].pool = pool;
+		workers[t].id = t % WS_OWNERS;
+		pthread_create(&threads[t], NULL,
+			t < WS_OWNERS ? ws_owner : ws_pool_thief, &workers[t]);
+	}
+	for (int t = 0; t < 2 * WS_OWNERS; t++)
+		pthread_join(threads[t], NULL);
+
+	long wrong = 0;
+	for (long i = 1; i <= WS_OWNERS * WS_OWNER_ITEMS; i++)
+		wrong += atomic_load(&pool->taken[i]) != 1;
+	mu_should(wrong == 0);
+	mu_should(atomic_load(&pool->count) == WS_OWNERS * WS_OWNER_ITEMS);
+	bool grew = true;
+	for (int o = 0; o < WS_OWNERS; o++) {
+		ws_array *a = atomic_load(&pool->ws[o]->u.wsd.array);
+		grew = grew && a->mask + 1 > ONE_WSDEQUE_DEFAULT_CAPACITY;
+		mu_should(is_empty(pool->ws[o]));
+		free_one(pool->ws[o]);
+	}
+	mu_should(grew);
+	free(pool->taken);
+	free(pool);
+	tsterminate();
+}
+
+MU_TEST_SUITE(test_suite) {
+
+	MU_SUITE_CONFIGURE(test_setup, test_teardown);
+
+	MU_RUN_TEST(test_ws);
+	MU_RUN_TEST(test_ws_threads);
+	MU_RUN_TEST(test_ws_pool_growth);
+}
+
+int
+main(int argc, char *argv[]) {
+	MU_RUN_SUITE(test_suite);
+	MU_REPORT();
+	return MU_EXIT_CODE;
+}
+/* unitws.c ends here */